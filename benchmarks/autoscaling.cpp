@@ -0,0 +1,164 @@
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include "PeakMicroPulseHandler/peak_handler.h"
+#include "PeakMicroPulseHandler/autoscaler.h"
+#include "PeakMicroPulseHandler/frame_queue.h"
+#include "PeakMicroPulseHandler/matched_filter.h"
+#include "PeakMicroPulseHandler/spectral_analyser.h"
+#include "PeakMicroPulseHandler/synthetic_generator.h"
+
+
+double readPrf(const std::string& mps_file)
+{
+    std::ifstream file(mps_file);
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream command(line);
+        std::string name;
+        double prf;
+        if (command >> name and name == "PRF" and command >> prf) {
+            return prf;
+        }
+    }
+    return 0.0;
+}
+
+
+double microsecondsSince(const std::chrono::steady_clock::time_point& start)
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+// Feeds a matched filter and spectral analysis pipeline with the .mps sweep and then with
+// full matrix capture, each at its real time frame rate from the PRF, and lets Autoscaler
+// share a thread budget between the two stages. Reports where the threads went in each
+// scan plan and checks the budget was never exceeded.
+auto main(int argc, char** argv) -> int
+{
+    const std::string mps_file = argc > 1 ? argv[1] : "examples/mps/roller_probe.mps";
+    const int budget = argc > 2 ? std::stoi(argv[2]) : 8;
+    const double phase_seconds = argc > 3 ? std::stod(argv[3]) : 3.0;
+    const int fmc_elements = argc > 4 ? std::stoi(argv[4]) : 32;
+
+    // Only the frame geometry is needed from the driver
+    PeakHandler peak_handler(10, "127.0.0.1", 0, mps_file);
+    peak_handler.setReconstructionConfiguration(fmc_elements, 0.8, 0.1, 0.7, 1480.0, 1480.0, 6320.0, 0.0, 8.0, 0.1, 20.0);
+    if (not peak_handler.readMpsFile()) {
+        return 1;
+    }
+    const PeakHandler::OutputFormat* ltpa_data_ptr(peak_handler.ltpa_data_ptr());
+
+    PeakHandler::OutputFormat fmc_geometry;
+    PeakHandler::copyFrameMetadata(*ltpa_data_ptr, fmc_geometry);
+    fmc_geometry.num_a_scans = fmc_elements * fmc_elements;
+
+    SyntheticGenerator sweep_generator(*ltpa_data_ptr, peak_handler.gate_start_, peak_handler.dof_, 256);
+    SyntheticGenerator fmc_generator(fmc_geometry, peak_handler.gate_start_, peak_handler.dof_, 256);
+    sweep_generator.addScatterer(0.0, 10.0, 0.2);
+    fmc_generator.addScatterer(0.0, 10.0, 0.2);
+    PeakHandler::OutputFormat sweep_frame;
+    PeakHandler::OutputFormat fmc_frame;
+    sweep_generator.generate(sweep_frame);
+    fmc_generator.generate(fmc_frame);
+
+    const double prf = readPrf(mps_file);
+    if (prf <= 0.0) {
+        std::cout << "\033[31m" << "No PRF in " << mps_file << "\033[0m" << std::endl;
+        return 1;
+    }
+
+    // Pools as large as the whole budget, the autoscaler decides how much of each is used
+    MatchedFilter matched_filter(budget);
+    matched_filter.setReference(sweep_frame, 30, 1060, 1140);
+    SpectralAnalyser spectral_analyser(budget);
+
+    FrameQueue filter_input(fmc_geometry, 8);
+    FrameQueue spectra_input(fmc_geometry, 8);
+    Autoscaler autoscaler(budget, 0.75, 250);
+    const int filter_stage = autoscaler.addStage("MatchedFilter", matched_filter.threadPool(), &filter_input);
+    const int spectra_stage = autoscaler.addStage("SpectralAnalyser", spectral_analyser.threadPool(), &spectra_input);
+
+    std::atomic<bool> running(true);
+    std::atomic<bool> filtering(true);
+    std::atomic<long> filtered_frames(0);
+    std::atomic<long> analysed_frames(0);
+
+    std::thread filter_thread([&]() {
+        PeakHandler::OutputFormat filtered;
+        while (running or filter_input.size() > 0) {
+            auto frame = filter_input.pop(50);
+            if (frame == nullptr) {
+                continue;
+            }
+            const auto start = std::chrono::steady_clock::now();
+            matched_filter.process(*frame, filtered);
+            autoscaler.record(filter_stage, microsecondsSince(start));
+            spectra_input.push(filtered);
+            filtered_frames++;
+        }
+    });
+
+    std::thread spectra_thread([&]() {
+        while (filtering or spectra_input.size() > 0) {
+            auto frame = spectra_input.pop(50);
+            if (frame == nullptr) {
+                continue;
+            }
+            const auto start = std::chrono::steady_clock::now();
+            spectral_analyser.process(*frame);
+            autoscaler.record(spectra_stage, microsecondsSince(start));
+            analysed_frames++;
+        }
+    });
+
+    int most_threads = 0;
+    std::cout << std::endl << std::fixed << std::setprecision(1);
+    const std::vector<std::pair<std::string, const PeakHandler::OutputFormat*>> phases = {
+        {"Sweep", &sweep_frame}, {"FMC", &fmc_frame}
+    };
+    for (const auto& phase : phases) {
+        const PeakHandler::OutputFormat& frame = *phase.second;
+        const double fps = prf / frame.ascans.size();
+        const long filter_dropped = filter_input.dropped();
+        const long pushed_before = filtered_frames;
+        const long analysed_before = analysed_frames;
+
+        const auto start = std::chrono::steady_clock::now();
+        long pushed = 0;
+        for (long f = 0; f < (long)(phase_seconds * fps); f++) {
+            std::this_thread::sleep_until(start + std::chrono::microseconds((long)(f * 1e6 / fps)));
+            filter_input.push(frame);
+            pushed++;
+            most_threads = std::max(most_threads, autoscaler.threadsInUse());
+        }
+
+        std::cout << phase.first << ", " << frame.ascans.size() << " A-Scans at " << fps << " frames per second" << std::endl;
+        std::cout << autoscaler.report();
+        std::cout << "Frames                 " << std::setw(10) << pushed << " pushed, "
+                  << filter_input.dropped() - filter_dropped << " dropped, "
+                  << filtered_frames - pushed_before << " filtered, "
+                  << analysed_frames - analysed_before << " analysed" << std::endl << std::endl;
+    }
+
+    running = false;
+    filter_thread.join();
+    filtering = false;
+    spectra_thread.join();
+
+    std::cout << "Thread budget          " << std::setw(10) << budget << std::endl;
+    std::cout << "Most threads in use    " << std::setw(10) << most_threads << std::endl;
+    std::cout << "Rebalances             " << std::setw(10) << autoscaler.rebalances() << std::endl;
+
+    if (most_threads > budget) {
+        std::cout << "\033[31m" << "Autoscaler went over the thread budget" << "\033[0m" << std::endl;
+        return 1;
+    }
+    return 0;
+}
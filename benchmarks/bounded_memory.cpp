@@ -0,0 +1,115 @@
+#include <atomic>
+#include <fstream>
+#include <thread>
+#include <unistd.h>
+
+#include "PeakMicroPulseHandler/peak_handler.h"
+#include "PeakMicroPulseHandler/frame_queue.h"
+#include "PeakMicroPulseHandler/loopback_instrument.h"
+#include "PeakMicroPulseHandler/matched_filter.h"
+#include "PeakMicroPulseHandler/memory_budget.h"
+#include "PeakMicroPulseHandler/synthetic_generator.h"
+
+
+// Resident set size in bytes
+size_t residentBytes()
+{
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0;
+    size_t resident = 0;
+    statm >> pages >> resident;
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+
+// Runs the driver, a queue and a consumer thread for many frames and checks that
+// neither the components' footprints nor the resident set grow after startup
+auto main(int argc, char** argv) -> int
+{
+    const std::string mps_file = argc > 1 ? argv[1] : "examples/mps/roller_probe.mps";
+    const int n_frames = argc > 2 ? std::stoi(argv[2]) : 2000;
+    const size_t budget_mb = argc > 3 ? std::stoul(argv[3]) : 64;
+
+    LoopbackInstrument instrument;
+    instrument.start();
+
+    PeakHandler peak_handler(10, "127.0.0.1", instrument.port(), mps_file);
+    peak_handler.setResetWait(0);
+    peak_handler.setReconstructionConfiguration(64, 0.8, 0.1, 0.7, 1480.0, 1480.0, 6320.0, 0.0, 8.0, 0.1, 20.0);
+    if (not peak_handler.readMpsFile()) {
+        return 1;
+    }
+    peak_handler.connect();
+    peak_handler.sendMpsConfiguration();
+
+    const PeakHandler::OutputFormat* ltpa_data_ptr(peak_handler.ltpa_data_ptr());
+
+    SyntheticGenerator generator(*ltpa_data_ptr, peak_handler.gate_start_, peak_handler.dof_, 256);
+    generator.addScatterer(0.0, 10.0, 0.2);
+    instrument.setFrameSource([&generator](std::vector<unsigned char>& packet, const long& /*frame*/) {
+        generator.generatePacket(packet);
+    });
+
+    MatchedFilter matched_filter(1);
+    peak_handler.sendDataRequest();
+    matched_filter.setReference(*ltpa_data_ptr, 30, 1060, 1140);
+
+    // Everything is sized here, the queue takes what is left of the budget
+    MemoryBudget budget(budget_mb * 1024 * 1024);
+    if (not budget.reserve("PeakHandler", peak_handler.footprint()) or
+        not budget.reserve("MatchedFilter", matched_filter.footprint())) {
+        std::cout << "\033[31m" << "Budget too small for the handler and filter" << "\033[0m" << std::endl;
+        return 1;
+    }
+
+    const size_t frame_bytes = FrameQueue::frameBytes(*ltpa_data_ptr);
+    const size_t depth = std::min<size_t>(budget.remaining() / frame_bytes, 16);
+    FrameQueue queue(*ltpa_data_ptr, depth);
+    if (depth == 0 or not budget.reserve("FrameQueue", queue.footprint())) {
+        std::cout << "\033[31m" << "Budget too small for a single queued frame" << "\033[0m" << std::endl;
+        return 1;
+    }
+    budget.report();
+
+    const size_t peak_handler_bytes = peak_handler.footprint();
+    const size_t matched_filter_bytes = matched_filter.footprint();
+
+    std::atomic<bool> producing(true);
+    std::thread consumer([&queue, &matched_filter, &producing]() {
+        PeakHandler::OutputFormat filtered;
+        while (producing or queue.size() > 0) {
+            auto frame = queue.pop(100);
+            if (frame != nullptr) {
+                matched_filter.process(*frame, filtered);
+            }
+        }
+    });
+
+    size_t resident_start = 0;
+    for (int i = 0; i < n_frames; i++) {
+        std::cout.setstate(std::ios::failbit);
+        if (peak_handler.sendDataRequest()) {
+            queue.push(*ltpa_data_ptr);
+        }
+        std::cout.clear();
+
+        // Allocator and page cache settle over the first frames
+        if (i == n_frames / 10) {
+            resident_start = residentBytes();
+        }
+    }
+    producing = false;
+    consumer.join();
+    instrument.stop();
+
+    const size_t resident_end = residentBytes();
+    const bool fixed = peak_handler.footprint() == peak_handler_bytes and matched_filter.footprint() == matched_filter_bytes;
+
+    std::cout << std::endl;
+    std::cout << "Frames:                " << n_frames << ", " << queue.dropped() << " not queued" << std::endl;
+    std::cout << "Component footprints:  " << (fixed ? "unchanged" : "\033[31mgrew\033[0m") << std::endl;
+    std::cout << "Resident set:          " << resident_start / 1024 << " kB after " << n_frames / 10
+              << " frames, " << resident_end / 1024 << " kB at the end" << std::endl;
+
+    return fixed ? 0 : 1;
+}
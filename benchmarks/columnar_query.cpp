@@ -0,0 +1,109 @@
+#include <chrono>
+#include <cstdio>
+#include <fcntl.h>
+#include <iomanip>
+#include <iostream>
+#include <unistd.h>
+
+#include "PeakMicroPulseHandler/peak_handler.h"
+#include "PeakMicroPulseHandler/columnar_store.h"
+#include "PeakMicroPulseHandler/synthetic_generator.h"
+
+
+// Flushes a file and asks the kernel to drop it from the page cache, so reads hit the disk
+void evict(const std::string& path)
+{
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+}
+
+
+double millisecondsSince(const std::chrono::steady_clock::time_point& start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+// Writes a scan both frame after frame and as per test number streams, then reads one
+// test number over the whole scan back from each and compares the bytes and time taken
+auto main(int argc, char** argv) -> int
+{
+    const std::string mps_file = argc > 1 ? argv[1] : "examples/mps/roller_probe.mps";
+    const std::string output = argc > 2 ? argv[2] : "columnar_query";
+    const int n_frames = argc > 3 ? std::stoi(argv[3]) : 2000;
+    const int test_number = argc > 4 ? std::stoi(argv[4]) : 285;
+
+    // Only the frame geometry is needed from the driver
+    PeakHandler peak_handler(10, "127.0.0.1", 0, mps_file);
+    peak_handler.setReconstructionConfiguration(64, 0.8, 0.1, 0.7, 1480.0, 1480.0, 6320.0, 0.0, 8.0, 0.1, 20.0);
+    if (not peak_handler.readMpsFile()) {
+        return 1;
+    }
+    const PeakHandler::OutputFormat* ltpa_data_ptr(peak_handler.ltpa_data_ptr());
+
+    SyntheticGenerator generator(*ltpa_data_ptr, peak_handler.gate_start_, peak_handler.dof_, 256);
+    generator.addScatterer(0.0, 10.0, 0.2);
+
+    const std::string frame_major_path = output + ".frames";
+    const std::string columnar_path = output + ".columns";
+    const size_t row_bytes = ltpa_data_ptr->ascan_length * sizeof(short int);
+    const size_t frame_bytes = ltpa_data_ptr->num_a_scans * row_bytes;
+    int row = -1;
+    {
+        std::FILE* frame_major = std::fopen(frame_major_path.c_str(), "wb");
+        ColumnarWriter columnar(columnar_path, *ltpa_data_ptr);
+
+        PeakHandler::OutputFormat frame;
+        for (int f = 0; f < n_frames; f++) {
+            generator.generate(frame);
+            for (size_t i = 0; i < frame.ascans.size(); i++) {
+                std::fwrite(frame.ascans[i].amps.data(), sizeof(short int), frame.ascans[i].amps.size(), frame_major);
+                if (frame.ascans[i].header.testNo == test_number) {
+                    row = i;
+                }
+            }
+            columnar.write(frame);
+        }
+        std::fclose(frame_major);
+    }
+    if (row < 0) {
+        std::cout << "\033[31m" << "Test number " << test_number << " is not in the scan" << "\033[0m" << std::endl;
+        return 1;
+    }
+
+    // Frame after frame, the test number is one row in every frame
+    evict(frame_major_path);
+    std::vector<short int> frame_major_samples((size_t)n_frames * ltpa_data_ptr->ascan_length);
+    auto start = std::chrono::steady_clock::now();
+    std::FILE* frame_major = std::fopen(frame_major_path.c_str(), "rb");
+    for (int f = 0; f < n_frames; f++) {
+        fseeko(frame_major, (off_t)f * frame_bytes + (off_t)row * row_bytes, SEEK_SET);
+        std::fread(&frame_major_samples[(size_t)f * ltpa_data_ptr->ascan_length], row_bytes, 1, frame_major);
+    }
+    std::fclose(frame_major);
+    const double frame_major_ms = millisecondsSince(start);
+
+    evict(columnar_path);
+    std::vector<short int> columnar_samples;
+    std::vector<long> frame_numbers;
+    start = std::chrono::steady_clock::now();
+    ColumnarReader reader(columnar_path);
+    const int rows = reader.read(test_number, 0, 0, n_frames, columnar_samples, frame_numbers);
+    const double columnar_ms = millisecondsSince(start);
+
+    std::cout << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Scan                   " << std::setw(10) << n_frames * frame_bytes / (1024.0 * 1024.0) << " MB" << std::endl;
+    std::cout << "Frame major            " << std::setw(10) << frame_major_ms << " ms, " << n_frames << " reads of " << row_bytes << " bytes" << std::endl;
+    std::cout << "Columnar               " << std::setw(10) << columnar_ms << " ms, " << reader.bytesRead() / (1024.0 * 1024.0) << " MB read" << std::endl;
+
+    if (rows != n_frames or columnar_samples != frame_major_samples) {
+        std::cout << "\033[31m" << "Columnar read back " << rows << " A-Scans that do not match the frames" << "\033[0m" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+#include "PeakMicroPulseHandler/peak_handler.h"
+#include "PeakMicroPulseHandler/distributed_tfm.h"
+#include "PeakMicroPulseHandler/synthetic_generator.h"
+#include "PeakMicroPulseHandler/tfm_imager.h"
+
+
+// Images full matrix capture frames in this process, then again split between worker
+// processes forked here, and checks every reassembled image against the local one.
+// Run as "distributed_tfm --worker host port [threads]" to image for a coordinator
+// on another host.
+auto main(int argc, char** argv) -> int
+{
+    if (argc > 3 and std::string(argv[1]) == "--worker") {
+        TfmWorker worker(argv[2], std::stoi(argv[3]), argc > 4 ? std::stoi(argv[4]) : 0);
+        return worker.run() ? 0 : 1;
+    }
+
+    const std::string mps_file = argc > 1 ? argv[1] : "examples/mps/roller_probe.mps";
+    const int n_workers = argc > 2 ? std::stoi(argv[2]) : 2;
+    const int n_frames = argc > 3 ? std::stoi(argv[3]) : 20;
+    const int n_elements = argc > 4 ? std::stoi(argv[4]) : 32;
+    const int port = argc > 5 ? std::stoi(argv[5]) : 0;         // Non zero waits for workers started by hand
+
+    // Only the frame geometry is needed from the driver, made full matrix capture
+    PeakHandler peak_handler(10, "127.0.0.1", 0, mps_file);
+    peak_handler.setReconstructionConfiguration(n_elements, 0.8, 0.1, 0.7, 1480.0, 1480.0, 6320.0, 0.0, 8.0, 0.1, 20.0);
+    if (not peak_handler.readMpsFile()) {
+        return 1;
+    }
+    PeakHandler::OutputFormat geometry;
+    PeakHandler::copyFrameMetadata(*peak_handler.ltpa_data_ptr(), geometry);
+    geometry.num_a_scans = n_elements * n_elements;
+
+    const TfmImager::Grid grid = {-12.0, 12.0, 1.0, 19.0, 128, 96};
+
+    TfmCoordinator coordinator(geometry, peak_handler.gate_start_, grid, port);
+    if (not coordinator.listen()) {
+        return 1;
+    }
+
+    // Forked before any threads are started here, one thread a worker
+    std::vector<pid_t> children;
+    for (int w = 0; port == 0 and w < n_workers; w++) {
+        const pid_t child = fork();
+        if (child == 0) {
+            TfmWorker worker("127.0.0.1", coordinator.port(), 1);
+            _exit(worker.run() ? 0 : 1);
+        }
+        children.push_back(child);
+    }
+    if (not coordinator.start(n_workers, port == 0 ? 10000 : 120000)) {
+        return 1;
+    }
+
+    SyntheticGenerator generator(geometry, peak_handler.gate_start_, peak_handler.dof_, 256);
+    generator.addScatterer(0.0, 10.0, 0.2);
+    generator.addScatterer(-5.0, 14.0, 0.2);
+    std::vector<PeakHandler::OutputFormat> frames(4);
+    for (auto& frame : frames) {
+        generator.generate(frame);
+    }
+
+    // The same frames in a single process, one thread, as the reference
+    TfmImager imager(geometry, peak_handler.gate_start_, grid, {0, 0, 0, 0}, 1);
+    std::vector<TfmImager::Image> references(frames.size());
+    auto start = std::chrono::steady_clock::now();
+    for (int f = 0; f < n_frames; f++) {
+        PeakHandler::OutputFormat& frame = frames[f % frames.size()];
+        frame.frame_number = f;
+        imager.process(frame, references[f % frames.size()]);
+    }
+    const double local_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    long received = 0;
+    long out_of_order = 0;
+    float max_error = 0.0f;
+    float peak = 0.0f;
+    start = std::chrono::steady_clock::now();
+    std::thread consumer([&]() {
+        long expected = 0;
+        while (received < n_frames) {
+            auto image = coordinator.pop(2000);
+            if (image == nullptr) {
+                break;
+            }
+            out_of_order += image->frame_number == expected ? 0 : 1;
+            expected = image->frame_number + 1;
+
+            const TfmImager::Image& reference = references[image->frame_number % frames.size()];
+            for (size_t p = 0; p < reference.pixels.size(); p++) {
+                max_error = std::max(max_error, std::fabs(image->pixels[p] - reference.pixels[p]));
+                peak = std::max(peak, reference.pixels[p]);
+            }
+            received++;
+        }
+    });
+
+    for (int f = 0; f < n_frames; f++) {
+        PeakHandler::OutputFormat& frame = frames[f % frames.size()];
+        frame.frame_number = f;
+        while (not coordinator.push(frame) and coordinator.good()) {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    }
+    consumer.join();
+    const double distributed_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const int workers = coordinator.nWorkers();
+    const bool closed = coordinator.close();
+
+    int failed_workers = 0;
+    for (const pid_t& child : children) {
+        int status = 0;
+        waitpid(child, &status, 0);
+        failed_workers += WIFEXITED(status) and WEXITSTATUS(status) == 0 ? 0 : 1;
+    }
+
+    std::cout << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Elements               " << std::setw(10) << n_elements << std::endl;
+    std::cout << "Pixels                 " << std::setw(10) << grid.nx * grid.nz << std::endl;
+    std::cout << "Workers                " << std::setw(10) << workers << std::endl;
+    std::cout << "Single process         " << std::setw(10) << n_frames / local_seconds << " frames per second" << std::endl;
+    std::cout << "Distributed            " << std::setw(10) << received / distributed_seconds << " frames per second" << std::endl;
+    std::cout << "Images received        " << std::setw(10) << received << " of " << n_frames << std::endl;
+    std::cout << "Largest difference     " << std::setw(10) << std::setprecision(4) << max_error / std::max(peak, 1.0f) << " of the peak" << std::endl;
+
+    if (not closed or received != n_frames or out_of_order > 0 or failed_workers > 0 or max_error > 1e-3f * std::max(peak, 1.0f)) {
+        std::cout << "\033[31m" << "Distributed images are missing, out of order or differ from the single process" << "\033[0m" << std::endl;
+        return 1;
+    }
+    return 0;
+}
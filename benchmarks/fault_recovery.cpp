@@ -0,0 +1,124 @@
+#include <chrono>
+#include <future>
+#include <iomanip>
+
+#include "PeakMicroPulseHandler/peak_handler.h"
+#include "PeakMicroPulseHandler/loopback_instrument.h"
+
+
+// Requests a frame, closing the connection if the driver stalls waiting for bytes that never come
+bool requestFrame(PeakHandler& peak_handler, LoopbackInstrument& instrument, const int& timeout_ms, bool& stalled)
+{
+    auto request = std::async(std::launch::async, [&peak_handler]() { return peak_handler.sendDataRequest(); });
+
+    if (request.wait_for(std::chrono::milliseconds(timeout_ms)) == std::future_status::timeout) {
+        stalled = true;
+        instrument.closeConnection();
+    }
+
+    try {
+        return request.get();
+    } catch (const std::exception& e) {
+        return false;
+    }
+}
+
+
+auto main(int argc, char** argv) -> int
+{
+    const std::string mps_file = argc > 1 ? argv[1] : "examples/mps/roller_probe.mps";
+    const int timeout_ms = 2000;
+    const int max_frames = 20;
+
+    LoopbackInstrument instrument;
+    instrument.start();
+
+    PeakHandler peak_handler(10, "127.0.0.1", instrument.port(), mps_file);
+    peak_handler.setResetWait(0);
+    if (not peak_handler.readMpsFile()) {
+        return 1;
+    }
+    peak_handler.connect();
+    peak_handler.sendMpsConfiguration();
+
+    const std::vector<LoopbackInstrument::FaultType> faults = {
+        LoopbackInstrument::none,
+        LoopbackInstrument::split_segments,
+        LoopbackInstrument::mid_frame_delay,
+        LoopbackInstrument::error_packet,
+        LoopbackInstrument::corrupt_count,
+        LoopbackInstrument::corrupt_dof,
+        LoopbackInstrument::drop_ascan
+    };
+
+    struct Result {
+        std::string                    fault;
+        int                            frames_lost;
+        bool                           stalled;
+        bool                           recovered;
+        double                         resync_ms;
+    };
+    std::vector<Result> results;
+
+    for (auto fault : faults) {
+        // Clean frames first so every fault starts from an aligned stream
+        bool stalled = false;
+        for (int i = 0; i < 3; i++) {
+            requestFrame(peak_handler, instrument, timeout_ms, stalled);
+        }
+
+        Result result = {LoopbackInstrument::faultName(fault), 0, false, false, 0.0};
+        instrument.injectFault(fault);
+        auto start = std::chrono::steady_clock::now();
+
+        for (int i = 0; i < max_frames and not result.recovered; i++) {
+            bool frame_stalled = false;
+            bool valid = requestFrame(peak_handler, instrument, timeout_ms, frame_stalled);
+
+            if (frame_stalled) {
+                // Only a reconnect recovers from a stall
+                result.stalled = true;
+                peak_handler.connect();
+                peak_handler.sendMpsConfiguration();
+            }
+
+            if (valid) {
+                result.recovered = true;
+            } else {
+                result.frames_lost++;
+            }
+        }
+
+        result.resync_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        results.push_back(result);
+    }
+
+    instrument.stop();
+
+    const PeakHandler::LinkStatistics& link = peak_handler.link_statistics();
+
+    std::cout << std::endl << "Fault recovery against the loopback LTPA (" << mps_file << ")" << std::endl;
+    std::cout << std::left << std::setw(18) << "fault"
+              << std::setw(14) << "frames lost"
+              << std::setw(10) << "stalled"
+              << std::setw(12) << "recovered"
+              << "time to first valid frame (ms)" << std::endl;
+
+    for (auto& result : results) {
+        std::cout << std::left << std::setw(18) << result.fault
+                  << std::setw(14) << result.frames_lost
+                  << std::setw(10) << (result.stalled ? "yes" : "no")
+                  << std::setw(12) << (result.recovered ? "yes" : "no")
+                  << std::fixed << std::setprecision(2) << result.resync_ms << std::endl;
+    }
+
+    std::cout << std::endl
+              << "Frames requested " << link.frames_requested
+              << ", valid " << link.frames_valid
+              << ", dropped " << link.frames_dropped
+              << ", corrupt A-Scans " << link.corrupt_ascans
+              << ", error messages " << link.error_messages
+              << ", alignment losses " << link.alignment_losses << std::endl;
+
+    return 0;
+}
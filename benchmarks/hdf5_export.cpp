@@ -0,0 +1,113 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <sys/stat.h>
+
+#include "PeakMicroPulseHandler/peak_handler.h"
+#include "PeakMicroPulseHandler/hdf5_writer.h"
+#include "PeakMicroPulseHandler/loopback_instrument.h"
+#include "PeakMicroPulseHandler/synthetic_generator.h"
+
+
+// Reads back the A-Scans of one frame and compares them with what was pushed
+bool matchesFile(const std::string& path, const PeakHandler::OutputFormat& frame, const hsize_t& row)
+{
+    const hid_t file = H5Fopen(path.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+    const hid_t dataset = H5Dopen2(file, "ascans", H5P_DEFAULT);
+    const hid_t file_space = H5Dget_space(dataset);
+
+    const hsize_t start[3] = {row, 0, 0};
+    const hsize_t count[3] = {1, (hsize_t)frame.num_a_scans, (hsize_t)frame.ascan_length};
+    H5Sselect_hyperslab(file_space, H5S_SELECT_SET, start, nullptr, count, nullptr);
+    const hid_t memory_space = H5Screate_simple(3, count, nullptr);
+
+    std::vector<short int> amps((size_t)frame.num_a_scans * frame.ascan_length);
+    H5Dread(dataset, H5T_NATIVE_SHORT, memory_space, file_space, H5P_DEFAULT, amps.data());
+    H5Sclose(memory_space);
+    H5Sclose(file_space);
+    H5Dclose(dataset);
+    H5Fclose(file);
+
+    for (int i = 0; i < frame.num_a_scans; i++) {
+        if (not std::equal(frame.ascans[i].amps.begin(), frame.ascans[i].amps.end(), &amps[(size_t)i * frame.ascan_length])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+// Acquires synthetic frames through the loopback as fast as the driver allows and
+// streams them to HDF5, reporting whether the writer keeps up and what compression saves
+auto main(int argc, char** argv) -> int
+{
+    const std::string mps_file = argc > 1 ? argv[1] : "examples/mps/roller_probe.mps";
+    const std::string output = argc > 2 ? argv[2] : "hdf5_export.h5";
+    const int n_frames = argc > 3 ? std::stoi(argv[3]) : 1000;
+    const int compression_level = argc > 4 ? std::stoi(argv[4]) : 0;
+
+    LoopbackInstrument instrument;
+    instrument.start();
+
+    PeakHandler peak_handler(10, "127.0.0.1", instrument.port(), mps_file);
+    peak_handler.setResetWait(0);
+    peak_handler.setReconstructionConfiguration(64, 0.8, 0.1, 0.7, 1480.0, 1480.0, 6320.0, 0.0, 8.0, 0.1, 20.0);
+    if (not peak_handler.readMpsFile()) {
+        return 1;
+    }
+    peak_handler.connect();
+    peak_handler.sendMpsConfiguration();
+
+    const PeakHandler::OutputFormat* ltpa_data_ptr(peak_handler.ltpa_data_ptr());
+
+    SyntheticGenerator generator(*ltpa_data_ptr, peak_handler.gate_start_, peak_handler.dof_, 256);
+    generator.addScatterer(0.0, 10.0, 0.2);
+    instrument.setFrameSource([&generator](std::vector<unsigned char>& packet, const long& /*frame*/) {
+        generator.generatePacket(packet);
+    });
+    peak_handler.sendDataRequest();
+
+    PeakHandler::OutputFormat last;
+    long pushed = 0;
+    const auto start = std::chrono::steady_clock::now();
+    {
+        Hdf5Writer writer(output, *ltpa_data_ptr, peak_handler.mpsCommands(), 16, compression_level);
+        for (int f = 0; f < n_frames; f++) {
+            if (peak_handler.sendDataRequest() and writer.push(*ltpa_data_ptr)) {
+                pushed++;
+            }
+        }
+
+        // The last frame is held until accepted so it can be checked against the file
+        while (not writer.push(*ltpa_data_ptr)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        pushed++;
+        last = *ltpa_data_ptr;
+        writer.close();
+
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        const double raw_mb = (double)writer.written() * ltpa_data_ptr->num_a_scans * ltpa_data_ptr->ascan_length * sizeof(short int) / (1024.0 * 1024.0);
+
+        struct stat file_stat;
+        stat(output.c_str(), &file_stat);
+        const double file_mb = file_stat.st_size / (1024.0 * 1024.0);
+
+        std::cout << std::endl;
+        std::cout << std::fixed << std::setprecision(1);
+        std::cout << "Frames written         " << std::setw(10) << writer.written() << std::endl;
+        std::cout << "Frames dropped         " << std::setw(10) << writer.dropped() << std::endl;
+        std::cout << "Frames per second      " << std::setw(10) << writer.written() / seconds << std::endl;
+        std::cout << "A-Scan data            " << std::setw(10) << raw_mb << " MB" << std::endl;
+        std::cout << "File size              " << std::setw(10) << file_mb << " MB" << std::endl;
+        std::cout << "Compression ratio      " << std::setw(10) << std::setprecision(2) << raw_mb / std::max(file_mb, 1e-9) << std::endl;
+    }
+    instrument.stop();
+
+    if (last.ascans.empty() or not matchesFile(output, last, pushed - 1)) {
+        std::cout << "\033[31m" << "Last frame written does not match the frame pushed" << "\033[0m" << std::endl;
+        return 1;
+    }
+    return 0;
+}
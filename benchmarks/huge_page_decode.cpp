@@ -0,0 +1,77 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+
+#include "PeakMicroPulseHandler/peak_handler.h"
+#include "PeakMicroPulseHandler/huge_page_buffer.h"
+#include "PeakMicroPulseHandler/synthetic_generator.h"
+
+
+// Decodes every message of an FMC packet held at data, best of repeats in MB/s
+double decodeThroughput(PeakHandler& peak_handler, const unsigned char* data, const int& n_messages, const int& message_length, const int& repeats)
+{
+    double best = 0.0;
+    long long checksum = 0;
+
+    // Decoded in place, so after the first message only the packet's pages are touched
+    PeakHandler::DofMessage message;
+    for (int r = 0; r < repeats; r++) {
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < n_messages; i++) {
+            peak_handler.dataOutpoutFormatReader(data + (size_t)i * message_length, message_length, message);
+            checksum += message.header.statistics.max;
+        }
+        const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = std::max(best, (double)n_messages * message_length / 1e6 / elapsed);
+    }
+
+    if (checksum == 0) {
+        std::cout << "No signal decoded" << std::endl;
+    }
+    return best;
+}
+
+
+auto main(int argc, char** argv) -> int
+{
+    const int n_elements = argc > 1 ? std::stoi(argv[1]) : 64;
+    const int ascan_length = argc > 2 ? std::stoi(argv[2]) : 2000;
+    const int repeats = argc > 3 ? std::stoi(argv[3]) : 5;
+
+    // Full matrix capture frame, every element pair as its own A-Scan
+    PeakHandler peak_handler(10, "127.0.0.1", 0, "");
+    peak_handler.setSaturationLevel(32767);
+    peak_handler.setReconstructionConfiguration(n_elements, 0.8, 0.1, 0.7, 1480.0, 1480.0, 6320.0, 0.0, 8.0, 0.1, 20.0);
+
+    PeakHandler::OutputFormat geometry;
+    PeakHandler::copyFrameMetadata(*peak_handler.ltpa_data_ptr(), geometry);
+    geometry.num_a_scans = n_elements * n_elements;
+    geometry.ascan_length = ascan_length;
+
+    SyntheticGenerator generator(geometry, 0, 4, 256);
+    generator.addScatterer(0.0, 10.0, 0.2);
+    std::vector<unsigned char> packet;
+    generator.generatePacket(packet);
+
+    const int message_length = 8 + 2 * ascan_length;
+    const int n_messages = geometry.num_a_scans;
+
+    HugePageBuffer<unsigned char> standard_buffer(false);
+    standard_buffer.append(packet);
+    HugePageBuffer<unsigned char> huge_page_buffer(true);
+    huge_page_buffer.append(packet);
+
+    std::cout << std::endl << "Frame of " << n_messages << " A-Scans, " << std::fixed << std::setprecision(1)
+              << packet.size() / 1e6 << " MB" << std::endl;
+    std::cout << std::left << std::setw(28) << "Packet buffer" << std::right << std::setw(12) << "MB/s" << std::endl;
+
+    auto row = [&](const std::string& name, const unsigned char* data) {
+        std::cout << std::left << std::setw(28) << name << std::right << std::setw(12)
+                  << decodeThroughput(peak_handler, data, n_messages, message_length, repeats) << std::endl;
+    };
+    row("std::vector", packet.data());
+    row(HugePageRegion::backingName(standard_buffer.backing()), standard_buffer.data());
+    row(HugePageRegion::backingName(huge_page_buffer.backing()), huge_page_buffer.data());
+
+    return 0;
+}
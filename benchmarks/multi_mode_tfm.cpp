@@ -0,0 +1,153 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+
+#include "PeakMicroPulseHandler/peak_handler.h"
+#include "PeakMicroPulseHandler/layered_medium.h"
+#include "PeakMicroPulseHandler/synthetic_generator.h"
+#include "PeakMicroPulseHandler/tfm_imager.h"
+
+
+// us, down to the backwall and up to the point, by searching for the fastest reflection point
+double bruteForceSkip(
+    const LayeredMedium& down_medium,                          // With the first segment's velocity as its material velocity
+    const double& up_velocity,                                 // mm/us
+    const double& backwall,
+    const double& dx,
+    const double& z)
+{
+    const auto time = [&](const double& x) {
+        return down_medium.travelTime(x, backwall) + std::hypot(dx - x, backwall - z) / up_velocity;
+    };
+
+    // Coarse then golden section about the best
+    double best = -100.0;
+    for (double x = -100.0; x <= 100.0; x += 0.05) {
+        best = time(x) < time(best) ? x : best;
+    }
+    double lo = best - 0.05;
+    double hi = best + 0.05;
+    const double ratio = 0.5 * (std::sqrt(5.0) - 1.0);
+    for (int iteration = 0; iteration < 100; iteration++) {
+        const double a = hi - ratio * (hi - lo);
+        const double b = lo + ratio * (hi - lo);
+        if (time(a) < time(b)) {
+            hi = b;
+        } else {
+            lo = a;
+        }
+    }
+    return time(0.5 * (lo + hi));
+}
+
+
+// Images full matrix capture frames in the TT, TTT and TLT modes at once, reflecting off the
+// backwall at the specimen depth, and times it against an imager a mode. Checks the skip
+// travel times against a search for the fastest reflection point, and that the modes
+// imaged in one pass match the separate images averaged afterwards.
+auto main(int argc, char** argv) -> int
+{
+    const std::string mps_file = argc > 1 ? argv[1] : "examples/mps/roller_probe.mps";
+    const int repeats = argc > 2 ? std::stoi(argv[2]) : 3;
+    const int n_elements = argc > 3 ? std::stoi(argv[3]) : 32;
+    const double vel_shear = argc > 4 ? std::stod(argv[4]) : 3240.0;       // m/s
+
+    // Only the frame geometry is needed from the driver, made full matrix capture
+    PeakHandler peak_handler(10, "127.0.0.1", 0, mps_file);
+    peak_handler.setReconstructionConfiguration(n_elements, 0.8, 0.1, 0.7, 1480.0, 1480.0, 6320.0, 0.0, 8.0, 0.1, 20.0);
+    if (not peak_handler.readMpsFile()) {
+        return 1;
+    }
+    PeakHandler::OutputFormat geometry;
+    PeakHandler::copyFrameMetadata(*peak_handler.ltpa_data_ptr(), geometry);
+    geometry.num_a_scans = n_elements * n_elements;
+
+    // Skip legs against the search, T down and L up, and T both ways
+    const LayeredMedium medium(geometry);
+    PeakHandler::OutputFormat shear_geometry = geometry;
+    shear_geometry.vel_material = vel_shear;
+    const LayeredMedium shear_medium(shear_geometry);
+    double worst = 0.0;
+    for (const double& up_velocity : {medium.materialVelocity(), vel_shear / 1000.0}) {
+        for (const double& dx : {-15.0, -4.0, 0.0, 7.5, 20.0}) {
+            for (const double& z : {2.0, 10.0, 18.0}) {
+                const LayeredMedium::Layer segments[2] = {{geometry.specimen_depth, vel_shear / 1000.0}, {geometry.specimen_depth - z, up_velocity}};
+                const double solved = medium.travelTime(dx, segments, 2);
+                const double searched = bruteForceSkip(shear_medium, up_velocity, geometry.specimen_depth, dx, z);
+                worst = std::max(worst, std::fabs(solved - searched));
+            }
+        }
+    }
+
+    SyntheticGenerator generator(geometry, peak_handler.gate_start_, peak_handler.dof_, 256);
+    generator.addScatterer(0.0, 10.0, 0.2);
+    PeakHandler::OutputFormat frame;
+    generator.generate(frame);
+
+    const TfmImager::Grid grid = {-12.0, 12.0, 1.0, 19.0, 128, 96};
+    const std::vector<std::string> names = {"TT", "TTT", "TLT"};
+    TfmImager fused(geometry, peak_handler.gate_start_, grid, {0, 0, 0, 0}, 1);
+    fused.setShearVelocity(vel_shear);
+    if (not fused.setModes(names)) {
+        return 1;
+    }
+    std::vector<std::unique_ptr<TfmImager>> separate;
+    size_t separate_footprint = 0;
+    for (const std::string& name : names) {
+        separate.emplace_back(new TfmImager(geometry, peak_handler.gate_start_, grid, {0, 0, 0, 0}, 1));
+        separate.back()->setShearVelocity(vel_shear);
+        separate.back()->setModes(std::vector<std::string>{name});
+        separate_footprint += separate.back()->footprint();
+    }
+
+    TfmImager::Image fused_image;
+    std::vector<TfmImager::Image> images(names.size());
+    std::vector<float> averaged(grid.nx * grid.nz);
+    fused.process(frame, fused_image);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeats; r++) {
+        fused.process(frame, fused_image);
+    }
+    const double fused_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / repeats;
+
+    start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeats; r++) {
+        std::fill(averaged.begin(), averaged.end(), 0.0f);
+        for (size_t m = 0; m < names.size(); m++) {
+            separate[m]->process(frame, images[m]);
+            for (size_t p = 0; p < averaged.size(); p++) {
+                averaged[p] += images[m].pixels[p] / names.size();
+            }
+        }
+    }
+    const double separate_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / repeats;
+
+    double largest = 0.0;
+    double difference = 0.0;
+    for (size_t p = 0; p < averaged.size(); p++) {
+        largest = std::max(largest, (double)averaged[p]);
+        difference = std::max(difference, (double)std::fabs(averaged[p] - fused_image.pixels[p]));
+    }
+
+    std::cout << std::endl << std::fixed << std::setprecision(1);
+    std::cout << "Modes                  " << std::setw(10) << "TT, TTT, TLT" << std::endl;
+    std::cout << "One pass               " << std::setw(10) << fused_ms << " ms, " << fused.footprint() / 1024 << " kB" << std::endl;
+    std::cout << "An imager a mode       " << std::setw(10) << separate_ms << " ms, " << separate_footprint / 1024 << " kB" << std::endl;
+    std::cout << std::setprecision(6);
+    std::cout << "Skip travel time error " << std::setw(10) << worst << " us" << std::endl;
+    std::cout << "One pass difference    " << std::setw(10) << difference / std::max(largest, 1e-9) << " of the largest pixel" << std::endl;
+
+    if (worst > 1e-4) {
+        std::cout << "\033[31m" << "Skip travel times do not match the fastest reflection" << "\033[0m" << std::endl;
+        return 1;
+    }
+    if (difference > 1e-4 * largest) {
+        std::cout << "\033[31m" << "Modes imaged in one pass do not match the modes imaged separately" << "\033[0m" << std::endl;
+        return 1;
+    }
+    return 0;
+}
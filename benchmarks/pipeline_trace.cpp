@@ -0,0 +1,67 @@
+#include <map>
+
+#include "PeakMicroPulseHandler/peak_handler.h"
+#include "PeakMicroPulseHandler/frame_tracer.h"
+#include "PeakMicroPulseHandler/loopback_instrument.h"
+#include "PeakMicroPulseHandler/matched_filter.h"
+#include "PeakMicroPulseHandler/spectral_analyser.h"
+#include "PeakMicroPulseHandler/synthetic_generator.h"
+
+
+// Records the timeline of synthetic frames through the driver and processing stages,
+// written as Chrome trace event JSON for chrome://tracing or ui.perfetto.dev
+auto main(int argc, char** argv) -> int
+{
+    const std::string mps_file = argc > 1 ? argv[1] : "examples/mps/roller_probe.mps";
+    const std::string trace_file = argc > 2 ? argv[2] : "pipeline_trace.json";
+    const int n_frames = argc > 3 ? std::stoi(argv[3]) : 100;
+
+    LoopbackInstrument instrument;
+    instrument.start();
+
+    PeakHandler peak_handler(10, "127.0.0.1", instrument.port(), mps_file);
+    peak_handler.setResetWait(0);
+    peak_handler.setReconstructionConfiguration(64, 0.8, 0.1, 0.7, 1480.0, 1480.0, 6320.0, 0.0, 8.0, 0.1, 20.0);
+    if (not peak_handler.readMpsFile()) {
+        return 1;
+    }
+    peak_handler.connect();
+    peak_handler.sendMpsConfiguration();
+
+    const PeakHandler::OutputFormat* ltpa_data_ptr(peak_handler.ltpa_data_ptr());
+
+    SyntheticGenerator generator(*ltpa_data_ptr, peak_handler.gate_start_, peak_handler.dof_, 256);
+    generator.addScatterer(0.0, 10.0, 0.2);
+    instrument.setFrameSource([&generator](std::vector<unsigned char>& packet, const long& /*frame*/) {
+        generator.generatePacket(packet);
+    });
+
+    FrameTracer tracer;
+    tracer.setThreadName("Driver");
+    peak_handler.attachTracer(&tracer);
+
+    MatchedFilter matched_filter;
+    matched_filter.attachTracer(&tracer);
+    SpectralAnalyser spectral_analyser;
+    spectral_analyser.attachTracer(&tracer);
+
+    PeakHandler::OutputFormat filtered;
+    for (int i = 0; i < n_frames; i++) {
+        if (not peak_handler.sendDataRequest()) {
+            continue;
+        }
+        if (i == 0) {
+            matched_filter.setReference(*ltpa_data_ptr, 30, 1060, 1140);
+        }
+        matched_filter.process(*ltpa_data_ptr, filtered);
+        spectral_analyser.process(filtered);
+    }
+
+    instrument.stop();
+
+    tracer.writeChromeTrace(trace_file);
+    std::cout << std::endl << "Trace of " << n_frames << " frames written to " << trace_file
+              << ", " << tracer.overwritten() << " spans overwritten" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,252 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include "PeakMicroPulseHandler/peak_handler.h"
+#include "PeakMicroPulseHandler/loopback_instrument.h"
+#include "PeakMicroPulseHandler/synthetic_generator.h"
+
+
+struct Result {
+    std::string                        name;
+    double                             throughput;
+    std::string                        unit;
+};
+
+
+// The driver logs every frame, which would otherwise be timed along with it
+class SilenceConsole {
+public:
+    SilenceConsole() : null_stream_(nullptr), previous_(std::cout.rdbuf(null_stream_.rdbuf())) {}
+    ~SilenceConsole() { std::cout.rdbuf(previous_); }
+private:
+    std::ostream                       null_stream_;
+    std::streambuf*                    previous_;
+};
+
+
+// Best over repeats of work done per second, each repeat running for at least min_seconds.
+// The best repeat is the least disturbed by other load on the machine, yet on a shared
+// machine whole runs still spread widely, which the per-benchmark tolerances allow for.
+double measure(const std::function<void()>& call, const double& work_per_call, const double& min_seconds = 0.5, const int& repeats = 7)
+{
+    SilenceConsole silence;
+    call();
+
+    std::vector<double> rates;
+    for (int r = 0; r < repeats; r++) {
+        long calls = 0;
+        const auto start = std::chrono::steady_clock::now();
+        double elapsed = 0.0;
+        while (elapsed < min_seconds) {
+            call();
+            calls++;
+            elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        rates.push_back(calls * work_per_call / elapsed);
+    }
+
+    return *std::max_element(rates.begin(), rates.end());
+}
+
+
+PeakHandler::DofMessage decodeSink;
+
+
+double decodeThroughput(PeakHandler& peak_handler, const std::vector<unsigned char>& packet, const int& message_length)
+{
+    // One message at a time, as sendDataRequest hands them over
+    const int n_messages = packet.size() / message_length;
+    std::vector<std::vector<unsigned char>> messages;
+    for (int i = 0; i < n_messages; i++) {
+        messages.emplace_back(packet.begin() + i * message_length, packet.begin() + (i + 1) * message_length);
+    }
+
+    return measure([&]() {
+        for (const auto& message : messages) {
+            decodeSink = peak_handler.dataOutpoutFormatReader(message);
+        }
+    }, packet.size() / 1e6);
+}
+
+
+// Keeps the tolerance of each benchmark that has its own in the baselines
+void writeResults(const std::string& path, const std::vector<Result>& results, const double& tolerance,
+                  const boost::property_tree::ptree& baselines)
+{
+    std::ofstream file(path);
+    file << std::fixed << std::setprecision(3);
+    file << "{\n    \"tolerance\": " << tolerance << ",\n    \"benchmarks\": {\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        file << "        \"" << results[i].name << "\": { \"throughput\": " << results[i].throughput
+             << ", \"unit\": \"" << results[i].unit << "\"";
+        const auto own_tolerance = baselines.get_optional<double>("benchmarks." + results[i].name + ".tolerance");
+        if (own_tolerance) {
+            file << ", \"tolerance\": " << *own_tolerance;
+        }
+        file << " }" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    file << "    }\n}\n";
+}
+
+
+auto main(int argc, char** argv) -> int
+{
+    std::string baseline_file = "benchmarks/baselines/regression_baselines.json";
+    std::string output_file;
+    std::string mps_file = "examples/mps/roller_probe.mps";
+    bool update = false;
+
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--baseline" and i + 1 < argc) {
+            baseline_file = argv[++i];
+        } else if (arg == "--output" and i + 1 < argc) {
+            output_file = argv[++i];
+        } else if (arg == "--mps" and i + 1 < argc) {
+            mps_file = argv[++i];
+        } else if (arg == "--update") {
+            update = true;
+        } else {
+            std::cout << "Usage: regression_suite [--baseline file] [--output file] [--mps file] [--update]" << std::endl;
+            return 2;
+        }
+    }
+
+    // Read first, a gate with nothing to compare with fails before taking the time to measure
+    double default_tolerance = 0.3;
+    boost::property_tree::ptree baselines;
+    bool have_baselines = false;
+    try {
+        boost::property_tree::read_json(baseline_file, baselines);
+        default_tolerance = baselines.get<double>("tolerance", default_tolerance);
+        have_baselines = true;
+    } catch (const boost::property_tree::json_parser_error& e) {
+        if (not update) {
+            std::cout << "\033[31m" << "No baselines read from " << baseline_file << ", record them with --update" << "\033[0m" << std::endl;
+            return 1;
+        }
+    }
+
+    LoopbackInstrument instrument;
+    instrument.start();
+
+    PeakHandler peak_handler(10, "127.0.0.1", instrument.port(), mps_file);
+    peak_handler.setResetWait(0);
+    peak_handler.setReconstructionConfiguration(64, 0.8, 0.1, 0.7, 1480.0, 1480.0, 6320.0, 0.0, 8.0, 0.1, 20.0);
+    if (not peak_handler.readMpsFile()) {
+        return 1;
+    }
+    peak_handler.connect();
+    peak_handler.sendMpsConfiguration();
+
+    const PeakHandler::OutputFormat* ltpa_data_ptr(peak_handler.ltpa_data_ptr());
+    const int ascan_length = ltpa_data_ptr->ascan_length;
+
+    std::vector<Result> results;
+
+    // DOF message decoding
+    for (const int dof : {1, 4}) {
+        SyntheticGenerator generator(*ltpa_data_ptr, peak_handler.gate_start_, dof, 256);
+        generator.addScatterer(0.0, 10.0, 0.2);
+        std::vector<unsigned char> packet;
+        {
+            SilenceConsole silence;
+            generator.generatePacket(packet);
+        }
+        const int message_length = 8 + (dof == 4 ? 2 : 1) * ascan_length;
+        results.push_back({"dof" + std::to_string(dof) + "_decode", decodeThroughput(peak_handler, packet, message_length), "MB/s"});
+    }
+
+    // Frame loop of sendDataRequest against the loopback
+    SyntheticGenerator generator(*ltpa_data_ptr, peak_handler.gate_start_, peak_handler.dof_, 256);
+    generator.addScatterer(0.0, 10.0, 0.2);
+    instrument.setFrameSource([&generator](std::vector<unsigned char>& packet, const long& /*frame*/) {
+        generator.generatePacket(packet);
+    });
+    results.push_back({"frame_loop", measure([&]() { peak_handler.sendDataRequest(); }, 1.0), "frames/s"});
+
+    // Lazy decoding, reading four A-Scans of each frame as a monitoring task would
+    LoopbackInstrument lazy_instrument;
+    lazy_instrument.start();
+    lazy_instrument.setFrameSource([&generator](std::vector<unsigned char>& packet, const long& /*frame*/) {
+        generator.generatePacket(packet);
+    });
+
+    PeakHandler lazy_handler(10, "127.0.0.1", lazy_instrument.port(), mps_file);
+    {
+        SilenceConsole silence;
+        lazy_handler.setResetWait(0);
+        lazy_handler.setLazyDecode(true);
+        if (not lazy_handler.readMpsFile()) {
+            return 1;
+        }
+        lazy_handler.connect();
+        lazy_handler.sendMpsConfiguration();
+    }
+    const int n_ascans = ltpa_data_ptr->num_a_scans;
+    results.push_back({"frame_loop_lazy", measure([&]() {
+        if (lazy_handler.sendDataRequest()) {
+            for (int i = 0; i < 4; i++) {
+                lazy_handler.ascanAt(i * n_ascans / 4);
+            }
+        }
+    }, 1.0), "frames/s"});
+
+    for (const PeakHandler* handler : {&peak_handler, &lazy_handler}) {
+        const auto& link_statistics = handler->link_statistics();
+        if (link_statistics.frames_valid != link_statistics.frames_requested) {
+            std::cout << "\033[31m" << "Frame loop dropped " << link_statistics.frames_dropped << " frames" << "\033[0m" << std::endl;
+            return 1;
+        }
+    }
+
+    instrument.stop();
+    lazy_instrument.stop();
+
+    // MPS parsing
+    PeakHandler mps_reader(10, "127.0.0.1", 0, mps_file);
+    results.push_back({"read_mps", measure([&]() { mps_reader.readMpsFile(); }, 1.0), "files/s"});
+
+    // Comparison with the stored baselines
+    bool regressed = false;
+    std::cout << std::endl << std::left << std::setw(16) << "Benchmark" << std::right
+              << std::setw(14) << "Throughput" << std::setw(14) << "Baseline" << std::setw(10) << "Change" << "  Result" << std::endl;
+
+    for (const auto& result : results) {
+        std::cout << std::left << std::setw(16) << result.name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(14) << result.throughput;
+
+        const auto baseline = have_baselines ? baselines.get_child_optional("benchmarks." + result.name) : boost::none;
+        if (not baseline) {
+            std::cout << std::setw(14) << "-" << std::setw(10) << "-" << "  new " << result.unit << std::endl;
+            continue;
+        }
+
+        const double expected = baseline->get<double>("throughput");
+        const double tolerance = baseline->get<double>("tolerance", default_tolerance);
+        const double change = expected > 0.0 ? result.throughput / expected - 1.0 : 0.0;
+        const bool failed = change < -tolerance;
+        regressed = regressed or failed;
+
+        std::cout << std::setw(14) << expected << std::setw(9) << change * 100.0 << "%"
+                  << (failed ? "  \033[31mREGRESSED\033[0m " : "  ok ") << result.unit << std::endl;
+    }
+
+    if (not output_file.empty()) {
+        writeResults(output_file, results, default_tolerance, baselines);
+    }
+    if (update) {
+        writeResults(baseline_file, results, default_tolerance, baselines);
+        std::cout << "Baselines written to " << baseline_file << std::endl;
+        return 0;
+    }
+
+    return regressed ? 1 : 0;
+}
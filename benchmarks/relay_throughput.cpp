@@ -0,0 +1,118 @@
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include "PeakMicroPulseHandler/peak_handler.h"
+#include "PeakMicroPulseHandler/frame_relay.h"
+#include "PeakMicroPulseHandler/synthetic_generator.h"
+
+
+double readPrf(const std::string& mps_file)
+{
+    std::ifstream file(mps_file);
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream command(line);
+        std::string name;
+        double prf;
+        if (command >> name and name == "PRF" and command >> prf) {
+            return prf;
+        }
+    }
+    return 0.0;
+}
+
+
+// Relays synthetic frames over localhost, as fast as the link takes them or at the MPS
+// frame rate, and checks every frame received against the one sent
+auto main(int argc, char** argv) -> int
+{
+    const std::string mps_file = argc > 1 ? argv[1] : "examples/mps/roller_probe.mps";
+    const FrameRelay::Transport transport = argc > 2 and std::string(argv[2]) == "udp" ? FrameRelay::udp : FrameRelay::tcp;
+    const FrameRelay::Compression compression = argc > 3 and std::string(argv[3]) == "delta" ? FrameRelay::delta : FrameRelay::none;
+    const int n_frames = argc > 4 ? std::stoi(argv[4]) : 2000;
+    const int batch_frames = argc > 5 ? std::stoi(argv[5]) : 4;
+    const bool real_time = argc > 6 and std::string(argv[6]) == "real_time";    // Paced at the MPS frame rate
+
+    // Only the frame geometry is needed from the driver
+    PeakHandler peak_handler(10, "127.0.0.1", 0, mps_file);
+    peak_handler.setReconstructionConfiguration(64, 0.8, 0.1, 0.7, 1480.0, 1480.0, 6320.0, 0.0, 8.0, 0.1, 20.0);
+    if (not peak_handler.readMpsFile()) {
+        return 1;
+    }
+    const PeakHandler::OutputFormat* ltpa_data_ptr(peak_handler.ltpa_data_ptr());
+
+    // A few frames generated up front and sent in turn, so the generator is not what is timed
+    SyntheticGenerator generator(*ltpa_data_ptr, peak_handler.gate_start_, peak_handler.dof_, 256);
+    generator.addScatterer(0.0, 10.0, 0.2);
+    std::vector<PeakHandler::OutputFormat> frames(8);
+    for (auto& frame : frames) {
+        generator.generate(frame);
+    }
+
+    const double prf = readPrf(mps_file);
+    const double real_time_fps = prf > 0.0 ? prf / ltpa_data_ptr->num_a_scans : 0.0;
+
+    FrameRelayReceiver receiver(0, transport, 32);
+    receiver.start();
+    FrameRelay relay("127.0.0.1", receiver.port(), transport, compression, batch_frames, 32);
+
+    long mismatched = 0;
+    long received = 0;
+    auto start = std::chrono::steady_clock::now();
+    auto last_received = start;
+    std::thread consumer([&]() {
+        while (true) {
+            auto frame = receiver.pop(500);
+            if (frame == nullptr) {
+                break;
+            }
+            const PeakHandler::OutputFormat& sent = frames[frame->frame_number % frames.size()];
+            bool matches = frame->ascans.size() == sent.ascans.size();
+            for (size_t i = 0; matches and i < sent.ascans.size(); i++) {
+                matches = frame->ascans[i].amps == sent.ascans[i].amps and
+                          frame->ascans[i].header.testNo == sent.ascans[i].header.testNo;
+            }
+            mismatched += matches ? 0 : 1;
+            received++;
+            last_received = std::chrono::steady_clock::now();
+        }
+    });
+
+    start = std::chrono::steady_clock::now();
+    for (int f = 0; f < n_frames; f++) {
+        if (real_time and real_time_fps > 0.0) {
+            std::this_thread::sleep_until(start + std::chrono::microseconds((long)(f * 1e6 / real_time_fps)));
+        }
+        PeakHandler::OutputFormat& frame = frames[f % frames.size()];
+        frame.frame_number = f;
+        while (not relay.push(frame) and relay.good()) {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    }
+    relay.close();
+    consumer.join();
+    const double seconds = std::max(std::chrono::duration<double>(last_received - start).count(), 1e-9);
+    receiver.stop();
+
+    std::cout << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Transport              " << std::setw(10) << (transport == FrameRelay::tcp ? "TCP" : "UDP") << std::endl;
+    std::cout << "Compression            " << std::setw(10) << (compression == FrameRelay::delta ? "delta" : "none") << std::endl;
+    std::cout << "Frames received        " << std::setw(10) << received << " of " << n_frames << std::endl;
+    std::cout << "Batches lost           " << std::setw(10) << receiver.batchesLost() << std::endl;
+    std::cout << "Frames per second      " << std::setw(10) << received / seconds << std::endl;
+    std::cout << "Real time              " << std::setw(10) << real_time_fps << std::endl;
+    std::cout << "Sample data            " << std::setw(10) << relay.sampleBytes() / seconds / (1024.0 * 1024.0) << " MB/s" << std::endl;
+    std::cout << "On the wire            " << std::setw(10) << relay.bytesSent() / seconds / (1024.0 * 1024.0) << " MB/s" << std::endl;
+    std::cout << "Compression ratio      " << std::setw(10) << std::setprecision(2) << (double)relay.sampleBytes() / std::max<size_t>(relay.bytesSent(), 1) << std::endl;
+
+    if (mismatched > 0 or received == 0) {
+        std::cout << "\033[31m" << mismatched << " frames did not match those sent" << "\033[0m" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+
+#include "PeakMicroPulseHandler/peak_handler.h"
+#include "PeakMicroPulseHandler/scan_converter.h"
+#include "PeakMicroPulseHandler/synthetic_generator.h"
+
+
+double millisecondsSince(const std::chrono::steady_clock::time_point& start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+// Builds scan conversion tables from the .mps focal laws for B-Scans, and from a sector of
+// angles for S-Scans, at common display sizes. Reports how long the tables take to build
+// and to apply to a frame. Checks the focal laws give the beams of the sweep, and that a
+// steered law is refracted to the angle it was programmed for.
+auto main(int argc, char** argv) -> int
+{
+    const std::string mps_file = argc > 1 ? argv[1] : "examples/mps/roller_probe.mps";
+    const int n_frames = argc > 2 ? std::stoi(argv[2]) : 100;
+
+    // Only the frame geometry and focal laws are needed from the driver
+    PeakHandler peak_handler(10, "127.0.0.1", 0, mps_file);
+    peak_handler.setReconstructionConfiguration(64, 0.8, 0.1, 0.7, 1480.0, 1480.0, 6320.0, 0.0, 8.0, 0.1, 20.0);
+    if (not peak_handler.readMpsFile()) {
+        return 1;
+    }
+    const PeakHandler::OutputFormat* ltpa_data_ptr(peak_handler.ltpa_data_ptr());
+
+    SyntheticGenerator generator(*ltpa_data_ptr, peak_handler.gate_start_, peak_handler.dof_, 256);
+    generator.addScatterer(0.0, 10.0, 0.5);
+    PeakHandler::OutputFormat frame;
+    generator.generate(frame);
+
+    // The roller probe's laws fire four elements together, stepping one element a test
+    const std::vector<ScanConverter::Beam> law_beams = ScanConverter::focalLawBeams(*ltpa_data_ptr, peak_handler.focalLaws());
+    const std::vector<ScanConverter::Beam> sweep_beams = ScanConverter::linearBeams(*ltpa_data_ptr, 4);
+    int matching = 0;
+    for (size_t a = 0; a < std::min(law_beams.size(), sweep_beams.size()); a++) {
+        matching += std::fabs(law_beams[a].origin - sweep_beams[a].origin) < 1e-9 and
+                    std::fabs(law_beams[a].angle - sweep_beams[a].angle) < 1e-9 and law_beams[a].delay == 0.0 ? 1 : 0;
+    }
+
+    // A 16 element law with a linear delay ramp for 45 degrees refracted under the wedge
+    const double steered_angle = 45.0;
+    const double incidence = std::asin(ltpa_data_ptr->vel_wedge / ltpa_data_ptr->vel_material * std::sin(steered_angle * std::acos(-1.0) / 180.0));
+    PeakHandler::FocalLaws steered = {};
+    steered.transmit.resize(2);
+    for (int e = 0; e < 16; e++) {
+        const double x = (e - 0.5 * (ltpa_data_ptr->n_elements - 1)) * ltpa_data_ptr->element_pitch;
+        steered.transmit[1].elements.push_back(e);
+        steered.transmit[1].delays.push_back(5.0 + x * std::sin(incidence) / (ltpa_data_ptr->vel_wedge / 1000.0));
+    }
+    steered.transmit_laws = {1};
+    PeakHandler::OutputFormat one_law;
+    PeakHandler::copyFrameMetadata(*ltpa_data_ptr, one_law);
+    one_law.num_a_scans = 1;
+    const double recovered_angle = ScanConverter::focalLawBeams(one_law, steered)[0].angle;
+
+    std::vector<double> angles;
+    for (int a = 0; a < ltpa_data_ptr->num_a_scans; a++) {
+        angles.push_back(-30.0 + 60.0 * a / std::max(ltpa_data_ptr->num_a_scans - 1, 1));
+    }
+    const std::vector<ScanConverter::Beam> sector_beams =
+        ScanConverter::sectorBeams(*ltpa_data_ptr, 0.5 * (ltpa_data_ptr->n_elements - 1), angles);
+
+    const double half_width = 0.5 * ltpa_data_ptr->num_a_scans * ltpa_data_ptr->element_pitch;
+    const std::vector<std::pair<int, int>> sizes = {{256, 256}, {640, 480}, {800, 600}, {1024, 768}, {1280, 720}, {1920, 1080}};
+
+    std::cout << std::endl << std::fixed << std::setprecision(1);
+    std::cout << std::setw(12) << "Pixels" << std::setw(12) << "Tables kB"
+              << std::setw(12) << "B build ms" << std::setw(12) << "B us" << std::setw(12) << "B Mpx/s"
+              << std::setw(12) << "S build ms" << std::setw(12) << "S us" << std::setw(12) << "S Mpx/s" << std::endl;
+
+    std::vector<float> amplitudes;
+    for (const auto& size : sizes) {
+        const ScanConverter::View view = {-half_width, half_width, 0.0, ltpa_data_ptr->specimen_depth, size.first, size.second};
+        std::vector<double> results;
+        size_t footprint = 0;
+        for (int product = 0; product < 2; product++) {
+            auto start = std::chrono::steady_clock::now();
+            ScanConverter converter = product == 0 ?
+                ScanConverter(peak_handler, view) :
+                ScanConverter(*ltpa_data_ptr, peak_handler.gate_start_, sector_beams, view);
+            const double build_ms = millisecondsSince(start);
+            converter.convert(frame, amplitudes);
+
+            start = std::chrono::steady_clock::now();
+            for (int f = 0; f < n_frames; f++) {
+                converter.convert(frame, amplitudes);
+            }
+            const double us = 1000.0 * millisecondsSince(start) / n_frames;
+            results.insert(results.end(), {build_ms, us, converter.pixels() / us});
+            footprint = product == 0 ? converter.footprint() : footprint;
+        }
+
+        std::cout << std::setw(12) << std::to_string(size.first) + "x" + std::to_string(size.second) << std::setw(12) << footprint / 1024;
+        for (const double& result : results) {
+            std::cout << std::setw(12) << result;
+        }
+        std::cout << std::endl;
+    }
+
+    std::cout << std::endl;
+    std::cout << "Focal law beams        " << std::setw(10) << matching << " of " << sweep_beams.size() << " match the sweep" << std::endl;
+    std::cout << "Steered law            " << std::setw(10) << recovered_angle << " degrees for " << steered_angle << std::endl;
+
+    if (matching != (int)sweep_beams.size() or law_beams.size() != sweep_beams.size()) {
+        std::cout << "\033[31m" << "Focal laws do not give the beams of the sweep" << "\033[0m" << std::endl;
+        return 1;
+    }
+    if (not (std::fabs(recovered_angle - steered_angle) < 1e-6)) {
+        std::cout << "\033[31m" << "Steered law is not refracted to " << steered_angle << " degrees" << "\033[0m" << std::endl;
+        return 1;
+    }
+    return 0;
+}
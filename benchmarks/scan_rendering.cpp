@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+
+#include "PeakMicroPulseHandler/peak_handler.h"
+#include "PeakMicroPulseHandler/scan_renderer.h"
+#include "PeakMicroPulseHandler/synthetic_generator.h"
+
+
+// Writes an image as binary PPM, dropping the alpha
+void writePpm(const std::string& path, const ScanRenderer::Image& image)
+{
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        return;
+    }
+    std::fprintf(file, "P6\n%d %d\n255\n", image.width, image.height);
+    for (const uint32_t& pixel : image.pixels) {
+        const unsigned char rgb[3] = {(unsigned char)pixel, (unsigned char)(pixel >> 8), (unsigned char)(pixel >> 16)};
+        std::fwrite(rgb, 1, 3, file);
+    }
+    std::fclose(file);
+}
+
+
+// Renders a synthetic sweep with a scatterer as a B-Scan and as an S-Scan, times both and
+// checks the B-Scan places the scatterer at its depth
+auto main(int argc, char** argv) -> int
+{
+    const std::string mps_file = argc > 1 ? argv[1] : "examples/mps/roller_probe.mps";
+    const int width = argc > 2 ? std::stoi(argv[2]) : 640;
+    const int height = argc > 3 ? std::stoi(argv[3]) : 480;
+    const int n_frames = argc > 4 ? std::stoi(argv[4]) : 1000;
+    const std::string output = argc > 5 ? argv[5] : "";        // Writes output_bscan.ppm and output_sscan.ppm if given
+
+    // Only the frame geometry is needed from the driver
+    PeakHandler peak_handler(10, "127.0.0.1", 0, mps_file);
+    peak_handler.setReconstructionConfiguration(64, 0.8, 0.1, 0.7, 1480.0, 1480.0, 6320.0, 0.0, 8.0, 0.1, 20.0);
+    if (not peak_handler.readMpsFile()) {
+        return 1;
+    }
+    const PeakHandler::OutputFormat* ltpa_data_ptr(peak_handler.ltpa_data_ptr());
+
+    const double scatterer_x = 0.0;
+    const double scatterer_z = 10.0;
+    SyntheticGenerator generator(*ltpa_data_ptr, peak_handler.gate_start_, peak_handler.dof_, 256);
+    generator.addScatterer(scatterer_x, scatterer_z, 0.5);
+    generator.setEchoAmplitudes(0.2, 0.3);
+    PeakHandler::OutputFormat frame;
+    generator.generate(frame);
+
+    // Sector of the sweep's A-Scans about the array centre, to time the S-Scan path
+    std::vector<double> angles;
+    for (int a = 0; a < ltpa_data_ptr->num_a_scans; a++) {
+        angles.push_back(-30.0 + 60.0 * a / std::max(ltpa_data_ptr->num_a_scans - 1, 1));
+    }
+
+    const double half_width = 0.5 * ltpa_data_ptr->num_a_scans * ltpa_data_ptr->element_pitch;
+    const ScanRenderer::View view = {-half_width, half_width, 0.0, ltpa_data_ptr->specimen_depth, width, height};
+    ScanRenderer b_scan(*ltpa_data_ptr, peak_handler.gate_start_, ScanConverter::linearBeams(*ltpa_data_ptr), view);
+    ScanRenderer s_scan(*ltpa_data_ptr, peak_handler.gate_start_,
+                        ScanConverter::sectorBeams(*ltpa_data_ptr, 0.5 * (ltpa_data_ptr->n_elements - 1), angles), view);
+    b_scan.setGain(6.0);
+    s_scan.setGain(6.0);
+
+    std::cout << std::endl << std::fixed << std::setprecision(1);
+    std::cout << "Pixels                 " << std::setw(10) << width * height << std::endl;
+
+    ScanRenderer::Image b_image;
+    ScanRenderer::Image s_image;
+    for (auto product : {std::make_pair("B-Scan", &b_scan), std::make_pair("S-Scan", &s_scan)}) {
+        ScanRenderer::Image& image = product.second == &b_scan ? b_image : s_image;
+        product.second->render(frame, image);
+
+        const auto start = std::chrono::steady_clock::now();
+        for (int f = 0; f < n_frames; f++) {
+            product.second->render(frame, image);
+        }
+        const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / n_frames;
+        std::cout << product.first << "                 " << std::setw(10) << us << " us a frame, "
+                  << product.second->footprint() / 1024 << " kB of tables" << std::endl;
+    }
+
+    if (not output.empty()) {
+        writePpm(output + "_bscan.ppm", b_image);
+        writePpm(output + "_sscan.ppm", s_image);
+    }
+
+    // Down the scatterer's column in grey, between the surface and backwall echoes, its echo is the brightest
+    ScanRenderer grey_scan(*ltpa_data_ptr, peak_handler.gate_start_, ScanConverter::linearBeams(*ltpa_data_ptr), view, ScanRenderer::grey);
+    ScanRenderer::Image grey_image;
+    grey_scan.render(frame, grey_image);
+    const int column = std::lround((scatterer_x - view.x_min) / (view.x_max - view.x_min) * (width - 1));
+    const double pixel_depth = (view.z_max - view.z_min) / (height - 1);
+    int brightest = 0;
+    int brightest_row = -1;
+    for (int row = 0; row < height; row++) {
+        const double z = view.z_min + row * pixel_depth;
+        const int level = grey_image.pixels[(size_t)row * width + column] & 0xFF;
+        if (z > 1.0 and z < ltpa_data_ptr->specimen_depth - 1.0 and level > brightest) {
+            brightest = level;
+            brightest_row = row;
+        }
+    }
+    const double z = view.z_min + brightest_row * pixel_depth;
+    std::cout << "Scatterer echo         " << std::setw(10) << z << " mm deep" << std::endl;
+
+    if (std::fabs(z - scatterer_z) > 1.0) {
+        std::cout << "\033[31m" << "B-Scan does not place the scatterer at " << scatterer_x << ", " << scatterer_z << " mm" << "\033[0m" << std::endl;
+        return 1;
+    }
+    return 0;
+}
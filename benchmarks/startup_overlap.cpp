@@ -0,0 +1,99 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "PeakMicroPulseHandler/peak_handler.h"
+#include "PeakMicroPulseHandler/layered_medium.h"
+#include "PeakMicroPulseHandler/loopback_instrument.h"
+#include "PeakMicroPulseHandler/startup_orchestrator.h"
+
+
+// Element to pixel travel times over a square grid below the array, standing in for
+// the delay tables an imaging stage builds before its first frame
+std::vector<float> buildDelayTable(const PeakHandler::OutputFormat& geometry, const int& grid)
+{
+    const LayeredMedium medium(geometry);
+    const double width = medium.nElements() * geometry.element_pitch;
+    const double depth = medium.specimenDepth() > 0.0 ? medium.specimenDepth() : width;
+
+    std::vector<float> table((size_t)medium.nElements() * grid * grid);
+    for (int e = 0; e < medium.nElements(); e++) {
+        const double element_x = medium.elementPosition(e);
+        for (int z = 0; z < grid; z++) {
+            for (int x = 0; x < grid; x++) {
+                const double pixel_x = -0.5 * width + width * x / grid;
+                table[((size_t)e * grid + z) * grid + x] = medium.travelTime(pixel_x - element_x, depth * (z + 1) / grid);
+            }
+        }
+    }
+    return table;
+}
+
+
+// Times startup from readMpsFile to the MPS commands being sent, first one phase after
+// another and then through StartupOrchestrator
+auto main(int argc, char** argv) -> int
+{
+    const std::string mps_file = argc > 1 ? argv[1] : "examples/mps/roller_probe.mps";
+    const int reset_wait = argc > 2 ? std::stoi(argv[2]) : 1;
+    const int grid = argc > 3 ? std::stoi(argv[3]) : 128;
+
+    auto configure = [&](PeakHandler& peak_handler) {
+        peak_handler.setResetWait(reset_wait);
+        peak_handler.setReconstructionConfiguration(64, 0.8, 0.1, 0.7, 1480.0, 1480.0, 6320.0, 0.0, 8.0, 0.1, 20.0);
+    };
+
+    double serial_ms = 0.0;
+    size_t serial_entries = 0;
+    {
+        LoopbackInstrument instrument;
+        instrument.start();
+        PeakHandler peak_handler(10, "127.0.0.1", instrument.port(), mps_file);
+        configure(peak_handler);
+
+        const auto start = std::chrono::steady_clock::now();
+        if (not peak_handler.readMpsFile()) {
+            return 1;
+        }
+        peak_handler.connect();
+        serial_entries = buildDelayTable(*peak_handler.ltpa_data_ptr(), grid).size();
+        peak_handler.sendMpsConfiguration();
+        serial_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        instrument.stop();
+    }
+
+    double overlapped_ms = 0.0;
+    size_t overlapped_entries = 0;
+    bool ready = false;
+    {
+        LoopbackInstrument instrument;
+        instrument.start();
+        PeakHandler peak_handler(10, "127.0.0.1", instrument.port(), mps_file);
+        configure(peak_handler);
+
+        StartupOrchestrator startup(peak_handler);
+        std::vector<float> delay_table;
+        startup.addTask("delay table", [&]() {
+            delay_table = buildDelayTable(*peak_handler.ltpa_data_ptr(), grid);
+        });
+        ready = startup.run();
+        startup.report();
+        overlapped_ms = startup.elapsed();
+        overlapped_entries = delay_table.size();
+        instrument.stop();
+    }
+
+    std::cout << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Reset wait             " << std::setw(10) << reset_wait * 1000.0 << " ms" << std::endl;
+    std::cout << "Delay table entries    " << std::setw(10) << serial_entries << std::endl;
+    std::cout << "Serial startup         " << std::setw(10) << serial_ms << " ms" << std::endl;
+    std::cout << "Overlapped startup     " << std::setw(10) << overlapped_ms << " ms" << std::endl;
+
+    if (not ready or overlapped_entries != serial_entries) {
+        std::cout << "\033[31m" << "Overlapped startup did not complete" << "\033[0m" << std::endl;
+        return 1;
+    }
+    return 0;
+}
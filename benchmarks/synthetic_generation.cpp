@@ -0,0 +1,101 @@
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include "PeakMicroPulseHandler/peak_handler.h"
+#include "PeakMicroPulseHandler/loopback_instrument.h"
+#include "PeakMicroPulseHandler/synthetic_generator.h"
+
+
+// Pulse repetition frequency from the .mps file, one test fires per pulse
+double readPrf(const std::string& mps_file)
+{
+    std::ifstream file(mps_file);
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream command(line);
+        std::string name;
+        double prf;
+        if (command >> name and name == "PRF" and command >> prf) {
+            return prf;
+        }
+    }
+    return 0.0;
+}
+
+
+auto main(int argc, char** argv) -> int
+{
+    const std::string mps_file = argc > 1 ? argv[1] : "examples/mps/roller_probe.mps";
+    const int n_frames = argc > 2 ? std::stoi(argv[2]) : 2000;
+
+    LoopbackInstrument instrument;
+    instrument.start();
+
+    PeakHandler peak_handler(10, "127.0.0.1", instrument.port(), mps_file);
+    peak_handler.setResetWait(0);
+    peak_handler.setReconstructionConfiguration(64, 0.8, 0.1, 0.7, 1480.0, 1480.0, 6320.0, 0.0, 8.0, 0.1, 20.0);
+    if (not peak_handler.readMpsFile()) {
+        return 1;
+    }
+    peak_handler.connect();
+    peak_handler.sendMpsConfiguration();
+
+    const PeakHandler::OutputFormat* ltpa_data_ptr(peak_handler.ltpa_data_ptr());
+
+    SyntheticGenerator generator(*ltpa_data_ptr, peak_handler.gate_start_, peak_handler.dof_, 256);
+    generator.addScatterer(0.0, 10.0, 0.2);
+    generator.addScatterer(-8.0, 15.0, 0.1);
+
+    const double prf = readPrf(mps_file);
+    const double real_time_fps = prf > 0.0 ? prf / ltpa_data_ptr->num_a_scans : 0.0;
+
+    // Decoded frames
+    PeakHandler::OutputFormat frame;
+    generator.generate(frame);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n_frames; i++) {
+        generator.generate(frame);
+    }
+    const double frame_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Raw packets
+    std::vector<unsigned char> packet;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n_frames; i++) {
+        generator.generatePacket(packet);
+    }
+    const double packet_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Raw packets served by the loopback and decoded by the driver
+    instrument.setFrameSource([&generator](std::vector<unsigned char>& packet, const long& /*frame*/) {
+        generator.generatePacket(packet);
+    });
+    const int n_requests = std::max(1, n_frames / 10);
+    int valid = 0;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n_requests; i++) {
+        valid += peak_handler.sendDataRequest() ? 1 : 0;
+    }
+    const double loopback_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << std::endl;
+    std::cout << "A-Scans per frame:    " << ltpa_data_ptr->num_a_scans << " x " << ltpa_data_ptr->ascan_length << " samples" << std::endl;
+    std::cout << "Real time:            " << std::fixed << std::setprecision(1) << real_time_fps << " frames/s at PRF " << prf << std::endl;
+    std::cout << std::left << std::setw(22) << "Output" << std::right << std::setw(14) << "frames/s" << std::setw(14) << "x real time" << std::endl;
+
+    auto row = [&](const std::string& name, const double& frames, const double& seconds) {
+        const double fps = frames / seconds;
+        std::cout << std::left << std::setw(22) << name << std::right << std::setw(14) << fps
+                  << std::setw(14) << (real_time_fps > 0.0 ? fps / real_time_fps : 0.0) << std::endl;
+    };
+    row("OutputFormat", n_frames, frame_s);
+    row("DOF packet", n_frames, packet_s);
+    row("Loopback decode", n_requests, loopback_s);
+    std::cout << "Valid loopback frames: " << valid << " / " << n_requests << std::endl;
+
+    instrument.stop();
+
+    return 0;
+}
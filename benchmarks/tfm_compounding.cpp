@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+
+#include "PeakMicroPulseHandler/peak_handler.h"
+#include "PeakMicroPulseHandler/synthetic_generator.h"
+#include "PeakMicroPulseHandler/tfm_imager.h"
+
+
+// Peak over the scatterer against the RMS of the image further than 3 mm from it
+double signalToNoise(const TfmImager& imager, const TfmImager::Image& image, const double& x, const double& z)
+{
+    double peak = 0.0;
+    double noise = 0.0;
+    long n_noise = 0;
+    for (int iz = 0; iz < image.tile.nz; iz++) {
+        for (int ix = 0; ix < image.tile.nx; ix++) {
+            const double value = image.pixels[(size_t)iz * image.tile.nx + ix];
+            const double distance = std::hypot(imager.pixelX(image.tile.x0 + ix) - x, imager.pixelZ(image.tile.z0 + iz) - z);
+            if (distance < 1.0) {
+                peak = std::max(peak, value);
+            } else if (distance > 3.0) {
+                noise += value * value;
+                n_noise++;
+            }
+        }
+    }
+    return n_noise > 0 and noise > 0.0 ? peak / std::sqrt(noise / n_noise) : 0.0;
+}
+
+
+// Compounds noisy full matrix capture frames, and the direct and half skip paths, into one
+// TFM image in a single pass. Times each against imaging single frames and single paths,
+// checks the fused paths match separate images of each path averaged afterwards, and
+// reports how much compounding frames raises the scatterer above the noise.
+auto main(int argc, char** argv) -> int
+{
+    const std::string mps_file = argc > 1 ? argv[1] : "examples/mps/roller_probe.mps";
+    const int n_frames = argc > 2 ? std::stoi(argv[2]) : 4;
+    const int repeats = argc > 3 ? std::stoi(argv[3]) : 5;
+    const int n_elements = argc > 4 ? std::stoi(argv[4]) : 32;
+    const double noise_level = argc > 5 ? std::stod(argv[5]) : 0.2;
+
+    // Only the frame geometry is needed from the driver, made full matrix capture
+    PeakHandler peak_handler(10, "127.0.0.1", 0, mps_file);
+    peak_handler.setReconstructionConfiguration(n_elements, 0.8, 0.1, 0.7, 1480.0, 1480.0, 6320.0, 0.0, 8.0, 0.1, 20.0);
+    if (not peak_handler.readMpsFile()) {
+        return 1;
+    }
+    PeakHandler::OutputFormat geometry;
+    PeakHandler::copyFrameMetadata(*peak_handler.ltpa_data_ptr(), geometry);
+    geometry.num_a_scans = n_elements * n_elements;
+
+    const double scatterer_x = 0.0;
+    const double scatterer_z = 10.0;
+    SyntheticGenerator generator(geometry, peak_handler.gate_start_, peak_handler.dof_, 256);
+    generator.addScatterer(scatterer_x, scatterer_z, 0.1);
+    generator.setNoiseLevel(noise_level);
+    std::vector<PeakHandler::OutputFormat> frames(std::max(n_frames, 1));
+    std::vector<const PeakHandler::OutputFormat*> frame_pointers;
+    for (auto& frame : frames) {
+        generator.generate(frame);
+        frame_pointers.push_back(&frame);
+    }
+
+    const TfmImager::Grid grid = {-12.0, 12.0, 1.0, 19.0, 128, 96};
+    TfmImager direct(geometry, peak_handler.gate_start_, grid, {0, 0, 0, 0}, 1);
+    TfmImager skip(geometry, peak_handler.gate_start_, grid, {0, 0, 0, 0}, 1);
+    TfmImager both(geometry, peak_handler.gate_start_, grid, {0, 0, 0, 0}, 1);
+    skip.setModes({TfmImager::half_skip});
+    both.setModes({TfmImager::direct, TfmImager::half_skip});
+
+    const auto timed = [&](const std::function<void()>& work) {
+        work();
+        const auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < repeats; r++) {
+            work();
+        }
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / repeats;
+    };
+
+    TfmImager::Image single;
+    TfmImager::Image compounded;
+    TfmImager::Image direct_image;
+    TfmImager::Image skip_image;
+    TfmImager::Image fused;
+    TfmImager::Image fused_frames;
+    std::vector<float> separate(grid.nx * grid.nz);
+
+    const double single_ms = timed([&]() { direct.process(frames[0], single); });
+    const double frames_ms = timed([&]() { direct.process(frame_pointers, compounded); });
+    const double separate_ms = timed([&]() {
+        direct.process(frames[0], direct_image);
+        skip.process(frames[0], skip_image);
+        for (size_t p = 0; p < separate.size(); p++) {
+            separate[p] = 0.5f * (direct_image.pixels[p] + skip_image.pixels[p]);
+        }
+    });
+    const double fused_ms = timed([&]() { both.process(frames[0], fused); });
+    const double fused_frames_ms = timed([&]() { both.process(frame_pointers, fused_frames); });
+
+    double largest = 0.0;
+    double difference = 0.0;
+    for (size_t p = 0; p < separate.size(); p++) {
+        largest = std::max(largest, (double)separate[p]);
+        difference = std::max(difference, (double)std::fabs(separate[p] - fused.pixels[p]));
+    }
+    const double single_snr = signalToNoise(direct, single, scatterer_x, scatterer_z);
+    const double compounded_snr = signalToNoise(direct, compounded, scatterer_x, scatterer_z);
+
+    std::cout << std::endl << std::fixed << std::setprecision(1);
+    std::cout << "Direct, 1 frame        " << std::setw(10) << single_ms << " ms" << std::endl;
+    std::cout << "Direct, " << std::setw(2) << frames.size() << " frames      " << std::setw(10) << frames_ms << " ms" << std::endl;
+    std::cout << "Direct + half skip     " << std::setw(10) << separate_ms << " ms separately, " << fused_ms << " ms fused" << std::endl;
+    std::cout << "Both, " << std::setw(2) << frames.size() << " frames        " << std::setw(10) << fused_frames_ms << " ms fused" << std::endl;
+    std::cout << "Signal to noise        " << std::setw(10) << single_snr << " from 1 frame, " << compounded_snr << " from " << frames.size() << std::endl;
+    std::cout << std::setprecision(6);
+    std::cout << "Fused difference       " << std::setw(10) << difference / std::max(largest, 1e-9) << " of the largest pixel" << std::endl;
+
+    if (difference > 1e-4 * largest) {
+        std::cout << "\033[31m" << "Fused modes do not match the modes imaged separately" << "\033[0m" << std::endl;
+        return 1;
+    }
+    if (frames.size() > 1 and not (compounded_snr > single_snr)) {
+        std::cout << "\033[31m" << "Compounding frames did not raise the signal to noise" << "\033[0m" << std::endl;
+        return 1;
+    }
+    return 0;
+}
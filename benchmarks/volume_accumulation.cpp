@@ -0,0 +1,118 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+
+#include "PeakMicroPulseHandler/peak_handler.h"
+#include "PeakMicroPulseHandler/synthetic_generator.h"
+#include "PeakMicroPulseHandler/tfm_imager.h"
+#include "PeakMicroPulseHandler/tfm_volume.h"
+
+
+double microsecondsSince(const std::chrono::steady_clock::time_point& start)
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+// Moves a full matrix capture probe along a part with a side drilled hole part way along,
+// stacking each frame's TFM image into a TfmVolume at its encoder position. Times adding
+// images and projecting the volume, reports how many bricks were needed against a dense
+// volume, and checks the top view finds the hole over the length it was drilled.
+auto main(int argc, char** argv) -> int
+{
+    const std::string mps_file = argc > 1 ? argv[1] : "examples/mps/roller_probe.mps";
+    const double scan_length = argc > 2 ? std::stod(argv[2]) : 200.0;       // mm
+    const double frame_step = argc > 3 ? std::stod(argv[3]) : 0.25;         // mm between frames
+    const double slice_step = argc > 4 ? std::stod(argv[4]) : 0.5;          // mm between slices
+    const int brick_size = argc > 5 ? std::stoi(argv[5]) : 16;
+    const int n_elements = argc > 6 ? std::stoi(argv[6]) : 32;
+
+    // Only the frame geometry is needed from the driver, made full matrix capture
+    PeakHandler peak_handler(10, "127.0.0.1", 0, mps_file);
+    peak_handler.setReconstructionConfiguration(n_elements, 0.8, 0.1, 0.7, 1480.0, 1480.0, 6320.0, 0.0, 8.0, 0.1, 20.0);
+    if (not peak_handler.readMpsFile()) {
+        return 1;
+    }
+    PeakHandler::OutputFormat geometry;
+    PeakHandler::copyFrameMetadata(*peak_handler.ltpa_data_ptr(), geometry);
+    geometry.num_a_scans = n_elements * n_elements;
+
+    // The hole runs across the part from 40 % to 60 % of the scan
+    const double hole_start = 0.4 * scan_length;
+    const double hole_end = 0.6 * scan_length;
+    SyntheticGenerator sound_generator(geometry, peak_handler.gate_start_, peak_handler.dof_, 256);
+    SyntheticGenerator hole_generator(geometry, peak_handler.gate_start_, peak_handler.dof_, 256);
+    hole_generator.addScatterer(0.0, 10.0, 0.2);
+    PeakHandler::OutputFormat sound_frame;
+    PeakHandler::OutputFormat hole_frame;
+    sound_generator.generate(sound_frame);
+    hole_generator.generate(hole_frame);
+
+    const TfmImager::Grid grid = {-12.0, 12.0, 1.0, 19.0, 128, 96};
+    TfmImager imager(geometry, peak_handler.gate_start_, grid, {0, 0, 0, 0}, 1);
+    TfmImager::Image sound_image;
+    TfmImager::Image hole_image;
+    if (not imager.process(sound_frame, sound_image) or not imager.process(hole_frame, hole_image)) {
+        std::cout << "\033[31m" << "TfmImager could not image the frames" << "\033[0m" << std::endl;
+        return 1;
+    }
+
+    // Only the hole's echo is worth keeping, everything under a third of its peak is dropped
+    const float threshold = *std::max_element(hole_image.pixels.begin(), hole_image.pixels.end()) / 3.0f;
+    TfmVolume volume(grid, 0.0, slice_step, brick_size, threshold);
+
+    double add_us = 0.0;
+    long n_frames = 0;
+    for (double position = 0.0; position <= scan_length; position += frame_step, n_frames++) {
+        const bool over_hole = position >= hole_start and position <= hole_end;
+        const auto start = std::chrono::steady_clock::now();
+        volume.add(over_hole ? hole_image : sound_image, position);
+        add_us += microsecondsSince(start);
+    }
+
+    TfmVolume::Projection projection;
+    const auto start = std::chrono::steady_clock::now();
+    for (const TfmVolume::Axis& axis : {TfmVolume::depth, TfmVolume::scan, TfmVolume::lateral}) {
+        for (const TfmVolume::Statistic& statistic : {TfmVolume::maximum, TfmVolume::mean}) {
+            volume.project(axis, statistic, projection);
+        }
+    }
+    const double project_us = microsecondsSince(start) / 6;
+
+    // Along the top view's column over the hole, the slices holding its echo
+    volume.project(TfmVolume::depth, TfmVolume::maximum, projection);
+    const int column = std::lround((0.0 - grid.x_min) / (grid.x_max - grid.x_min) * (grid.nx - 1));
+    int first = -1;
+    int last = -1;
+    for (int iy = 0; iy < projection.height; iy++) {
+        if (projection.pixels[(size_t)iy * projection.width + column] > 0.0f) {
+            first = first < 0 ? iy : first;
+            last = iy;
+        }
+    }
+    const double found_start = first < 0 ? 0.0 : volume.slicePosition(first);
+    const double found_end = last < 0 ? 0.0 : volume.slicePosition(last);
+
+    const size_t brick_bytes = (size_t)brick_size * brick_size * brick_size * sizeof(float);
+    std::cout << std::endl << std::fixed << std::setprecision(1);
+    std::cout << "Frames                 " << std::setw(10) << volume.frames() << " into " << volume.nSlices() << " slices" << std::endl;
+    std::cout << "Adding                 " << std::setw(10) << add_us / n_frames << " us a frame" << std::endl;
+    std::cout << "Projecting             " << std::setw(10) << project_us << " us a projection" << std::endl;
+    std::cout << "Bricks                 " << std::setw(10) << volume.bricks() << " of " << volume.brickSlots() << std::endl;
+    std::cout << "Memory                 " << std::setw(10) << volume.footprint() / 1024 << " kB, dense "
+              << volume.brickSlots() * brick_bytes / 1024 << " kB" << std::endl;
+    std::cout << "Hole found             " << std::setw(10) << found_start << " to " << found_end << " mm, drilled "
+              << hole_start << " to " << hole_end << " mm" << std::endl;
+
+    if (first < 0 or std::fabs(found_start - hole_start) > slice_step or std::fabs(found_end - hole_end) > slice_step) {
+        std::cout << "\033[31m" << "The top view does not find the hole where it was drilled" << "\033[0m" << std::endl;
+        return 1;
+    }
+    if (volume.bricks() >= volume.brickSlots()) {
+        std::cout << "\033[31m" << "Every brick was allocated" << "\033[0m" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -8,7 +8,9 @@ auto main(int argc, char** argv) -> int
 
     const PeakHandler::OutputFormat* ltpa_data_ptr(peak_handler.ltpa_data_ptr());
 
-    peak_handler.readMpsFile();
+    if (not peak_handler.readMpsFile()) {
+        return 1;
+    }
     peak_handler.connect();
     peak_handler.sendMpsConfiguration();
 
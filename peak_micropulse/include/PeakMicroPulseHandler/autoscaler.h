@@ -0,0 +1,70 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "PeakMicroPulseHandler/frame_queue.h"
+#include "PeakMicroPulseHandler/thread_pool.h"
+
+
+
+// Sizes the thread pools of a pipeline's stages to the load, within a budget of threads
+// for the whole pipeline, so a 61 law sweep and full matrix capture need no hand tuning.
+// Each stage reports how long every frame took it, and once an interval the threads are
+// shared out again. A stage busy for more than the target fraction of the interval, or
+// with its input queue over half full, gets threads in proportion. One busy for less than
+// half the target gives them back. When the stages want more than the budget, each keeps
+// one thread and the rest are split in proportion to what they asked for.
+class Autoscaler {
+public:
+    struct Stage {
+        std::string                    name;
+        ThreadPool*                    pool;
+        const FrameQueue*              input;                 // nullptr if the stage has none
+        int                            threads;               // As last set
+        double                         utilisation;           // Busy fraction of the last interval
+        double                         mean_latency_us;       // Per frame, over the last interval
+        long                           frames;
+        double                         busy_us;               // Since the last rebalance
+        long                           interval_frames;
+    };
+
+    explicit Autoscaler(
+        const int& cpu_budget = 0,                            // Threads over all stages, 0 uses the hardware concurrency
+        const double& target_utilisation = 0.75,
+        const int& interval_ms = 250);
+    ~Autoscaler();
+
+
+    void                               logToConsole(const std::string& message);
+    void                               errorToConsole(const std::string& message);
+
+    // The budget is split evenly between the stages until there is load to go by
+    int                                addStage(const std::string& name, ThreadPool& pool, const FrameQueue* input = nullptr);
+
+    // Called by the stage after each frame, rebalances once an interval has passed
+    void                               record(const int& stage, const double& wall_us);
+
+    // Shares the threads out now on what was recorded since the last time, true if any count changed
+    bool                               rebalance();
+
+    std::vector<Stage>                 stages() const;
+    int                                budget() const { return budget_; };
+    int                                threadsInUse() const;
+    long                               rebalances() const { return rebalances_; };
+    std::string                        report() const;
+
+private:
+    bool                               rebalanceLocked();
+    void                               apply(const std::vector<int>& threads);
+
+    const int                          budget_;
+    const double                       target_utilisation_;
+    const std::chrono::milliseconds    interval_;
+    mutable std::mutex                 mutex_;
+    std::vector<Stage>                 stages_;
+    std::chrono::steady_clock::time_point               last_rebalance_;
+    long                               rebalances_;
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+
+// Fixed capacity pool of reusable buffers handed out as shared pointers, which
+// return their buffer to the pool when the last reference is released
+template <typename T>
+class BufferPool {
+public:
+    explicit BufferPool(const size_t& capacity)
+        :  state_(std::make_shared<State>())
+    {
+        state_->capacity = capacity;
+        state_->allocated = 0;
+    }
+
+
+    // Returns nullptr when all buffers are in use
+    std::shared_ptr<T> acquire() {
+        std::unique_ptr<T> buffer;
+        {
+            std::lock_guard<std::mutex> lock(state_->mutex);
+            if (not state_->free.empty()) {
+                buffer = std::move(state_->free.back());
+                state_->free.pop_back();
+            } else if (state_->allocated < state_->capacity) {
+                buffer.reset(new T());
+                state_->allocated++;
+            } else {
+                return nullptr;
+            }
+        }
+
+        std::weak_ptr<State> weak_state(state_);
+        return std::shared_ptr<T>(buffer.release(), [weak_state](T* released) {
+            if (auto state = weak_state.lock()) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->free.emplace_back(released);
+            } else {
+                delete released;
+            }
+        });
+    }
+
+
+    // Allocates every buffer now rather than on first use, so memory is fixed from here on
+    void preallocate(const std::function<void(T&)>& initialise = nullptr) {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        while (state_->allocated < state_->capacity) {
+            std::unique_ptr<T> buffer(new T());
+            if (initialise) {
+                initialise(*buffer);
+            }
+            state_->free.push_back(std::move(buffer));
+            state_->allocated++;
+        }
+    }
+
+
+    size_t capacity() const { return state_->capacity; };
+
+    size_t available() const {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        return state_->free.size() + state_->capacity - state_->allocated;
+    }
+
+private:
+    struct State {
+        std::mutex                                     mutex;
+        std::vector<std::unique_ptr<T>>                free;
+        size_t                                         capacity;
+        size_t                                         allocated;
+    };
+
+    std::shared_ptr<State>             state_;
+};
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "PeakMicroPulseHandler/peak_handler.h"
+
+
+
+// Scans stored one stream per test number and channel rather than one frame after
+// another, so "test 30 over the whole scan" reads only the blocks of that stream.
+// A-Scans are transposed into fixed size blocks as frames are written, each block
+// holding block_ascans A-Scans of one stream and their frame numbers:
+//
+//   <path>          blocks of [block_ascans x int64 frame number][block_ascans x ascan_length x int16]
+//   <path>.index    Header, then a BlockRecord per block in the order written
+//
+// Cropped A-Scans keep their place relative to gate start, the rest of the row is zero.
+class ColumnarWriter {
+public:
+    // On disk, native byte order
+    struct Header {
+        char                           magic[4];              // "PMPC"
+        int32_t                        version;
+        int32_t                        ascan_length;
+        int32_t                        block_ascans;
+    };
+
+    struct BlockRecord {
+        int32_t                        test_number;           // As reported in DofMessageHeader
+        int32_t                        channel;
+        int32_t                        n_ascans;              // Fewer than block_ascans only in a stream's last block
+        int32_t                        reserved;
+        int64_t                        first_frame;
+        int64_t                        last_frame;
+    };
+
+    using Stream = std::pair<int, int>;                       // Test number, channel
+
+    ColumnarWriter(
+        const std::string& path,
+        const PeakHandler::OutputFormat& geometry,            // After readMpsFile
+        const int& block_ascans = 64);
+    ~ColumnarWriter();
+
+    ColumnarWriter(const ColumnarWriter&) = delete;
+    ColumnarWriter& operator=(const ColumnarWriter&) = delete;
+
+
+    void                               logToConsole(const std::string& message);
+    void                               errorToConsole(const std::string& message);
+
+    // Appends each A-Scan to its stream's open block, writing the blocks that fill up.
+    // With lazy decoding call decodeAll first, undecoded A-Scans are written as zeros.
+    bool                               write(const PeakHandler::OutputFormat& frame);
+
+    // Writes the partly filled blocks and closes both files, also done on destruction
+    void                               close();
+
+    bool                               good() const { return data_ != nullptr and not failed_; };
+    long                               blocksWritten() const { return blocks_written_; };
+    size_t                             footprint() const;        // Grows with the number of streams
+
+private:
+    struct OpenBlock {
+        BlockRecord                    record;
+        std::vector<int64_t>           frame_numbers;
+        std::vector<short int>         samples;
+    };
+
+    bool                               writeBlock(OpenBlock& block);
+
+    const int                          ascan_length_;
+    const int                          block_ascans_;
+    std::FILE*                         data_;
+    std::FILE*                         index_;
+    std::map<Stream, OpenBlock>        open_blocks_;
+    long                               blocks_written_;
+    bool                               failed_;
+};
+
+
+class ColumnarReader {
+public:
+    explicit ColumnarReader(const std::string& path);
+    ~ColumnarReader();
+
+    ColumnarReader(const ColumnarReader&) = delete;
+    ColumnarReader& operator=(const ColumnarReader&) = delete;
+
+
+    void                               logToConsole(const std::string& message);
+    void                               errorToConsole(const std::string& message);
+
+    // A-Scans of one stream with first_frame <= frame number <= last_frame, appended as
+    // rows of ascanLength() samples. Only the blocks overlapping the range are read.
+    int                                read(
+                                                const int& test_number,
+                                                const int& channel,
+                                                const long& first_frame,
+                                                const long& last_frame,
+                                                std::vector<short int>& samples,
+                                                std::vector<long>& frame_numbers);
+
+    std::vector<ColumnarWriter::Stream>    streams() const;
+    bool                               good() const { return data_ != nullptr; };
+    int                                ascanLength() const { return header_.ascan_length; };
+    size_t                             bytesRead() const { return bytes_read_; };
+
+private:
+    ColumnarWriter::Header             header_;
+    std::FILE*                         data_;
+    size_t                             block_bytes_;
+    std::map<ColumnarWriter::Stream, std::vector<std::pair<ColumnarWriter::BlockRecord, long>>> blocks_;   // Record and block index in the data file
+    std::vector<int64_t>               frame_scratch_;
+    size_t                             bytes_read_;
+};
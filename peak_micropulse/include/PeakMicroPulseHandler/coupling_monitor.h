@@ -0,0 +1,64 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "PeakMicroPulseHandler/peak_handler.h"
+
+
+
+// Flags loss of couplant under the roller probe by combining the LWL coupling
+// failure packets (1E Hex) with a check of the interface echo energy in each A-Scan
+class CouplingMonitor {
+public:
+    enum CouplingEventType {
+        lwl_failure,                   // 1E Hex packet returned by the LTPA
+        interface_echo_loss,           // Interface echo energy below threshold
+        coupling_restored
+    };
+
+    struct CouplingEvent {
+        CouplingEventType              type;
+        long                           frame;
+        int                            testNo;                // -1 when the event applies to the whole frame
+        double                         lost_fraction;         // Of A-Scans below threshold
+    };
+
+    CouplingMonitor(
+        const int& window_start,                              // samples from gate start
+        const int& window_end,                                // samples from gate start
+        const double& threshold_db = -12.0,                   // dB relative to the reference
+        const double& lost_fraction = 0.5,                    // of A-Scans below threshold
+        const int& reference_frames = 10);
+    ~CouplingMonitor();
+
+
+    void                               logToConsole(const std::string& message);
+    void                               errorToConsole(const std::string& message);
+    void                               setReference(const std::vector<double>& reference_energy);
+    void                               setEventCallback(const std::function<void(const CouplingEvent&)>& callback);
+    bool                               check(const PeakHandler::OutputFormat& frame);
+    void                               reportLwlFailures(const std::vector<int>& test_numbers);
+    void                               reset();
+
+    bool                               coupled() const { return coupled_; };
+    long                               frames() const { return frame_; };
+    const std::vector<double>&         interfaceEnergyDb() const { return energy_db_; };
+
+private:
+    double                             interfaceEnergy(const PeakHandler::DofMessage& message) const;
+    void                               raise(const CouplingEventType& type, const int& testNo, const double& lost_fraction);
+
+    const int                                  window_start_;
+    const int                                  window_end_;
+    const double                               threshold_db_;
+    const double                               lost_fraction_;
+    const int                                  reference_frames_;
+    std::function<void(const CouplingEvent&)>  callback_;
+
+    std::vector<double>                        reference_energy_;
+    int                                        reference_count_;
+    std::vector<double>                        energy_db_;
+    bool                                       coupled_;
+    long                                       frame_;
+};
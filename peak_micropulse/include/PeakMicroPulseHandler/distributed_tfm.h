@@ -0,0 +1,139 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "PeakMicroPulseHandler/buffer_pool.h"
+#include "PeakMicroPulseHandler/frame_queue.h"
+#include "PeakMicroPulseHandler/frame_relay.h"
+#include "PeakMicroPulseHandler/peak_handler.h"
+#include "PeakMicroPulseHandler/tfm_imager.h"
+
+
+
+// Shares TFM imaging of each frame between worker processes, on this host or others,
+// each imaging one band of the grid. Workers connect over TCP and are sent the geometry
+// and their band once, then every frame in the FrameRelay format, and send their band
+// of pixels back. Images are reassembled and handed out in the order frames were pushed.
+// Both ends must share a byte order.
+class TfmCoordinator {
+public:
+    TfmCoordinator(
+        const PeakHandler::OutputFormat& geometry,            // After setReconstructionConfiguration and readMpsFile
+        const int& gate_start,                                // samples
+        const TfmImager::Grid& grid,
+        const int& port = 0,                                  // 0 picks a free port
+        const FrameRelay::Compression& compression = FrameRelay::none,
+        const size_t& max_in_flight = 8);                     // Frames being imaged or waiting for pop
+    ~TfmCoordinator();
+
+    TfmCoordinator(const TfmCoordinator&) = delete;
+    TfmCoordinator& operator=(const TfmCoordinator&) = delete;
+
+
+    void                               logToConsole(const std::string& message);
+    void                               errorToConsole(const std::string& message);
+
+    // Opens port for workers, so port() is known before they are launched
+    bool                               listen();
+
+    // Listens if not already, then waits for n_workers to connect and gives each a band of the grid
+    bool                               start(const int& n_workers, const int& timeout_ms = 10000);
+
+    // Copies the frame for the sending thread, false if it is refused because the workers are behind
+    bool                               push(const PeakHandler::OutputFormat& frame);
+
+    // Whole images in push order, nullptr on timeout, a negative timeout waits indefinitely
+    std::shared_ptr<const TfmImager::Image> pop(const int& timeout_ms = -1);
+
+    // Waits up to timeout_ms for the frames pushed to be imaged, then disconnects the workers, also
+    // done on destruction. False if images were still outstanding.
+    bool                               close(const int& timeout_ms = 10000);
+
+    int                                port() const { return port_; };
+    bool                               good() const { return running_ and not failed_; };
+    int                                nWorkers() const { return workers_.size(); };
+    long                               framesSent() const { return frames_sent_; };
+    long                               imagesCompleted() const { return images_completed_; };
+    long                               rejected() const { return rejected_ + queue_.dropped(); };   // Pushes refused, retries included
+
+private:
+    struct Worker {
+        std::unique_ptr<boost::asio::ip::tcp::socket> socket;
+        TfmImager::Tile                tile;
+        std::thread                    reader;
+    };
+
+    struct Pending {
+        uint64_t                       sequence;
+        std::shared_ptr<TfmImager::Image> image;
+        int                            tiles_remaining;
+    };
+
+    void                               senderLoop();
+    void                               readerLoop(Worker& worker);
+    void                               fail(const std::string& message);
+
+    PeakHandler::OutputFormat          geometry_;             // Metadata only
+    const int                          gate_start_;
+    const TfmImager::Grid              grid_;
+    const FrameRelay::Compression      compression_;
+    boost::asio::io_context            io_;
+    boost::asio::ip::tcp::acceptor     acceptor_;
+    int                                port_;
+    std::vector<std::unique_ptr<Worker>>                workers_;
+
+    FrameQueue                         queue_;                // Frames for the sending thread
+    BufferPool<TfmImager::Image>       images_;
+    std::vector<unsigned char>         message_;              // One frame, written to every worker
+
+    std::mutex                         push_mutex_;           // Keeps pending_ in queue order
+    std::mutex                         mutex_;
+    std::condition_variable            ready_cv_;
+    std::deque<Pending>                pending_;              // In push order
+    std::deque<std::shared_ptr<const TfmImager::Image>> ready_;
+    uint64_t                           next_sequence_;
+
+    std::atomic<bool>                  running_;
+    std::atomic<bool>                  failed_;
+    std::atomic<long>                  frames_sent_;
+    std::atomic<long>                  images_completed_;
+    std::atomic<long>                  rejected_;
+    std::thread                        sender_;
+};
+
+
+// Images its band of every frame a TfmCoordinator sends, with its own thread pool
+class TfmWorker {
+public:
+    TfmWorker(
+        const std::string& host,
+        const int& port,
+        const int& n_threads = 0);                            // 0 uses the hardware concurrency
+    ~TfmWorker();
+
+
+    void                               logToConsole(const std::string& message);
+    void                               errorToConsole(const std::string& message);
+
+    // Blocks until the coordinator disconnects, false if it could not be reached or the stream broke
+    bool                               run();
+
+    long                               framesImaged() const { return frames_imaged_; };
+
+private:
+    const std::string                  host_;
+    const int                          port_;
+    const int                          n_threads_;
+    boost::asio::io_context            io_;
+    boost::asio::ip::tcp::socket       socket_;
+    long                               frames_imaged_;
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "PeakMicroPulseHandler/buffer_pool.h"
+#include "PeakMicroPulseHandler/peak_handler.h"
+
+
+
+// Bounded queue of frames for handing them to other threads. Every frame buffer is
+// allocated up front, so the depth counts frames queued and frames still held by
+// consumers, and a full queue drops the newest frame rather than growing.
+class FrameQueue {
+public:
+    FrameQueue(
+        const PeakHandler::OutputFormat& geometry,            // After readMpsFile
+        const size_t& depth);
+    ~FrameQueue();
+
+
+    void                               logToConsole(const std::string& message);
+    void                               errorToConsole(const std::string& message);
+
+    // Copies the frame into a pooled buffer, false if none is free
+    bool                               push(const PeakHandler::OutputFormat& frame);
+
+    // For producers that fill a pooled buffer in place, nullptr and counted as dropped if none
+    // is free. The buffer is handed to consumers by enqueue or back to the pool when released.
+    std::shared_ptr<PeakHandler::OutputFormat> acquire();
+    void                               enqueue(const std::shared_ptr<PeakHandler::OutputFormat>& buffer);
+
+    // nullptr on timeout, a negative timeout waits indefinitely
+    std::shared_ptr<const PeakHandler::OutputFormat> pop(const int& timeout_ms = -1);
+
+    size_t                             size() const;
+    size_t                             depth() const { return pool_.capacity(); };
+    long                               dropped() const { return dropped_; };
+    size_t                             footprint() const { return depth() * frame_bytes_; };
+
+    // Bytes held by one frame of the given geometry
+    static size_t                      frameBytes(const PeakHandler::OutputFormat& geometry);
+
+private:
+    BufferPool<PeakHandler::OutputFormat>                        pool_;
+    const size_t                                                 frame_bytes_;
+    mutable std::mutex                                           mutex_;
+    std::condition_variable                                      ready_;
+    std::vector<std::shared_ptr<PeakHandler::OutputFormat>>     queue_;     // Ring of depth slots, sized once
+    size_t                                                       head_;      // Slot of the oldest frame
+    size_t                                                       count_;
+    std::atomic<long>                                            dropped_;
+};
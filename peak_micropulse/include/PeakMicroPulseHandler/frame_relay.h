@@ -0,0 +1,152 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "PeakMicroPulseHandler/frame_queue.h"
+#include "PeakMicroPulseHandler/peak_handler.h"
+
+
+
+// Sends frames to another host, such as an imaging workstation, in a compact binary
+// format. Frames are queued and packed several to a batch on a background thread, and
+// each batch is written in one go over TCP or as UDP datagrams of up to 60 kB. Samples
+// can be delta coded, which packs the smooth stretches of an A-Scan into one byte a
+// sample. A FrameRelayReceiver rebuilds the frames at the other end. Both ends must
+// share a byte order.
+class FrameRelay {
+public:
+    enum Transport {
+        tcp,
+        udp                            // Batches split over datagrams, a lost datagram loses its batch
+    };
+
+    enum Compression {
+        none,
+        delta                          // Zigzag varint of sample to sample differences
+    };
+
+    FrameRelay(
+        const std::string& host,
+        const int& port,
+        const Transport& transport = tcp,
+        const Compression& compression = none,
+        const int& batch_frames = 4,
+        const size_t& queue_depth = 32);
+    ~FrameRelay();
+
+    FrameRelay(const FrameRelay&) = delete;
+    FrameRelay& operator=(const FrameRelay&) = delete;
+
+
+    void                               logToConsole(const std::string& message);
+    void                               errorToConsole(const std::string& message);
+
+    // Copies the frame for the sending thread, false if it is dropped because the link is
+    // behind. With lazy decoding call decodeAll first, undecoded A-Scans are sent empty.
+    bool                               push(const PeakHandler::OutputFormat& frame);
+
+    // Sends what is queued, then closes the connection, also done on destruction
+    void                               close();
+
+    bool                               good() const { return connected_ and not failed_; };
+    long                               framesSent() const { return frames_sent_; };
+    long                               dropped() const { return queue_.dropped(); };
+    size_t                             bytesSent() const { return bytes_sent_; };
+    size_t                             sampleBytes() const { return sample_bytes_; };   // Before compression
+
+    // Appends one frame to a batch in the relay format
+    static void                        serialise(
+                                                const PeakHandler::OutputFormat& frame,
+                                                const Compression& compression,
+                                                std::vector<unsigned char>& batch);
+
+    // Rebuilds the frame at position and moves past it, false if the bytes are truncated or corrupt
+    static bool                        deserialise(
+                                                const unsigned char*& position,
+                                                const unsigned char* end,
+                                                const Compression& compression,
+                                                PeakHandler::OutputFormat& frame);
+
+private:
+    void                               senderLoop();
+    bool                               sendBatch();
+
+    const Transport                    transport_;
+    const Compression                  compression_;
+    const int                          batch_frames_;
+    boost::asio::io_context            io_;
+    boost::asio::ip::tcp::socket       tcp_socket_;
+    boost::asio::ip::udp::socket       udp_socket_;
+    boost::asio::ip::udp::endpoint     udp_endpoint_;
+
+    std::vector<unsigned char>         batch_;                // Header followed by the frames
+    int                                batched_;
+    uint32_t                           batch_sequence_;
+
+    FrameQueue                         queue_;
+    std::atomic<bool>                  connected_;
+    std::atomic<bool>                  running_;
+    std::atomic<bool>                  failed_;
+    std::atomic<long>                  frames_sent_;
+    std::atomic<size_t>                bytes_sent_;
+    std::atomic<size_t>                sample_bytes_;
+    std::thread                        sender_;
+};
+
+
+// Listens for a FrameRelay and rebuilds its frames into pooled buffers, handed out in
+// the order received through pop(). The buffers are sized by the first frames received.
+class FrameRelayReceiver {
+public:
+    explicit FrameRelayReceiver(
+        const int& port = 0,                                  // 0 picks a free port
+        const FrameRelay::Transport& transport = FrameRelay::tcp,
+        const size_t& depth = 32);
+    ~FrameRelayReceiver();
+
+    FrameRelayReceiver(const FrameRelayReceiver&) = delete;
+    FrameRelayReceiver& operator=(const FrameRelayReceiver&) = delete;
+
+
+    void                               logToConsole(const std::string& message);
+    void                               errorToConsole(const std::string& message);
+    void                               start();
+    void                               stop();
+
+    // nullptr on timeout, a negative timeout waits indefinitely
+    std::shared_ptr<const PeakHandler::OutputFormat> pop(const int& timeout_ms = -1) { return queue_.pop(timeout_ms); };
+
+    int                                port() const { return port_; };
+    long                               framesReceived() const { return frames_received_; };
+    long                               dropped() const { return queue_.dropped(); };          // Receiver queue full
+    long                               batchesLost() const { return batches_lost_; };         // Incomplete or corrupt batches
+    size_t                             bytesReceived() const { return bytes_received_; };
+
+private:
+    void                               serveTcp();
+    void                               serveUdp();
+    bool                               unpackBatch(const unsigned char* batch, const size_t& length);
+
+    const FrameRelay::Transport        transport_;
+    boost::asio::io_context            io_;
+    boost::asio::ip::tcp::acceptor     acceptor_;
+    std::unique_ptr<boost::asio::ip::tcp::socket>       tcp_socket_;
+    boost::asio::ip::udp::socket       udp_socket_;
+    std::mutex                         socket_mutex_;
+    std::thread                        thread_;
+    std::atomic<bool>                  running_;
+    int                                port_;
+
+    std::vector<unsigned char>         batch_;                // Received, or being reassembled from datagrams
+    FrameQueue                         queue_;
+    std::atomic<long>                  frames_received_;
+    std::atomic<long>                  batches_lost_;
+    std::atomic<size_t>                bytes_received_;
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+
+// Per-frame timeline spans recorded into a ring buffer per thread, so recording never
+// takes a lock once a thread has its buffer. Exported as Chrome trace event JSON, which
+// opens in chrome://tracing and ui.perfetto.dev. Span names must be string literals.
+class FrameTracer {
+public:
+    struct Span {
+        const char*                    name;
+        long                           frame;
+        long long                      start;                 // ns, FrameTracer::now()
+        long long                      end;                   // ns, FrameTracer::now()
+    };
+
+    explicit FrameTracer(const size_t& spans_per_thread = 65536);
+    ~FrameTracer();
+
+
+    void                               logToConsole(const std::string& message);
+    void                               errorToConsole(const std::string& message);
+    void                               setEnabled(const bool& enabled);
+    void                               setThreadName(const std::string& name);      // For the calling thread
+
+    // Returns end, so consecutive spans can be chained
+    long long                          span(const char* name, const long& frame, const long long& start, const long long& end);
+    long long                          span(const char* name, const long& frame, const long long& start);
+
+    // Only consistent while no thread is recording
+    void                               writeChromeTrace(std::ostream& stream) const;
+    bool                               writeChromeTrace(const std::string& path) const;
+    void                               clear();
+
+    bool                               enabled() const { return enabled_.load(std::memory_order_relaxed); };
+    long                               overwritten() const;   // Spans lost to full ring buffers
+    static long long                   now();                 // ns, steady clock
+
+private:
+    struct ThreadBuffer {
+        std::vector<Span>              spans;
+        std::atomic<unsigned long>     head;
+        int                            tid;
+        std::string                    name;
+    };
+
+    ThreadBuffer*                      threadBuffer();
+
+    const unsigned long                        id_;
+    const size_t                               spans_per_thread_;
+    std::atomic<bool>                          enabled_;
+    long long                                  epoch_;
+    mutable std::mutex                         buffers_mutex_;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers_;
+};
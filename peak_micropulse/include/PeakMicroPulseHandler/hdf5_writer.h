@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <hdf5.h>
+
+#include "PeakMicroPulseHandler/frame_queue.h"
+#include "PeakMicroPulseHandler/peak_handler.h"
+
+
+
+// Streams frames into chunked HDF5 datasets from a background thread. A-Scans go into
+// "ascans", frames x A-Scans x samples of int16, with each chunk covering a block of
+// frames and as many A-Scans as fit in about 1 MB, so both whole frames and single
+// A-Scans over time read back in few chunks. Per frame headers go into "frame_number",
+// "test_numbers", "channels", "saturated_ascans" and "coupling_lost". The geometry of
+// the OutputFormat and the MPS commands are stored as attributes of the root group.
+class Hdf5Writer {
+public:
+    Hdf5Writer(
+        const std::string& path,
+        const PeakHandler::OutputFormat& geometry,            // After readMpsFile and connect
+        const std::vector<std::string>& mps_commands,
+        const int& chunk_frames = 16,
+        const int& compression_level = 0,                     // Deflate 1 to 9, 0 to store uncompressed
+        const size_t& queue_depth = 32);
+    ~Hdf5Writer();
+
+    Hdf5Writer(const Hdf5Writer&) = delete;
+    Hdf5Writer& operator=(const Hdf5Writer&) = delete;
+
+
+    void                               logToConsole(const std::string& message);
+    void                               errorToConsole(const std::string& message);
+
+    // Copies the frame for the writer thread, false if it is dropped because the writer is
+    // behind. With lazy decoding call decodeAll first, undecoded A-Scans are written as zeros.
+    bool                               push(const PeakHandler::OutputFormat& frame);
+
+    // Writes what is queued and closes the file, also done on destruction
+    void                               close();
+
+    bool                               good() const { return file_ >= 0 and not failed_; };
+    long                               written() const { return written_; };
+    long                               dropped() const { return queue_.dropped(); };
+    size_t                             footprint() const;
+
+private:
+    void                               writerLoop();
+    void                               stage(const PeakHandler::OutputFormat& frame);
+    void                               flush();
+    hid_t                              createDataset(const char* name, const hid_t& type, const int& rank, const hsize_t* chunk, const bool& compress);
+    bool                               appendRows(const hid_t& dataset, const hid_t& type, const int& rank, const void* data);
+    void                               writeAttributes(const PeakHandler::OutputFormat& geometry, const std::vector<std::string>& mps_commands);
+
+    const int                          num_a_scans_;
+    const int                          ascan_length_;
+    const int                          chunk_frames_;
+    int                                compression_level_;
+    hid_t                              file_;
+    hid_t                              ascans_;
+    hid_t                              frame_numbers_;
+    hid_t                              test_numbers_;
+    hid_t                              channels_;
+    hid_t                              saturated_ascans_;
+    hid_t                              coupling_lost_;
+
+    // One chunk of frames is staged before each write
+    std::vector<short int>             staged_amps_;
+    std::vector<int64_t>               staged_frame_numbers_;
+    std::vector<int>                   staged_test_numbers_;
+    std::vector<int>                   staged_channels_;
+    std::vector<int>                   staged_saturated_;
+    std::vector<unsigned char>         staged_coupling_lost_;
+    int                                staged_;
+    hsize_t                            rows_written_;
+
+    FrameQueue                         queue_;
+    std::atomic<bool>                  running_;
+    std::atomic<bool>                  failed_;
+    std::atomic<long>                  written_;
+    std::thread                        writer_;
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+
+
+// Memory for large, long lived buffers from 2 MB pages where the system allows, to cut TLB
+// misses on multi MB frames. Tries the hugetlbfs pool first, then transparent huge pages
+// through madvise, then falls back to standard pages.
+class HugePageRegion {
+public:
+    enum Backing {
+        none,                          // Nothing allocated
+        hugetlbfs,                     // Reserved pool, vm.nr_hugepages
+        transparent,                   // madvise(MADV_HUGEPAGE), at the kernel's discretion
+        standard
+    };
+
+    static const size_t                huge_page_size = 2 * 1024 * 1024;
+
+    explicit HugePageRegion(const bool& use_huge_pages = true);
+    ~HugePageRegion();
+    HugePageRegion(const HugePageRegion&) = delete;
+    HugePageRegion& operator=(const HugePageRegion&) = delete;
+
+
+    // Contents are not preserved
+    void                               allocate(const size_t& bytes);
+    void                               release();
+
+    void*                              data() const { return data_; };
+    size_t                             capacity() const { return capacity_; };
+    Backing                            backing() const { return backing_; };
+    static std::string                 backingName(const Backing& backing);
+
+private:
+    const bool                         use_huge_pages_;
+    void*                              data_;
+    size_t                             capacity_;
+    size_t                             mapped_;
+    Backing                            backing_;
+};
+
+
+// Byte buffer with the parts of the std::vector interface the driver uses, allocated once
+// and grown only if a frame outgrows it
+template <typename T>
+class HugePageBuffer {
+public:
+    explicit HugePageBuffer(const bool& use_huge_pages = true) : region_(use_huge_pages), size_(0) {}
+
+    void reserve(const size_t& n) {
+        if (n * sizeof(T) > region_.capacity()) {
+            std::vector<T> kept(data(), data() + size_);
+            region_.allocate(n * sizeof(T));
+            std::memcpy(data(), kept.data(), kept.size() * sizeof(T));
+        }
+    }
+
+    void append(const T* values, const size_t& n) {
+        if (size_ + n > capacity()) {
+            reserve(2 * (size_ + n));
+        }
+        std::memcpy(data() + size_, values, n * sizeof(T));
+        size_ += n;
+    }
+
+    void append(const std::vector<T>& values) { append(values.data(), values.size()); };
+    void clear() { size_ = 0; };
+
+    T*                                 data() { return static_cast<T*>(region_.data()); };
+    const T*                           data() const { return static_cast<const T*>(region_.data()); };
+    T&                                 operator[](const size_t& i) { return data()[i]; };
+    const T&                           operator[](const size_t& i) const { return data()[i]; };
+    size_t                             size() const { return size_; };
+    size_t                             capacity() const { return region_.capacity() / sizeof(T); };
+    HugePageRegion::Backing            backing() const { return region_.backing(); };
+
+private:
+    HugePageRegion                     region_;
+    size_t                             size_;
+};
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "PeakMicroPulseHandler/peak_handler.h"
+
+
+
+// Thresholds amplitudes relative to a reference (dB) and clusters the exceeding
+// pixels into indications with connected components, one image row at a time.
+// In C-Scan mode each frame adds a row of gated peaks so indications close while
+// scanning, B-Scan and TFM images are labelled as a whole on each frame.
+class IndicationDetector {
+public:
+    struct Indication {
+        long                           id;
+        int                            first_row;             // Frame in C-Scan mode
+        int                            last_row;
+        int                            min_column;            // A-Scan index in C-Scan mode
+        int                            max_column;
+        int                            pixels;
+        float                          peak_amplitude;
+        double                         peak_db;               // dB relative to the reference
+        int                            peak_row;
+        int                            peak_column;
+    };
+
+    IndicationDetector(
+        const double& reference_amplitude,
+        const double& threshold_db = -6.0,
+        const int& min_pixels = 1);
+    ~IndicationDetector();
+
+
+    void                               setGate(const int& gate_start, const int& gate_end); // samples from gate start
+    void                               setIndicationCallback(const std::function<void(const Indication&)>& callback);
+
+    void                               processFrame(const PeakHandler::OutputFormat& frame);
+    void                               processRow(const float* row, const int& width);
+    std::vector<Indication>            processImage(const float* image, const int& width, const int& height);
+    void                               flush();
+
+    std::vector<Indication>            openIndications() const;
+    const std::vector<Indication>&     indications() const { return indications_; };
+    const std::vector<float>&          gatedPeaks() const { return gated_peaks_; };
+
+private:
+    // Streaming connected component labelling, only the previous row of runs is kept
+    class RowLabeller {
+    public:
+        RowLabeller();
+
+        void                           reset();
+        void                           addRow(const float* row, const int& width, const float& threshold,
+                                              std::vector<Indication>& closed);
+        void                           close(std::vector<Indication>& closed);
+        const std::vector<Indication>& active() const { return active_; };
+
+    private:
+        struct Run {
+            int                        start;
+            int                        end;                   // inclusive
+            int                        component;
+        };
+
+        int                            find(const int& i);
+
+        std::vector<Run>               previous_runs_;
+        std::vector<Run>               current_runs_;
+        std::vector<Indication>        active_;
+        std::vector<Indication>        next_active_;
+        std::vector<int>               parent_;
+        std::vector<int>               remap_;
+        int                            row_;
+    };
+
+    void                               emit(std::vector<Indication>& closed, std::vector<Indication>* output);
+
+    const double                       reference_amplitude_;
+    const double                       threshold_db_;
+    const float                        threshold_;
+    const int                          min_pixels_;
+    int                                gate_start_;
+    int                                gate_end_;
+    long                               next_id_;
+
+    std::function<void(const Indication&)> callback_;
+    RowLabeller                        cscan_labeller_;
+    RowLabeller                        image_labeller_;
+    std::vector<Indication>            closed_;
+    std::vector<Indication>            indications_;
+    std::vector<float>                 gated_peaks_;
+};
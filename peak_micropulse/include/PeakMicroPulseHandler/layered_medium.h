@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+
+#include "PeakMicroPulseHandler/peak_handler.h"
+
+
+
+// Flat wedge and couplant layers above the specimen, built from the reconstruction
+// configuration. Rays obey Snell's law at each interface and the wedge angle is
+// not modelled, the array lies parallel to the specimen surface.
+class LayeredMedium {
+public:
+    struct Layer {
+        double                         thickness;             // mm
+        double                         velocity;              // mm/us
+    };
+
+    explicit LayeredMedium(const PeakHandler::OutputFormat& geometry);
+
+
+    double                             elementPosition(const double& element) const;                 // mm, centred on the array
+    double                             travelTime(const double& dx, const double& depth) const;      // us, array to a point depth mm into the specimen
+
+    // us, array to a point dx across after crossing each segment in the specimen in turn, as
+    // for a leg down to the backwall and back up, each segment with its own wave's velocity
+    double                             travelTime(const double& dx, const Layer* segments, const int& n_segments) const;
+    double                             surfaceTime() const;                                          // us, array to the specimen surface at normal incidence
+
+    int                                nElements() const { return n_elements_; };
+    double                             materialVelocity() const { return material_velocity_; };
+    double                             specimenDepth() const { return specimen_depth_; };
+    bool                               valid() const { return material_velocity_ > 0.0; };
+
+private:
+    int                                n_elements_;
+    double                             pitch_;
+    double                             material_velocity_;
+    double                             specimen_depth_;
+    std::vector<Layer>                 layers_;               // Above the specimen
+};
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+
+
+// Local TCP stand-in for the LTPA. It answers RST, configures itself from the DOF,
+// GATS and SWP commands of the MPS file and returns one frame of A-Scans per CALS,
+// optionally with faults injected so the driver's recovery can be measured.
+class LoopbackInstrument {
+public:
+    enum FaultType {
+        none,
+        split_segments,                // Frame written in tiny TCP segments
+        mid_frame_delay,               // Pause half way through the frame
+        error_packet,                  // 06 Hex message inserted mid-frame
+        corrupt_count,                 // Length bytes of one A-Scan sub-header
+        corrupt_dof,                   // DOF byte of one A-Scan sub-header
+        drop_ascan                     // One A-Scan missing from the frame
+    };
+
+    // Fills a frame of DOF messages, packet is already sized for the configuration
+    typedef std::function<void(std::vector<unsigned char>& packet, const long& frame)> FrameSource;
+
+    explicit LoopbackInstrument(
+        const int& port = 0,                                  // 0 picks a free port
+        const int& digitisation_rate = 100);                  // MHz, reported after RST
+    ~LoopbackInstrument();
+
+
+    void                               logToConsole(const std::string& message);
+    void                               errorToConsole(const std::string& message);
+    void                               start();
+    void                               stop();
+    void                               closeConnection();
+
+    void                               injectFault(const FaultType& fault, const int& frames = 1);
+    void                               setSplitSegmentSize(const int& bytes);
+    void                               setMidFrameDelay(const int& milliseconds);
+    void                               setFrameSource(const FrameSource& frame_source);
+
+    static std::string                 faultName(const FaultType& fault);
+
+    int                                port() const { return port_; };
+    int                                dof() const { return dof_; };
+    int                                ascanLength() const { return gate_end_ - gate_start_; };
+    int                                numAScans() const { return test_end_ - test_start_ + 1; };
+    int                                firstTest() const { return test_start_; };
+    long                               framesSent() const { return frames_sent_; };
+
+private:
+    void                               serve();
+    void                               handleCommand(const std::string& command);
+    void                               sendReset();
+    void                               sendFrame();
+    void                               fillPattern(std::vector<unsigned char>& packet, const long& frame);
+    void                               write(const unsigned char* data, const size_t& length);
+
+    boost::asio::io_context                             io_;
+    boost::asio::ip::tcp::acceptor                      acceptor_;
+    std::unique_ptr<boost::asio::ip::tcp::socket>       socket_;
+    std::mutex                                          socket_mutex_;
+    std::thread                                         thread_;
+    std::atomic<bool>                                   running_;
+    int                                                 port_;
+    const int                                           digitisation_rate_;
+
+    int                                                 dof_;
+    int                                                 gate_start_;
+    int                                                 gate_end_;
+    int                                                 test_start_;
+    int                                                 test_end_;
+
+    std::mutex                                          fault_mutex_;
+    FaultType                                           fault_;
+    int                                                 fault_frames_;
+    int                                                 segment_size_;
+    int                                                 delay_ms_;
+    FrameSource                                         frame_source_;
+    std::vector<unsigned char>                          packet_;
+    std::atomic<long>                                   frames_sent_;
+};
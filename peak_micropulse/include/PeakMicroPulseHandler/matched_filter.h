@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <complex>
+#include <memory>
+#include <vector>
+
+#include "PeakMicroPulseHandler/frame_tracer.h"
+#include "PeakMicroPulseHandler/peak_handler.h"
+#include "PeakMicroPulseHandler/real_fft.h"
+#include "PeakMicroPulseHandler/thread_pool.h"
+
+
+
+// Pulse compression by correlating every A-Scan with a reference pulse, using
+// overlap-save FFT convolution against a reference spectrum computed once
+class MatchedFilter {
+public:
+    struct Timing {
+        double                         wall_us;               // Last frame
+        double                         cpu_us;                // Last frame, summed over worker threads
+        double                         mean_cpu_us;
+        double                         max_cpu_us;
+        long                           frames;
+    };
+
+    explicit MatchedFilter(const int& n_threads = 0);         // 0 uses the hardware concurrency
+    ~MatchedFilter();
+
+
+    void                               logToConsole(const std::string& message);
+    void                               errorToConsole(const std::string& message);
+    void                               setReference(const std::vector<float>& pulse);
+    void                               setReference(
+                                                const PeakHandler::OutputFormat& calibration_frame,
+                                                const int& ascan,
+                                                const int& pulse_start,   // samples from gate start
+                                                const int& pulse_end);    // samples from gate start
+    void                               attachTracer(FrameTracer* tracer);
+
+    // Filtered amplitudes are scaled so an echo matching the reference keeps its peak amplitude.
+    // output is reused between frames to avoid reallocating its A-Scans.
+    bool                               process(
+                                                const PeakHandler::OutputFormat& input,
+                                                PeakHandler::OutputFormat& output);
+
+    const Timing&                      timing() const { return timing_; };
+    int                                blockLength() const { return fft_ ? fft_->length() : 0; };
+    ThreadPool&                        threadPool() { return workers_; };
+    size_t                             footprint() const;     // Bytes held, fixed by setReference
+
+private:
+    void                               filter(
+                                                const std::vector<short int>& amps,
+                                                std::vector<short int>& filtered,
+                                                const int& worker);
+
+    ThreadPool                                      workers_;
+    std::unique_ptr<RealFft>                        fft_;
+    int                                             reference_length_;
+    int                                             hop_;
+    float                                           gain_;
+    std::vector<std::complex<float>>                reference_spectrum_;  // Conjugated
+    std::vector<std::vector<float>>                 block_scratch_;       // Per worker
+    std::vector<std::vector<std::complex<float>>>   spectrum_scratch_;    // Per worker
+    std::vector<std::vector<float>>                 result_scratch_;      // Per worker
+    std::atomic<long long>                          cpu_ns_;
+    Timing                                          timing_;
+    FrameTracer*                                    tracer_;
+};
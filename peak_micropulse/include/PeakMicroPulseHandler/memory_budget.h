@@ -0,0 +1,33 @@
+#pragma once
+
+#include <map>
+#include <string>
+
+
+
+// Memory set aside for each component at startup, so long runs can be checked against a
+// fixed budget. Components report what they hold through their footprint() methods.
+class MemoryBudget {
+public:
+    explicit MemoryBudget(const size_t& budget);             // bytes
+    ~MemoryBudget();
+
+
+    void                               logToConsole(const std::string& message);
+    void                               errorToConsole(const std::string& message);
+
+    // Fails, leaving the reservation unchanged, if the budget would be exceeded
+    bool                               reserve(const std::string& component, const size_t& bytes);
+    void                               release(const std::string& component);
+    void                               report();
+
+    size_t                             budget() const { return budget_; };
+    size_t                             reserved() const { return reserved_; };
+    size_t                             remaining() const { return budget_ - reserved_; };
+    const std::map<std::string, size_t>& reservations() const { return reservations_; };
+
+private:
+    const size_t                       budget_;
+    size_t                             reserved_;
+    std::map<std::string, size_t>      reservations_;
+};
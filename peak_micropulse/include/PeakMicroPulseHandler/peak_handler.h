@@ -1,11 +1,22 @@
 #pragma once
 
+#include <climits>
+#include <cmath>
 #include <iostream>
 #include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <vector>
 
 #include <BoostSocketWrappers/tcp_client_boost.h>
 
+#include "PeakMicroPulseHandler/huge_page_buffer.h"
+
+
+class CouplingMonitor;
+class FrameTracer;
+class SubsetSelector;
 
 
 class PeakHandler {
@@ -30,21 +41,35 @@ public:
                                                         const double& vel_material,          // m/s
                                                         const double& wedge_angle,           // degrees
                                                         const double& wedge_depth,           // mm
-                                                        const double& specimen_depth,        // mm
-                                                        const double& couplant_depth);       // mm
-    void                               readMpsFile();
+                                                        const double& couplant_depth,        // mm
+                                                        const double& specimen_depth);       // mm
+    bool                               readMpsFile();
     std::vector<std::string>           processMpsLine(const std::string& command);
+    const std::vector<std::string>&    mpsCommands() const { return commands_; };     // As sent by sendMpsConfiguration
     void                               setDof(const std::string& command);
     void                               setGates(const std::string& command);
     void                               setNumAScans(const std::string& command);
+    void                               setFocalLaw(const std::string& command);    // TXF, RXF, TXN or RXN
+    void                               clearFocalLaws();
     void                               calcPacketLength();
+    void                               setSaturationLevel(const int& saturation_level);   // From the centre, 0 for the DOF's full scale
+    void                               setHugePages(const bool& use_huge_pages);   // Before readMpsFile
+    void                               setLazyDecode(const bool& lazy_decode);     // Before readMpsFile
 
+    // Keeps only samples [window_start, window_end) from gate start of a test number, as
+    // reported in DofMessageHeader, applied while decoding and safe to change while streaming
+    void                               setCropWindow(const int& test_number, const int& window_start, const int& window_end);
+    void                               clearCropWindows();
+
+    void                               setResetWait(const int& seconds);
     void                               connect(int digitisation_rate = 0);
     void                               sendCommand(const std::string& command);
     void                               sendReset(int digitisation_rate);
     void                               sendMpsConfiguration();
-    auto                               dataOutpoutFormatReader(const std::vector<unsigned char>& packet);
     bool                               sendDataRequest();
+    void                               attachCouplingMonitor(CouplingMonitor* coupling_monitor);
+    void                               attachTracer(FrameTracer* tracer);
+    void                               attachSubsetSelector(SubsetSelector* subset_selector);
 
 
 // Output data structures: made to stay close to the LTPA DOF message
@@ -56,12 +81,63 @@ public:
         error                          // 0x6 and everything else
     };
 
+    // DOF 1 samples are offset binary, 0 to 255 centred on 128, and DOF 4 samples two's complement
+    // centred on 0. Amplitudes are kept as sent, magnitudes are taken about the centre.
+    static int                         sampleOffset(const int& dof) { return dof == 1 ? 128 : 0; };
+    static int                         fullScale(const int& dof) { return dof == 1 ? 127 : (dof == 4 ? 32767 : 0); };
+    // At or above level from the centre, or below -level, so the full scale counts both rails
+    static bool                        saturates(const int& centred, const int& level) {
+        return level > 0 and (centred >= level or centred < -level);
+    };
+
+    // Computed while unpacking the amplitudes, not part of the LTPA sub-header
+    struct DofMessageStatistics {
+        short int                      min;                   // As sent
+        short int                      max;
+        double                         rms;                   // About the centre of the DOF
+        int                            saturated;             // Samples at the saturation level from the centre
+    };
+
+    // Statistics of samples added one at a time, as decoding and SyntheticGenerator compute them
+    struct StatisticsAccumulator {
+        const int                      offset;
+        const int                      saturation_level;
+        short int                      min;
+        short int                      max;
+        long long                      sum_squares;
+        int                            saturated;
+        int                            count;
+
+        StatisticsAccumulator(const int& dof, const int& level)
+            :  offset(sampleOffset(dof)), saturation_level(level), min(SHRT_MAX), max(SHRT_MIN),
+               sum_squares(0), saturated(0), count(0) {};
+
+        void                           add(const short int& amp) {
+            if (amp < min) min = amp;
+            if (amp > max) max = amp;
+            const int centred = amp - offset;
+            sum_squares += (long long)centred * centred;
+            if (saturates(centred, saturation_level)) saturated++;
+            count++;
+        };
+
+        // All zero without samples
+        DofMessageStatistics           statistics() const {
+            if (count == 0) {
+                return {0, 0, 0.0, 0};
+            }
+            return {min, max, std::sqrt((double)sum_squares / count), saturated};
+        };
+    };
+
     struct DofMessageHeader {
         DofHeaderByte                  header;
         int                            count;
         int                            testNo;
         int                            dof;
         int                            channel;
+        int                            sample_offset;         // Of amps[0] from gate start, non-zero when cropped
+        DofMessageStatistics           statistics;
     };
 
     struct DofMessage {
@@ -70,6 +146,7 @@ public:
     };
 
     struct OutputFormat {
+        long                           frame_number;          // Frames requested before this one
         int                            digitisation_rate;     // MHz
         int                            ascan_length;
         int                            num_a_scans;
@@ -84,9 +161,67 @@ public:
         double                         wedge_depth;           // mm
         double                         couplant_depth;        // mm
         double                         specimen_depth;        // mm
+        int                            saturated_ascans;      // A-Scans with at least one saturated sample
+        bool                           coupling_lost;         // Set by an attached CouplingMonitor
+        std::vector<int>               coupling_failures;     // Test numbers of 1E Hex packets in the frame
         std::vector<DofMessage>        ascans;
     };
 
+    // Counters of how the LTPA link has behaved since construction
+    struct LinkStatistics {
+        long                           frames_requested;
+        long                           frames_valid;
+        long                           frames_dropped;
+        long                           corrupt_ascans;        // DOF or length not matching the MPS file
+        long                           error_messages;        // 06 Hex messages within frames
+        long                           alignment_losses;      // Unrecognised messages, rest of frame unreadable
+    };
+
+    const LinkStatistics&              link_statistics() const { return link_statistics_; };
+
+    // Element delays of each focal law as programmed by TXF and RXF, and the laws TXN and RXN
+    // assign to each test. A-Scan i of a frame is test first_test + i of the sweep.
+    struct FocalLaw {
+        std::vector<int>               elements;              // From 0
+        std::vector<double>            delays;                // us, one per element
+    };
+
+    struct FocalLaws {
+        std::vector<FocalLaw>          transmit;              // Indexed by law number
+        std::vector<FocalLaw>          receive;
+        std::vector<int>               transmit_laws;         // Law number indexed by test number, -1 without one
+        std::vector<int>               receive_laws;
+        int                            first_test;            // From SWP, 0 without a sweep
+
+        // The law programmed for a test, nullptr without one
+        const FocalLaw*                transmitLaw(const int& test) const { return law(transmit, transmit_laws, test); };
+        const FocalLaw*                receiveLaw(const int& test) const { return law(receive, receive_laws, test); };
+        static const FocalLaw*         law(const std::vector<FocalLaw>& laws, const std::vector<int>& by_test, const int& test) {
+            const int number = test >= 0 and test < (int)by_test.size() ? by_test[test] : -1;
+            return number >= 0 and number < (int)laws.size() ? &laws[number] : nullptr;
+        };
+    };
+
+    const FocalLaws&                   focalLaws() const { return focal_laws_; };
+
+    // Copies everything but the A-Scans, for stages that reuse their output buffers
+    static void                        copyFrameMetadata(const OutputFormat& from, OutputFormat& to);
+
+    // Decodes a single DOF message, declared here as its return type needs the structures above
+    DofMessage                         dataOutpoutFormatReader(const std::vector<unsigned char>& packet);
+    DofMessage                         dataOutpoutFormatReader(const unsigned char* packet, const int& length);
+    void                               dataOutpoutFormatReader(const unsigned char* packet, const int& length, DofMessage& data);
+
+    // A-Scans of the published frame, decoded on first access when lazy decoding is set.
+    // With lazy decoding ltpa_data_ holds only the sub-headers of A-Scans not yet accessed.
+    // Out of range, ascanAt reports an error and returns an empty A-Scan.
+    const DofMessage&                  ascanAt(const int& i);
+    bool                               isDecoded(const int& i) const { return i >= 0 and i < (int)decoded_.size() and decoded_[i] != 0; };
+    void                               decodeAll();
+
+    // Bytes held for packets and frames, fixed once readMpsFile has run
+    size_t                             footprint() const;
+
 private:
     // TODO: Consider using a mutex or atomic here to avoid a race condition
     OutputFormat                       ltpa_data_;
@@ -102,6 +237,7 @@ private:
     BoostSocketWrappers::TcpClientBoost        ltpa_client_;
     const std::string                          mps_file_;
     std::vector<std::string>                   commands_;
+    FocalLaws                                  focal_laws_;
 
 public:
     int                                dof_;
@@ -113,5 +249,41 @@ public:
 private:
     int                                individual_ascan_obs_length_;
     int                                packet_length_;
+    int                                saturation_level_;         // In use, the user's or the DOF's full scale
+    int                                user_saturation_level_;    // 0 unless set by setSaturationLevel
+    CouplingMonitor*                   coupling_monitor_;
+    FrameTracer*                       tracer_;
+    SubsetSelector*                    subset_selector_;
+    bool                               use_huge_pages_;
+    std::unique_ptr<HugePageBuffer<unsigned char>> response_;   // Packet buffer kept between frames
+    std::vector<DofMessage>            decode_buffer_;
+    std::vector<DofMessage>            spare_buffer_;
+    std::vector<int>                   coupling_failures_;
+    bool                               lazy_decode_requested_;    // By setLazyDecode
+    bool                               lazy_decode_;              // Latched by readMpsFile
+    std::unique_ptr<HugePageBuffer<unsigned char>> published_packet_;   // Lazy decoding only
+    std::vector<int>                   ascan_offsets_;        // Into the packet, per A-Scan
+    std::vector<int>                   published_offsets_;
+    std::vector<char>                  decoded_;              // Per A-Scan of the published frame
+
+    struct CropWindow {
+        int                            start;
+        int                            end;                   // No crop unless greater than start
+    };
+    std::mutex                                         crop_mutex_;
+    std::shared_ptr<const std::vector<CropWindow>>     crop_windows_;     // Indexed by test number
+    std::shared_ptr<const std::vector<CropWindow>>     decode_crop_;      // In use for the current frame
+    std::shared_ptr<const std::vector<CropWindow>>     published_crop_;   // Of the published frame, for lazy decoding
+    DofMessage                         no_ascan_;             // Empty, returned by ascanAt out of range
+    LinkStatistics                     link_statistics_;
+    int                                reset_wait_;               // s
+
+    void                               readSubHeader(const unsigned char* packet, DofMessageHeader& header);
+    void                               updateSaturationLevel();
+    void                               readDofMessage(const unsigned char* packet, const int& length,
+                                                      const std::vector<CropWindow>* crop_windows, DofMessage& data);
+    void                               receiveAtLeast(HugePageBuffer<unsigned char>& response, const int& length);
+    long long                          traceTime() const;
+    long long                          traceSpan(const char* name, const long& frame, const long long& start);
 
 };
\ No newline at end of file
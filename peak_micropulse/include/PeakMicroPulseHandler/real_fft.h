@@ -0,0 +1,34 @@
+#pragma once
+
+#include <complex>
+#include <vector>
+
+
+
+// Radix-2 FFT of real data, computed as a half length complex FFT. The plan holds
+// the twiddle and bit reversal tables only, so one plan can be shared by threads.
+class RealFft {
+public:
+    explicit RealFft(const int& length);                        // Power of two, >= 4
+
+
+    static int                         nextPowerOfTwo(const int& n);
+
+    // output holds bins() values, no normalisation is applied
+    void                               forward(const float* input, std::complex<float>* output) const;
+    // Input holds bins() values and is overwritten, output is normalised by 1/length
+    void                               inverse(std::complex<float>* input, float* output) const;
+
+    int                                length() const { return length_; };
+    int                                bins() const { return length_ / 2 + 1; };
+    size_t                             footprint() const;   // Bytes held by the tables
+
+private:
+    void                               complexFft(std::complex<float>* data) const;
+
+    const int                                  length_;
+    const int                                  half_;
+    std::vector<std::complex<float>>           half_twiddles_;      // exp(-2 pi i k / half)
+    std::vector<std::complex<float>>           twiddles_;           // exp(-2 pi i k / length)
+    std::vector<int>                           bit_reverse_;
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "PeakMicroPulseHandler/peak_handler.h"
+
+
+
+// Geometry corrected images of each frame. Every A-Scan is a beam leaving the array at an
+// origin, refracted through the wedge and couplant into the specimen at an angle, so pixels
+// are in true position. Which samples each pixel takes and their weights are worked out
+// once, from the reconstruction configuration and the focal laws of the MPS file, so a
+// frame is a gather of four samples and four multiply-adds a pixel.
+class ScanConverter {
+public:
+    struct Beam {
+        double                         origin;                // mm along the array from its centre
+        double                         angle;                 // degrees from the normal, refracted into the specimen
+        double                         delay;                 // us added to the round trip by the focal law delays
+    };
+
+    struct View {
+        double                         x_min;                 // mm from the array centre
+        double                         x_max;
+        double                         z_min;                 // mm below the specimen surface
+        double                         z_max;
+        int                            width;                 // pixels
+        int                            height;
+    };
+
+    ScanConverter(
+        const PeakHandler::OutputFormat& geometry,            // After setReconstructionConfiguration and readMpsFile
+        const int& gate_start,                                // samples
+        const std::vector<Beam>& beams,                       // One per A-Scan, in frame order
+        const View& view,
+        const int& digitisation_rate = 0);                    // MHz, 0 uses the geometry or 100 if unset
+
+    // Beams from the focal laws of the MPS file, see focalLawBeams
+    ScanConverter(const PeakHandler& peak_handler, const View& view, const int& digitisation_rate = 0);
+    ~ScanConverter();
+
+
+    void                               logToConsole(const std::string& message);
+    void                               errorToConsole(const std::string& message);
+
+    // amplitudes is reused between frames, sized on the first, one signed value a pixel
+    bool                               convert(const PeakHandler::OutputFormat& frame, std::vector<float>& amplitudes);
+
+    // The same in two steps, for callers working through the image in blocks
+    bool                               load(const PeakHandler::OutputFormat& frame);
+    void                               gather(const size_t& begin, const size_t& end, float* amplitudes) const;
+
+    bool                               valid() const { return not first_.empty(); };
+    const View&                        view() const { return view_; };
+    size_t                             pixels() const { return first_.size(); };
+    size_t                             footprint() const;     // Bytes held, fixed once built
+
+    // One beam an A-Scan from the transmit law of its test: the origin is the centroid of the
+    // law's elements and the angle is steered by the slope of its delays, then refracted. A-Scans
+    // without a transmit law get a beam that is never drawn.
+    static std::vector<Beam>           focalLawBeams(const PeakHandler::OutputFormat& geometry, const PeakHandler::FocalLaws& focal_laws);
+
+    // B-Scan of a linear sweep stepping one element a test, each aperture fired at the wedge angle
+    static std::vector<Beam>           linearBeams(const PeakHandler::OutputFormat& geometry, const int& aperture = 4);
+
+    // S-Scan from one aperture centre, at refracted angles in degrees
+    static std::vector<Beam>           sectorBeams(
+                                                const PeakHandler::OutputFormat& geometry,
+                                                const double& centre_element,
+                                                const std::vector<double>& angles);
+
+private:
+    void                               build(const PeakHandler::OutputFormat& geometry, const std::vector<Beam>& beams);
+
+    const View                         view_;
+    const int                          gate_start_;
+    double                             digitisation_rate_;
+    const int                          n_ascans_;
+    const int                          ascan_length_;
+    const int                          stride_;               // Samples a row, the A-Scan and two zeros
+
+    // Per pixel, a pair of samples on each of the two nearest beams and the weight of each,
+    // the blends along and across the beams folded together. Separate arrays for SIMD loads.
+    std::vector<int32_t>               first_;                // Index into samples_
+    std::vector<int32_t>               second_;
+    std::vector<float>                 first_weight_;
+    std::vector<float>                 first_next_weight_;
+    std::vector<float>                 second_weight_;
+    std::vector<float>                 second_next_weight_;
+    std::vector<short int>             samples_;              // The frame's A-Scans, one stride a row
+    bool                               warned_;
+};
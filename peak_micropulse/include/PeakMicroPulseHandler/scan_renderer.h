@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "PeakMicroPulseHandler/peak_handler.h"
+#include "PeakMicroPulseHandler/scan_converter.h"
+
+
+
+// Colour mapped B-Scan and S-Scan images of each frame, ready to display. A ScanConverter
+// puts the samples in true position a block of pixels at a time, and each block is scaled
+// on SSE2 where available and looked up in the palette into a reused pixel buffer.
+class ScanRenderer {
+public:
+    enum Palette {
+        grey,
+        amplitude                              // White through blue, green and yellow to red
+    };
+
+    typedef ScanConverter::Beam        Beam;
+    typedef ScanConverter::View        View;
+
+    struct Image {
+        int                            width;
+        int                            height;
+        std::vector<uint32_t>          pixels;                // RGBA bytes in memory order, width a row
+    };
+
+    ScanRenderer(
+        const PeakHandler::OutputFormat& geometry,            // After setReconstructionConfiguration and readMpsFile
+        const int& gate_start,                                // samples
+        const std::vector<Beam>& beams,                       // One per A-Scan, in frame order
+        const View& view,
+        const Palette& palette = amplitude,
+        const int& digitisation_rate = 0);                    // MHz, 0 uses the geometry or 100 if unset
+
+    // Beams from the focal laws of the MPS file
+    ScanRenderer(const PeakHandler& peak_handler, const View& view, const Palette& palette = amplitude);
+    ~ScanRenderer();
+
+
+    void                               logToConsole(const std::string& message);
+    void                               errorToConsole(const std::string& message);
+    void                               setGain(const double& gain_db);   // 0 dB puts the DOF's full scale at the top of the palette
+    void                               setPalette(const Palette& palette);
+
+    // image is reused between frames, sized on the first
+    bool                               render(const PeakHandler::OutputFormat& frame, Image& image);
+
+    const View&                        view() const { return converter_.view(); };
+    const ScanConverter&               converter() const { return converter_; };
+    size_t                             footprint() const;     // Bytes held, fixed once built
+
+private:
+    static const int                   block_ = 1024;         // Pixels converted at a time, kept in L1
+
+    ScanConverter                      converter_;
+    alignas(16) float                  block_amplitudes_[block_];
+    uint32_t                           palette_[256];
+    double                             gain_;                 // Linear, full scale to the top of the palette at 1
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <complex>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "PeakMicroPulseHandler/frame_tracer.h"
+#include "PeakMicroPulseHandler/peak_handler.h"
+#include "PeakMicroPulseHandler/buffer_pool.h"
+#include "PeakMicroPulseHandler/real_fft.h"
+#include "PeakMicroPulseHandler/thread_pool.h"
+
+
+
+// Magnitude spectra of every A-Scan in a frame, with the -6 dB centre frequency
+// and bandwidth of each, and a running per test and channel trend for probe health
+class SpectralAnalyser {
+public:
+    struct Spectra {
+        int                            n_ascans;
+        int                            n_bins;
+        double                         bin_width;             // MHz
+        std::vector<float>             magnitude;             // n_ascans x n_bins
+        std::vector<float>             centre_frequency;      // MHz
+        std::vector<float>             bandwidth;             // MHz, -6 dB
+    };
+
+    struct ChannelTrend {
+        double                         centre_frequency;      // MHz
+        double                         bandwidth;             // MHz
+        long                           frames;
+    };
+    typedef std::pair<int, int>        TrendKey;              // Test number and receiving channel
+
+    SpectralAnalyser(
+        const int& n_threads = 0,                             // 0 uses the hardware concurrency
+        const size_t& pool_size = 4,                          // Spectra buffers in flight
+        const double& trend_weight = 0.05);                   // Exponential moving average weight
+    ~SpectralAnalyser();
+
+
+    void                               logToConsole(const std::string& message);
+    void                               errorToConsole(const std::string& message);
+    void                               setWindow(const int& window_start, const int& window_end); // samples from gate start
+    void                               attachTracer(FrameTracer* tracer);
+
+    // Returns nullptr if every pooled buffer is still held by the caller
+    std::shared_ptr<const Spectra>     process(const PeakHandler::OutputFormat& frame);
+
+    const std::map<TrendKey, ChannelTrend>& channelTrend() const { return trend_; };
+    ThreadPool&                        threadPool() { return workers_; };
+
+    // Bytes held, fixed after the first frame as long as the geometry is unchanged
+    size_t                             footprint() const;
+
+private:
+    const RealFft&                     plan(const int& length);
+    const std::vector<float>&          hannWindow(const int& length);
+    void                               analyse(
+                                                const std::vector<short int>& amps,
+                                                const int& sample_offset,
+                                                const RealFft& fft,
+                                                const int& worker,
+                                                const double& bin_width,
+                                                float* magnitude,
+                                                float& centre_frequency,
+                                                float& bandwidth);
+
+    int                                             window_start_;
+    int                                             window_end_;
+    const double                                    trend_weight_;
+
+    ThreadPool                                      workers_;
+    BufferPool<Spectra>                             buffers_;
+    std::map<int, std::unique_ptr<RealFft>>         plans_;
+    std::map<int, std::vector<float>>               windows_;
+    std::vector<std::vector<float>>                 input_scratch_;      // Per worker
+    std::vector<std::vector<std::complex<float>>>   output_scratch_;     // Per worker
+    std::map<TrendKey, ChannelTrend>                trend_;
+    FrameTracer*                                    tracer_;
+    size_t                                          spectra_bytes_;      // Of the last frame
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "PeakMicroPulseHandler/peak_handler.h"
+
+
+
+// Runs the startup phases that do not depend on each other at the same time. The MPS
+// file is parsed, and tables such as delay laws built, on worker threads while connect()
+// waits out the LTPA reset, so the time to the first frame is that of the longest phase
+// rather than the sum of them all. The MPS commands are sent once everything is ready.
+class StartupOrchestrator {
+public:
+    struct Phase {
+        std::string                    name;
+        double                         start;                 // ms from run()
+        double                         end;                   // ms from run()
+        bool                           succeeded;
+    };
+
+    explicit StartupOrchestrator(PeakHandler& peak_handler);
+    ~StartupOrchestrator();
+
+
+    void                               logToConsole(const std::string& message);
+    void                               errorToConsole(const std::string& message);
+
+    // Tasks that need the frame geometry from the MPS file wait for it, the rest start straight away.
+    // Tasks run during the reset, so must not rely on the digitisation rate it reports.
+    void                               addTask(const std::string& name, const std::function<void()>& task, const bool& after_mps = true);
+
+    // Reads the MPS file, connects and resets, runs the tasks then sends the MPS commands. The
+    // commands are not sent, and false is returned, if any phase fails or a task throws.
+    bool                               run(int digitisation_rate = 0);
+    void                               report();
+
+    const std::vector<Phase>&          phases() const { return phases_; };
+    double                             elapsed() const { return elapsed_; };       // ms, run() to ready for the first frame
+    double                             serialTime() const;                         // ms, the phases one after another
+
+private:
+    struct Task {
+        std::string                    name;
+        std::function<void()>          task;
+        bool                           after_mps;
+    };
+
+    bool                               runPhase(Phase& phase, const std::function<bool()>& work);
+    double                             sinceStart() const;
+
+    PeakHandler&                                       peak_handler_;
+    std::vector<Task>                                  tasks_;
+    std::vector<Phase>                                 phases_;
+    std::chrono::steady_clock::time_point              start_;
+    double                                             elapsed_;
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+
+#include "PeakMicroPulseHandler/peak_handler.h"
+
+
+
+// Extracts the A-Scans of chosen test numbers or channels, optionally over a window of
+// samples, straight from the packet into one compact matrix per frame. Combined with
+// lazy decoding the A-Scans not selected are never unpacked.
+class SubsetSelector {
+public:
+    struct Matrix {
+        long                           frame_number;
+        int                            rows;                  // Selected A-Scans, in frame order
+        int                            columns;               // Samples per row
+        int                            window_start;          // samples from gate start
+        std::vector<int>               test_numbers;          // Per row, as reported in DofMessageHeader
+        std::vector<int>               channels;              // Per row
+        std::vector<short int>         samples;               // rows x columns
+    };
+
+    SubsetSelector();
+    ~SubsetSelector();
+
+
+    void                               logToConsole(const std::string& message);
+    void                               errorToConsole(const std::string& message);
+
+    // Test numbers as reported in DofMessageHeader, one less than programmed in the MPS.
+    // An empty list selects every test number, or every channel.
+    void                               selectTestNumbers(const std::vector<int>& test_numbers);
+    void                               selectChannels(const std::vector<int>& channels);
+    void                               setWindow(const int& window_start, const int& window_end); // samples from gate start, 0, 0 for all
+
+    bool                               selected(const int& test_number, const int& channel) const;
+
+    // Called by PeakHandler for each frame
+    void                               beginFrame(const long& frame_number, const int& ascan_length, const int& max_rows);
+    void                               extract(const unsigned char* message, const PeakHandler::DofMessageHeader& header);
+    void                               publish();
+
+    const Matrix&                      matrix() const { return published_; };
+    size_t                             footprint() const;
+
+private:
+    std::vector<char>                  test_numbers_;         // Indexed by test number
+    std::vector<char>                  channels_;             // Indexed by channel
+    int                                window_start_;
+    int                                window_end_;
+
+    Matrix                             working_;
+    Matrix                             published_;
+};
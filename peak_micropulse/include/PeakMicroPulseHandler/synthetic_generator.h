@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vector>
+
+#include "PeakMicroPulseHandler/peak_handler.h"
+#include "PeakMicroPulseHandler/layered_medium.h"
+
+
+
+// Physically plausible A-Scans for benchmarking, from the reconstruction geometry and
+// MPS gate: interface echo, backwall, point scatterers and noise. Noise free A-Scans are
+// computed once, so each frame costs only the noise and the output encoding.
+// Frames are full matrix capture when the MPS gives n_elements^2 A-Scans, otherwise a
+// linear sweep of pulse-echo sub-apertures stepping one element per test.
+class SyntheticGenerator {
+public:
+    struct Scatterer {
+        double                         x;                     // mm from the array centre
+        double                         z;                     // mm below the specimen surface
+        double                         amplitude;             // Of full scale
+    };
+
+    SyntheticGenerator(
+        const PeakHandler::OutputFormat& geometry,            // After setReconstructionConfiguration and readMpsFile
+        const int& gate_start,                                // samples
+        const int& dof,
+        const int& first_test,                                // As programmed, reported one less
+        const int& aperture = 4,                              // Elements per sweep test
+        const double& centre_frequency = 5.0,                 // MHz
+        const int& digitisation_rate = 0);                    // MHz, 0 uses the geometry or 100 if unset
+    ~SyntheticGenerator();
+
+
+    void                               logToConsole(const std::string& message);
+    void                               errorToConsole(const std::string& message);
+    void                               addScatterer(const double& x, const double& z, const double& amplitude);
+    void                               setEchoAmplitudes(const double& interface_amplitude, const double& backwall_amplitude);
+    void                               setNoiseLevel(const double& noise_level);   // RMS, of full scale
+    void                               setSeed(const unsigned long long& seed);
+
+    void                               generate(PeakHandler::OutputFormat& frame);
+    void                               generatePacket(std::vector<unsigned char>& packet);
+
+    bool                               fmc() const { return fmc_; };
+    int                                packetLength() const { return num_a_scans_ * message_length_; };
+
+private:
+    void                               build();
+    void                               addPulse(float* ascan, const double& time, const double& amplitude) const;
+    float                              noise();
+    void                               ascanElements(const int& ascan, double& tx, double& rx) const;
+
+    PeakHandler::OutputFormat          geometry_;
+    LayeredMedium                      medium_;
+    const int                          gate_start_;
+    const int                          dof_;
+    const int                          first_test_;
+    const int                          aperture_;
+    const double                       centre_frequency_;
+    double                             digitisation_rate_;
+    int                                ascan_length_;
+    int                                num_a_scans_;
+    int                                message_length_;
+    bool                               fmc_;
+
+    std::vector<Scatterer>             scatterers_;
+    double                             interface_amplitude_;
+    double                             backwall_amplitude_;
+    float                              noise_level_;
+    unsigned long long                 rng_state_;
+
+    bool                               built_;
+    long                               frames_generated_;
+    std::vector<float>                 templates_;            // num_a_scans x ascan_length, noise free
+};
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "PeakMicroPulseHandler/peak_handler.h"
+#include "PeakMicroPulseHandler/layered_medium.h"
+#include "PeakMicroPulseHandler/thread_pool.h"
+
+
+
+// Total focusing method images of full matrix capture frames, n_elements^2 A-Scans with
+// the transmitting element changing slowest. Each pixel sums every transmit and receive
+// pair at the pair's travel time through the wedge and couplant, read from per element
+// delay tables built once for the pixels of the tile. A tile short of the whole grid
+// keeps only its own delays, so several imagers can share out one image. Several frames,
+// and several modes, longitudinal or shear and by way of the backwall, can be compounded
+// into one image in the same pass over the pairs. Modes share the A-Scan of each pair
+// while it is in cache, and the delay table of any leg they have in common.
+class TfmImager {
+public:
+    struct Grid {
+        double                         x_min;                 // mm from the array centre
+        double                         x_max;
+        double                         z_min;                 // mm below the specimen surface
+        double                         z_max;
+        int                            nx;
+        int                            nz;
+    };
+
+    struct Tile {
+        int                            x0;                    // Pixels of the grid
+        int                            z0;
+        int                            nx;
+        int                            nz;
+    };
+
+    enum Wave {
+        longitudinal,                          // L, at the material velocity
+        transverse                             // T, at the shear velocity
+    };
+
+    // Path of the sound to and from a pixel, the wave of each segment in the specimen. A leg
+    // of one segment goes straight between the array and the pixel, a leg of two reflects off
+    // the backwall at specimen_depth on the way, changing wave if the two differ.
+    struct Mode {
+        std::vector<Wave>              transmit;
+        std::vector<Wave>              receive;
+    };
+
+    static const Mode                  direct;                // LL
+    static const Mode                  half_skip;             // LLL, skips on the way in, straight back
+    static const Mode                  full_skip;             // LLLL
+
+    // Modes by name, transmit segments first, as in TT, TTT, TLT or TTTT. Three letters skip on
+    // the way in, four both ways, or a hyphen splits the legs as in T-TT.
+    static bool                        parseMode(const std::string& name, Mode& mode);
+    static std::string                 modeName(const Mode& mode);
+
+    struct Image {
+        long                           frame_number;
+        Tile                           tile;
+        std::vector<float>             pixels;                // Amplitudes, nx a row, z0 first
+    };
+
+    TfmImager(
+        const PeakHandler::OutputFormat& geometry,            // After setReconstructionConfiguration and readMpsFile
+        const int& gate_start,                                // samples
+        const Grid& grid,
+        const Tile& tile = {0, 0, 0, 0},                      // Empty for the whole grid
+        const int& n_threads = 0,                             // 0 uses the hardware concurrency
+        const int& digitisation_rate = 0);                    // MHz, 0 uses the geometry or 100 if unset
+    ~TfmImager();
+
+
+    void                               logToConsole(const std::string& message);
+    void                               errorToConsole(const std::string& message);
+
+    // Paths compounded into each image, direct alone until set. Rebuilds the delay tables.
+    bool                               setModes(const std::vector<Mode>& modes);
+    bool                               setModes(const std::vector<std::string>& names);
+    bool                               setShearVelocity(const double& vel_shear);      // m/s, before setModes with T
+    const std::vector<Mode>&           modes() const { return modes_; };
+
+    // image is reused between frames to avoid reallocating its pixels
+    bool                               process(const PeakHandler::OutputFormat& frame, Image& image);
+
+    // Frames compounded into one image: each path sums every frame coherently, then the
+    // magnitudes of the paths are averaged. The image takes the last frame's number.
+    bool                               process(const std::vector<const PeakHandler::OutputFormat*>& frames, Image& image);
+
+    const Grid&                        grid() const { return grid_; };
+    const Tile&                        tile() const { return tile_; };
+    double                             pixelX(const int& ix) const;                  // mm, of the grid
+    double                             pixelZ(const int& iz) const;
+    bool                               valid() const { return not delays_.empty(); };
+    ThreadPool&                        threadPool() { return workers_; };
+    size_t                             footprint() const;     // Bytes held, delays and sample scratch
+
+    // Horizontal bands of whole rows, as even as the rows allow
+    static std::vector<Tile>           bands(const Grid& grid, const int& n_bands);
+
+private:
+    void                               buildDelays();
+    void                               loadSamples(const PeakHandler::OutputFormat& frame, const int& slot);
+    bool                               compound(const PeakHandler::OutputFormat* const* frames, const int& n_frames, Image& image);
+
+    ThreadPool                         workers_;
+    LayeredMedium                      medium_;
+    const Grid                         grid_;
+    Tile                               tile_;
+    const int                          n_elements_;
+    const int                          ascan_length_;
+    const int                          gate_start_;
+    double                             digitisation_rate_;
+    int                                stride_;               // Samples a row, the A-Scan and two zeros
+    double                             shear_velocity_;       // mm/us, 0 if unset
+    std::vector<Mode>                  modes_;
+    std::vector<std::pair<int, int>>   mode_tables_;          // Transmit and receive delay table of each mode
+    int                                n_tables_;             // One for each different leg of the modes
+    std::vector<float>                 delays_;               // samples, per table one tile of pixels an element
+    std::vector<float>                 samples_;              // A-Scans as floats, one stride a row, frame after frame
+    std::vector<std::vector<float>>    sums_;                 // Per worker, the rows it is summing for each mode
+    bool                               warned_;
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "PeakMicroPulseHandler/tfm_imager.h"
+
+
+
+// TFM images stacked into a volume along the scan axis, each at the encoder position of its
+// frame. Voxels are kept in cubic bricks allocated only when an amplitude at or above the
+// threshold reaches them, so a whole part fits in memory. Frames landing in the same slice
+// keep the larger amplitude, as a peak hold would, so every voxel only grows and the max
+// and mean projections along each axis are updated in place as images are added.
+class TfmVolume {
+public:
+    enum Axis {
+        depth,                                 // Top view, x across and scan position down
+        scan,                                  // Side view, x across and depth down
+        lateral                                // End view, depth across and scan position down
+    };
+
+    enum Statistic {
+        maximum,
+        mean                                   // Over the whole axis, empty voxels as zero
+    };
+
+    struct Projection {
+        int                            width;
+        int                            height;
+        std::vector<float>             pixels;                // width a row
+    };
+
+    TfmVolume(
+        const TfmImager::Grid& grid,                          // Of the images added
+        const double& scan_start,                             // mm, position of the first slice
+        const double& scan_step,                              // mm between slices
+        const int& brick_size = 16,                           // Voxels along each edge of a brick
+        const float& threshold = 0.0f,                        // Amplitudes below are not stored
+        const int& max_slices = 16384);                       // Positions further along are refused
+    ~TfmVolume();
+
+
+    void                               logToConsole(const std::string& message);
+    void                               errorToConsole(const std::string& message);
+
+    // Whole images or tiles of the grid, at the scan position in mm. Slices are added as the
+    // scan reaches them, positions before scan_start or beyond max_slices are refused.
+    bool                               add(const TfmImager::Image& image, const double& position);
+    void                               clear();
+
+    // projection is reused between calls, sized on the first
+    void                               project(const Axis& axis, const Statistic& statistic, Projection& projection) const;
+    void                               slice(const int& iy, Projection& projection) const;       // x across, depth down
+    float                              voxel(const int& ix, const int& iz, const int& iy) const;
+
+    const TfmImager::Grid&             grid() const { return grid_; };
+    int                                nSlices() const { return n_slices_; };
+    int                                maxSlices() const { return max_slices_; };
+    double                             slicePosition(const int& iy) const { return scan_start_ + iy * scan_step_; };
+    long                               frames() const { return frames_; };
+    size_t                             bricks() const { return bricks_.size(); };
+    size_t                             brickSlots() const { return directory_.size(); };    // Bricks a dense volume would hold
+    size_t                             footprint() const;     // Bytes held by bricks, directory and projections
+
+private:
+    float*                             brick(const int& ix, const int& iz, const int& iy);     // Allocated if new
+    void                               addSlices(const int& n_slices);
+
+    const TfmImager::Grid              grid_;
+    const double                       scan_start_;
+    const double                       scan_step_;
+    const int                          brick_size_;
+    const int                          bricks_x_;
+    const int                          bricks_z_;
+    const float                        threshold_;
+    const int                          max_slices_;
+    int                                n_slices_;
+    long                               frames_;
+
+    std::vector<int32_t>               directory_;            // Brick index by x, z and scan brick, -1 if none
+    std::vector<std::unique_ptr<float[]>> bricks_;            // brick_size^3 voxels, x fastest then z then y
+
+    // Kept up to date per voxel as images are added
+    std::vector<float>                 depth_max_;            // nx by n_slices
+    std::vector<double>                depth_sum_;
+    std::vector<float>                 scan_max_;             // nx by nz
+    std::vector<double>                scan_sum_;
+    std::vector<float>                 lateral_max_;          // nz by n_slices
+    std::vector<double>                lateral_sum_;
+    bool                               warned_;
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+
+// Persistent worker threads for splitting per-frame work across A-Scans. The
+// calling thread takes part in each job as worker 0. Fewer threads than were started
+// can be set to take part, the rest stay parked, so a pool can be resized while in use.
+class ThreadPool {
+public:
+    explicit ThreadPool(const int& n_threads = 0);             // 0 uses the hardware concurrency
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+
+    // Calls fn(begin, end, worker) over chunks of [0, n) and blocks until done
+    void                               parallelFor(
+                                                const int& n,
+                                                const std::function<void(const int&, const int&, const int&)>& fn);
+    int                                size() const { return workers_.size() + 1; };
+
+    // Threads taking part in jobs from the next one on, including the caller, clamped to [1, size()]
+    void                               setActive(const int& n_threads);
+    int                                active() const { return active_threads_; };
+
+private:
+    void                               workerLoop(const int& worker);
+    void                               runJob(const int& worker);
+
+    std::vector<std::thread>                                         workers_;
+    std::mutex                                                       submit_mutex_;
+    std::mutex                                                       mutex_;
+    std::condition_variable                                          start_cv_;
+    std::condition_variable                                          done_cv_;
+    const std::function<void(const int&, const int&, const int&)>*   job_;
+    int                                                              job_n_;
+    int                                                              job_chunk_;
+    int                                                              job_threads_;
+    std::atomic<int>                                                 next_;
+    int                                                              active_;
+    long                                                             generation_;
+    bool                                                             stop_;
+    std::atomic<int>                                                 active_threads_;
+};
@@ -0,0 +1,181 @@
+#include "PeakMicroPulseHandler/autoscaler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+
+
+Autoscaler::Autoscaler(
+        const int& cpu_budget/* = 0*/,
+        const double& target_utilisation/* = 0.75*/,
+        const int& interval_ms/* = 250*/)
+    :  budget_(cpu_budget > 0 ? cpu_budget : std::max(1, (int)std::thread::hardware_concurrency())),
+       target_utilisation_(std::min(std::max(target_utilisation, 0.1), 1.0)),
+       interval_(std::max(interval_ms, 1)),
+       mutex_(),
+       stages_(),
+       last_rebalance_(std::chrono::steady_clock::now()),
+       rebalances_(0)
+{
+}
+
+
+Autoscaler::~Autoscaler() {
+}
+
+
+void Autoscaler::logToConsole(const std::string& message) {
+    std::cout << "Autoscaler :: " << message << std::endl;
+}
+
+
+void Autoscaler::errorToConsole(const std::string& message) {
+    std::cout << "\033[31m";
+    std::cout << "Autoscaler :: " << message << std::endl;
+    std::cout << "\033[0m";
+}
+
+
+int Autoscaler::addStage(const std::string& name, ThreadPool& pool, const FrameQueue* input/* = nullptr*/) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stages_.push_back({name, &pool, input, pool.active(), 0.0, 0.0, 0, 0.0, 0});
+
+    if ((int)stages_.size() > budget_) {
+        errorToConsole("ERROR - " + std::to_string(stages_.size()) + " stages over a budget of " + std::to_string(budget_) +
+                       " threads, each stage keeps one regardless");
+    }
+
+    std::vector<int> threads;
+    for (size_t i = 0; i < stages_.size(); i++) {
+        threads.push_back(budget_ / stages_.size() + (i < budget_ % stages_.size() ? 1 : 0));
+    }
+    apply(threads);
+    last_rebalance_ = std::chrono::steady_clock::now();
+    return stages_.size() - 1;
+}
+
+
+void Autoscaler::record(const int& stage, const double& wall_us) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stage < 0 or stage >= (int)stages_.size()) {
+        return;
+    }
+    stages_[stage].busy_us += wall_us;
+    stages_[stage].interval_frames++;
+    stages_[stage].frames++;
+
+    if (std::chrono::steady_clock::now() - last_rebalance_ >= interval_) {
+        rebalanceLocked();
+    }
+}
+
+
+bool Autoscaler::rebalance() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return rebalanceLocked();
+}
+
+
+bool Autoscaler::rebalanceLocked() {
+    const auto now = std::chrono::steady_clock::now();
+    const double elapsed_us = std::max(std::chrono::duration<double, std::micro>(now - last_rebalance_).count(), 1.0);
+    last_rebalance_ = now;
+    rebalances_++;
+
+    std::vector<int> wanted;
+    for (auto& stage : stages_) {
+        stage.utilisation = std::min(stage.busy_us / elapsed_us, 1.0);
+        stage.mean_latency_us = stage.interval_frames > 0 ? stage.busy_us / stage.interval_frames : 0.0;
+        const bool backlog = stage.input != nullptr and stage.input->size() > stage.input->depth() / 2;
+
+        // The work of a frame is taken to split evenly over the threads. A stage that finished
+        // nothing may be part way through a long frame, so only an empty input shrinks it.
+        int threads = stage.threads;
+        if (stage.interval_frames == 0) {
+            threads = stage.input != nullptr and stage.input->size() == 0 ? 1 : stage.threads;
+        } else if (stage.utilisation > target_utilisation_ or stage.utilisation < 0.5 * target_utilisation_) {
+            threads = (int)std::ceil(stage.threads * stage.utilisation / target_utilisation_);
+        }
+        if (backlog) {
+            threads = std::max(threads, stage.threads + 1);
+        }
+        wanted.push_back(std::min(std::max(threads, 1), stage.pool->size()));
+
+        stage.busy_us = 0.0;
+        stage.interval_frames = 0;
+    }
+
+    int total = 0;
+    for (const int& threads : wanted) {
+        total += threads;
+    }
+
+    // Over budget, each stage keeps one and the rest go in proportion, largest remainders first
+    if (total > budget_) {
+        const int spare = std::max(budget_ - (int)stages_.size(), 0);
+        const int asked = total - stages_.size();
+        std::vector<std::pair<double, size_t>> remainders;
+        int given = 0;
+        for (size_t i = 0; i < wanted.size(); i++) {
+            const double share = asked > 0 ? (double)spare * (wanted[i] - 1) / asked : 0.0;
+            wanted[i] = 1 + (int)share;
+            given += (int)share;
+            remainders.emplace_back(share - (int)share, i);
+        }
+        std::sort(remainders.rbegin(), remainders.rend());
+        for (size_t i = 0; i < remainders.size() and given < spare; i++, given++) {
+            wanted[remainders[i].second]++;
+        }
+    }
+
+    bool changed = false;
+    for (size_t i = 0; i < stages_.size(); i++) {
+        changed = changed or wanted[i] != stages_[i].threads;
+    }
+    if (changed) {
+        apply(wanted);
+    }
+    return changed;
+}
+
+
+void Autoscaler::apply(const std::vector<int>& threads) {
+    for (size_t i = 0; i < stages_.size(); i++) {
+        stages_[i].pool->setActive(threads[i]);
+        stages_[i].threads = stages_[i].pool->active();
+    }
+}
+
+
+std::vector<Autoscaler::Stage> Autoscaler::stages() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stages_;
+}
+
+
+int Autoscaler::threadsInUse() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int threads = 0;
+    for (const auto& stage : stages_) {
+        threads += stage.threads;
+    }
+    return threads;
+}
+
+
+std::string Autoscaler::report() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::ostringstream report;
+    report << std::fixed << std::setprecision(1);
+    for (const auto& stage : stages_) {
+        report << std::left << std::setw(24) << stage.name << std::right
+               << std::setw(4) << stage.threads << " threads"
+               << std::setw(8) << 100.0 * stage.utilisation << " % busy"
+               << std::setw(10) << stage.mean_latency_us << " us a frame"
+               << std::setw(8) << (stage.input != nullptr ? (long)stage.input->size() : 0L) << " queued" << std::endl;
+    }
+    return report.str();
+}
@@ -0,0 +1,297 @@
+#include "PeakMicroPulseHandler/columnar_store.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sys/types.h>
+
+
+
+namespace {
+    const int32_t columnar_version = 1;
+
+    size_t blockBytes(const int& block_ascans, const int& ascan_length) {
+        return (size_t)block_ascans * (sizeof(int64_t) + (size_t)ascan_length * sizeof(short int));
+    }
+}
+
+
+
+ColumnarWriter::ColumnarWriter(
+        const std::string& path,
+        const PeakHandler::OutputFormat& geometry,
+        const int& block_ascans/* = 64*/)
+    :  ascan_length_(std::max(geometry.ascan_length, 1)),
+       block_ascans_(std::max(block_ascans, 1)),
+       data_(std::fopen(path.c_str(), "wb")),
+       index_(std::fopen((path + ".index").c_str(), "wb")),
+       open_blocks_(),
+       blocks_written_(0),
+       failed_(false)
+{
+    if (data_ == nullptr or index_ == nullptr) {
+        errorToConsole("ERROR - Unable to create " + path + " and its index");
+        failed_ = true;
+        return;
+    }
+
+    Header header = {{'P', 'M', 'P', 'C'}, columnar_version, ascan_length_, block_ascans_};
+    if (std::fwrite(&header, sizeof(header), 1, index_) != 1) {
+        failed_ = true;
+    }
+    logToConsole("Writing to " + path + " in blocks of " + std::to_string(block_ascans_) + " A-Scans, " +
+                 std::to_string(blockBytes(block_ascans_, ascan_length_) / 1024) + " kB");
+}
+
+
+ColumnarWriter::~ColumnarWriter() {
+    close();
+}
+
+
+void ColumnarWriter::logToConsole(const std::string& message) {
+    std::cout << "ColumnarWriter :: " << message << std::endl;
+}
+
+
+void ColumnarWriter::errorToConsole(const std::string& message) {
+    std::cout << "\033[31m";
+    std::cout << "ColumnarWriter :: " << message << std::endl;
+    std::cout << "\033[0m";
+}
+
+
+bool ColumnarWriter::write(const PeakHandler::OutputFormat& frame) {
+    if (not good()) {
+        return false;
+    }
+
+    for (const auto& message : frame.ascans) {
+        const Stream stream(message.header.testNo, message.header.channel);
+        auto found = open_blocks_.find(stream);
+        if (found == open_blocks_.end()) {
+            // A stream's block is sized once, then reused for every block that follows
+            OpenBlock block;
+            block.record = {message.header.testNo, message.header.channel, 0, 0, 0, 0};
+            block.frame_numbers.resize(block_ascans_);
+            block.samples.resize((size_t)block_ascans_ * ascan_length_);
+            found = open_blocks_.emplace(stream, std::move(block)).first;
+        }
+        OpenBlock& block = found->second;
+
+        const int row = block.record.n_ascans;
+        short int* samples = &block.samples[(size_t)row * ascan_length_];
+        const int offset = std::min(std::max(message.header.sample_offset, 0), ascan_length_);
+        const int length = std::min((int)message.amps.size(), ascan_length_ - offset);
+        std::fill(samples, samples + offset, 0);
+        std::copy(message.amps.begin(), message.amps.begin() + length, samples + offset);
+        std::fill(samples + offset + length, samples + ascan_length_, 0);
+
+        block.frame_numbers[row] = frame.frame_number;
+        if (row == 0) {
+            block.record.first_frame = frame.frame_number;
+        }
+        block.record.last_frame = frame.frame_number;
+        block.record.n_ascans++;
+
+        if (block.record.n_ascans == block_ascans_ and not writeBlock(block)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+bool ColumnarWriter::writeBlock(OpenBlock& block) {
+    // Unfilled rows of a stream's last block are written too, so every block has the same size
+    const int n_ascans = block.record.n_ascans;
+    std::fill(block.frame_numbers.begin() + n_ascans, block.frame_numbers.end(), -1);
+    std::fill(block.samples.begin() + (size_t)n_ascans * ascan_length_, block.samples.end(), 0);
+
+    const bool written =
+        std::fwrite(block.frame_numbers.data(), sizeof(int64_t), block_ascans_, data_) == (size_t)block_ascans_ and
+        std::fwrite(block.samples.data(), sizeof(short int), block.samples.size(), data_) == block.samples.size() and
+        std::fwrite(&block.record, sizeof(block.record), 1, index_) == 1;
+
+    if (not written) {
+        errorToConsole("ERROR - Write failed after " + std::to_string(blocks_written_) + " blocks");
+        failed_ = true;
+        return false;
+    }
+
+    blocks_written_++;
+    block.record.n_ascans = 0;
+    return true;
+}
+
+
+void ColumnarWriter::close() {
+    if (data_ != nullptr and not failed_) {
+        for (auto& open_block : open_blocks_) {
+            if (open_block.second.record.n_ascans > 0) {
+                writeBlock(open_block.second);
+            }
+        }
+    }
+    open_blocks_.clear();
+
+    if (data_ != nullptr) {
+        std::fclose(data_);
+        data_ = nullptr;
+        logToConsole("Closed after " + std::to_string(blocks_written_) + " blocks");
+    }
+    if (index_ != nullptr) {
+        std::fclose(index_);
+        index_ = nullptr;
+    }
+}
+
+
+size_t ColumnarWriter::footprint() const {
+    size_t bytes = 0;
+    for (const auto& open_block : open_blocks_) {
+        bytes += sizeof(OpenBlock) +
+                 open_block.second.frame_numbers.capacity() * sizeof(int64_t) +
+                 open_block.second.samples.capacity() * sizeof(short int);
+    }
+    return bytes;
+}
+
+
+
+ColumnarReader::ColumnarReader(const std::string& path)
+    :  header_(),
+       data_(nullptr),
+       block_bytes_(0),
+       blocks_(),
+       frame_scratch_(),
+       bytes_read_(0)
+{
+    std::FILE* index = std::fopen((path + ".index").c_str(), "rb");
+    if (index == nullptr or std::fread(&header_, sizeof(header_), 1, index) != 1 or
+            std::memcmp(header_.magic, "PMPC", 4) != 0 or header_.version != columnar_version or
+            header_.block_ascans <= 0 or header_.ascan_length <= 0) {
+        errorToConsole("ERROR - " + path + ".index is missing or not a columnar index");
+        if (index != nullptr) {
+            std::fclose(index);
+        }
+        return;
+    }
+
+    ColumnarWriter::BlockRecord record;
+    long block = 0;
+    while (std::fread(&record, sizeof(record), 1, index) == 1) {
+        // A block holds at most block_ascans rows, more would run past the frame numbers read
+        if (record.n_ascans < 0 or record.n_ascans > header_.block_ascans) {
+            errorToConsole("ERROR - Block " + std::to_string(block) + " of " + path + ".index claims " +
+                           std::to_string(record.n_ascans) + " A-Scans of at most " + std::to_string(header_.block_ascans));
+            blocks_.clear();
+            std::fclose(index);
+            return;
+        }
+        blocks_[ColumnarWriter::Stream(record.test_number, record.channel)].emplace_back(record, block++);
+    }
+    std::fclose(index);
+
+    data_ = std::fopen(path.c_str(), "rb");
+    if (data_ == nullptr) {
+        errorToConsole("ERROR - Unable to open " + path);
+        return;
+    }
+    block_bytes_ = blockBytes(header_.block_ascans, header_.ascan_length);
+
+    // Every block is written whole, so the file bounds the sizes taken from the index
+    const off_t data_bytes = fseeko(data_, 0, SEEK_END) == 0 ? ftello(data_) : -1;
+    if (data_bytes < 0 or (block > 0 and block_bytes_ > (size_t)data_bytes / block)) {
+        errorToConsole("ERROR - " + path + " is shorter than its index");
+        std::fclose(data_);
+        data_ = nullptr;
+        blocks_.clear();
+        return;
+    }
+    frame_scratch_.resize(block > 0 ? header_.block_ascans : 0);
+    logToConsole("Opened " + path + ": " + std::to_string(blocks_.size()) + " streams, " + std::to_string(block) + " blocks");
+}
+
+
+ColumnarReader::~ColumnarReader() {
+    if (data_ != nullptr) {
+        std::fclose(data_);
+    }
+}
+
+
+void ColumnarReader::logToConsole(const std::string& message) {
+    std::cout << "ColumnarReader :: " << message << std::endl;
+}
+
+
+void ColumnarReader::errorToConsole(const std::string& message) {
+    std::cout << "\033[31m";
+    std::cout << "ColumnarReader :: " << message << std::endl;
+    std::cout << "\033[0m";
+}
+
+
+std::vector<ColumnarWriter::Stream> ColumnarReader::streams() const {
+    std::vector<ColumnarWriter::Stream> streams;
+    for (const auto& stream : blocks_) {
+        streams.push_back(stream.first);
+    }
+    return streams;
+}
+
+
+int ColumnarReader::read(
+        const int& test_number,
+        const int& channel,
+        const long& first_frame,
+        const long& last_frame,
+        std::vector<short int>& samples,
+        std::vector<long>& frame_numbers) {
+
+    const auto found = blocks_.find(ColumnarWriter::Stream(test_number, channel));
+    if (not good() or found == blocks_.end()) {
+        return 0;
+    }
+
+    const size_t row_bytes = (size_t)header_.ascan_length * sizeof(short int);
+    int rows = 0;
+    for (const auto& block : found->second) {
+        const ColumnarWriter::BlockRecord& record = block.first;
+        if (record.last_frame < first_frame or record.first_frame > last_frame) {
+            continue;
+        }
+        const off_t block_start = (off_t)block.second * block_bytes_;
+
+        // Frame numbers first, then only the run of rows inside the range
+        if (fseeko(data_, block_start, SEEK_SET) != 0 or
+                std::fread(frame_scratch_.data(), sizeof(int64_t), record.n_ascans, data_) != (size_t)record.n_ascans) {
+            errorToConsole("ERROR - Block " + std::to_string(block.second) + " is truncated");
+            break;
+        }
+        bytes_read_ += record.n_ascans * sizeof(int64_t);
+
+        const auto begin = std::lower_bound(frame_scratch_.begin(), frame_scratch_.begin() + record.n_ascans, (int64_t)first_frame);
+        const auto end = std::upper_bound(begin, frame_scratch_.begin() + record.n_ascans, (int64_t)last_frame);
+        const int first_row = begin - frame_scratch_.begin();
+        const int n_rows = end - begin;
+        if (n_rows == 0) {
+            continue;
+        }
+
+        const size_t previous = samples.size();
+        samples.resize(previous + (size_t)n_rows * header_.ascan_length);
+        const off_t rows_start = block_start + (off_t)header_.block_ascans * sizeof(int64_t) + (off_t)first_row * row_bytes;
+        if (fseeko(data_, rows_start, SEEK_SET) != 0 or
+                std::fread(&samples[previous], row_bytes, n_rows, data_) != (size_t)n_rows) {
+            errorToConsole("ERROR - Block " + std::to_string(block.second) + " is truncated");
+            samples.resize(previous);
+            break;
+        }
+        bytes_read_ += n_rows * row_bytes;
+
+        frame_numbers.insert(frame_numbers.end(), begin, end);
+        rows += n_rows;
+    }
+    return rows;
+}
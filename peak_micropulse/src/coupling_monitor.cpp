@@ -0,0 +1,183 @@
+#include "PeakMicroPulseHandler/coupling_monitor.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+
+CouplingMonitor::CouplingMonitor(
+        const int& window_start,
+        const int& window_end,
+        const double& threshold_db/* = -12.0*/,
+        const double& lost_fraction/* = 0.5*/,
+        const int& reference_frames/* = 10*/)
+    :  window_start_(window_start),
+       window_end_(window_end),
+       threshold_db_(threshold_db),
+       lost_fraction_(lost_fraction),
+       reference_frames_(reference_frames),
+       callback_(),
+       reference_energy_(),
+       reference_count_(0),
+       energy_db_(),
+       coupled_(true),
+       frame_(0)
+{
+}
+
+
+CouplingMonitor::~CouplingMonitor() {
+}
+
+
+void CouplingMonitor::logToConsole(const std::string& message) {
+    std::cout << "CouplingMonitor :: " << message << std::endl;
+}
+
+
+void CouplingMonitor::errorToConsole(const std::string& message) {
+    std::cout << "\033[31m";
+    std::cout << "CouplingMonitor :: " << message << std::endl;
+    std::cout << "\033[0m";
+}
+
+
+void CouplingMonitor::setReference(const std::vector<double>& reference_energy) {
+    reference_energy_ = reference_energy;
+    reference_count_ = reference_frames_;
+    logToConsole("Interface echo reference set for " + std::to_string(reference_energy_.size()) + " A-Scans");
+}
+
+
+void CouplingMonitor::setEventCallback(const std::function<void(const CouplingEvent&)>& callback) {
+    callback_ = callback;
+}
+
+
+void CouplingMonitor::reset() {
+    reference_energy_.clear();
+    reference_count_ = 0;
+    energy_db_.clear();
+    coupled_ = true;
+    frame_ = 0;
+}
+
+
+double CouplingMonitor::interfaceEnergy(const PeakHandler::DofMessage& message) const {
+    const std::vector<short int>& amps = message.amps;
+    int start = std::max(window_start_ - message.header.sample_offset, 0);
+    int end = std::min(window_end_ - message.header.sample_offset, (int)amps.size());
+
+    if (end <= start) {
+        return 0.0;
+    }
+
+    // About the window mean, so the 8 bit offset does not count as echo energy
+    double mean = 0.0;
+    for (int i = start; i < end; i++) {
+        mean += amps[i];
+    }
+    mean /= end - start;
+
+    double energy = 0.0;
+    for (int i = start; i < end; i++) {
+        const double amp = amps[i] - mean;
+        energy += amp * amp;
+    }
+    return energy / (end - start);
+}
+
+
+void CouplingMonitor::raise(const CouplingEventType& type, const int& testNo, const double& lost_fraction) {
+    if (callback_) {
+        CouplingEvent event;
+        event.type = type;
+        event.frame = frame_;
+        event.testNo = testNo;
+        event.lost_fraction = lost_fraction;
+        callback_(event);
+    }
+}
+
+
+void CouplingMonitor::reportLwlFailures(const std::vector<int>& test_numbers) {
+    for (auto testNo : test_numbers) {
+        raise(lwl_failure, testNo, 0.0);
+    }
+
+    if (not test_numbers.empty() and coupled_) {
+        errorToConsole("Coupling lost - LWL failure on " + std::to_string(test_numbers.size()) + " tests");
+        coupled_ = false;
+    }
+}
+
+
+bool CouplingMonitor::check(const PeakHandler::OutputFormat& frame) {
+    ++frame_;
+    bool was_coupled = coupled_;
+    reportLwlFailures(frame.coupling_failures);
+
+    const int n_ascans = frame.ascans.size();
+
+    // Learn the reference as the mean of the first frames, unless one has been set
+    if (reference_count_ < reference_frames_) {
+        if (not frame.coupling_failures.empty()) {
+            return false;
+        }
+
+        if ((int)reference_energy_.size() != n_ascans) {
+            reference_energy_.assign(n_ascans, 0.0);
+            reference_count_ = 0;
+        }
+
+        ++reference_count_;
+        for (int i = 0; i < n_ascans; i++) {
+            reference_energy_[i] += (interfaceEnergy(frame.ascans[i]) - reference_energy_[i]) / reference_count_;
+        }
+
+        if (reference_count_ == reference_frames_) {
+            logToConsole("Interface echo reference learnt over " + std::to_string(reference_frames_) + " frames");
+        }
+
+        coupled_ = true;
+        return coupled_;
+    }
+
+    if ((int)reference_energy_.size() != n_ascans) {
+        errorToConsole("ERROR - Reference covers " + std::to_string(reference_energy_.size()) +
+                       " A-Scans but frame has " + std::to_string(n_ascans));
+        return coupled_;
+    }
+
+    energy_db_.resize(n_ascans);
+    int lost = 0;
+
+    for (int i = 0; i < n_ascans; i++) {
+        double energy = interfaceEnergy(frame.ascans[i]);
+        double reference = std::max(reference_energy_[i], 1e-12);
+        energy_db_[i] = 10.0 * std::log10(std::max(energy, 1e-12) / reference);
+
+        if (energy_db_[i] < threshold_db_) {
+            ++lost;
+        }
+    }
+
+    double lost_fraction = n_ascans > 0 ? (double)lost / n_ascans : 0.0;
+    bool echo_lost = n_ascans > 0 and lost_fraction >= lost_fraction_;
+
+    if (echo_lost) {
+        if (was_coupled) {
+            errorToConsole("Coupling lost - interface echo below threshold on " + std::to_string(lost) + " A-Scans");
+        }
+        raise(interface_echo_loss, -1, lost_fraction);
+    }
+
+    coupled_ = not echo_lost and frame.coupling_failures.empty();
+
+    if (coupled_ and not was_coupled) {
+        logToConsole("Coupling restored");
+        raise(coupling_restored, -1, lost_fraction);
+    }
+
+    return coupled_;
+}
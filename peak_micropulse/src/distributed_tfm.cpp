@@ -0,0 +1,515 @@
+#include "PeakMicroPulseHandler/distributed_tfm.h"
+
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#include <poll.h>
+#include <sys/socket.h>
+
+
+
+namespace {
+    const uint32_t tfm_magic = 0x54464D50;                    // "PMFT"
+    const uint16_t tfm_version = 1;
+    const uint64_t max_payload_bytes = 512u * 1024 * 1024;    // Largest message accepted, as for the frame relay
+
+    enum MessageType : uint16_t {
+        assignment = 1,                                       // Coordinator to worker, once
+        frame_message = 2,                                    // Coordinator to worker
+        tile_message = 3                                      // Worker to coordinator
+    };
+
+    struct MessageHeader {
+        uint32_t                       magic;
+        uint16_t                       version;
+        uint16_t                       type;
+        uint64_t                       sequence;              // Of the frame, in push order
+        uint64_t                       payload_bytes;
+    };
+
+    // Followed by the geometry as a frame without A-Scans
+    struct AssignmentRecord {
+        int32_t                        gate_start;
+        int32_t                        compression;
+        double                         x_min;
+        double                         x_max;
+        double                         z_min;
+        double                         z_max;
+        int32_t                        nx;
+        int32_t                        nz;
+        int32_t                        tile_x0;
+        int32_t                        tile_z0;
+        int32_t                        tile_nx;
+        int32_t                        tile_nz;
+    };
+
+    // Followed by the tile's pixels
+    struct TileRecord {
+        int64_t                        frame_number;
+        int32_t                        x0;
+        int32_t                        z0;
+        int32_t                        nx;
+        int32_t                        nz;
+    };
+
+    MessageHeader messageHeader(const MessageType& type, const uint64_t& sequence, const size_t& payload_bytes) {
+        return {tfm_magic, tfm_version, type, sequence, payload_bytes};
+    }
+
+    bool validHeader(const MessageHeader& header, const MessageType& type) {
+        return header.magic == tfm_magic and header.version == tfm_version and header.type == type and
+               header.payload_bytes <= max_payload_bytes;
+    }
+}
+
+
+
+TfmCoordinator::TfmCoordinator(
+        const PeakHandler::OutputFormat& geometry,
+        const int& gate_start,
+        const TfmImager::Grid& grid,
+        const int& port/* = 0*/,
+        const FrameRelay::Compression& compression/* = FrameRelay::none*/,
+        const size_t& max_in_flight/* = 8*/)
+    :  geometry_(),
+       gate_start_(gate_start),
+       grid_(grid),
+       compression_(compression),
+       io_(),
+       acceptor_(io_),
+       port_(port),
+       workers_(),
+       queue_(geometry, std::max<size_t>(max_in_flight, 1)),
+       images_(std::max<size_t>(max_in_flight, 1)),
+       message_(),
+       push_mutex_(),
+       mutex_(),
+       ready_cv_(),
+       pending_(),
+       ready_(),
+       next_sequence_(0),
+       running_(false),
+       failed_(false),
+       frames_sent_(0),
+       images_completed_(0),
+       rejected_(0),
+       sender_()
+{
+    PeakHandler::copyFrameMetadata(geometry, geometry_);
+    geometry_.ascans.clear();
+}
+
+
+TfmCoordinator::~TfmCoordinator() {
+    close();
+}
+
+
+void TfmCoordinator::logToConsole(const std::string& message) {
+    std::cout << "TfmCoordinator :: " << message << std::endl;
+}
+
+
+void TfmCoordinator::errorToConsole(const std::string& message) {
+    std::cout << "\033[31m";
+    std::cout << "TfmCoordinator :: " << message << std::endl;
+    std::cout << "\033[0m";
+}
+
+
+bool TfmCoordinator::listen() {
+    using boost::asio::ip::tcp;
+
+    if (acceptor_.is_open()) {
+        return true;
+    }
+    try {
+        acceptor_.open(tcp::v4());
+        acceptor_.set_option(tcp::acceptor::reuse_address(true));
+        acceptor_.bind(tcp::endpoint(tcp::v4(), port_));
+        acceptor_.listen();
+        port_ = acceptor_.local_endpoint().port();
+    } catch (const boost::system::system_error& e) {
+        errorToConsole("ERROR - Unable to listen on port " + std::to_string(port_) + ", " + e.what());
+        boost::system::error_code ec;
+        acceptor_.close(ec);
+        return false;
+    }
+    return true;
+}
+
+
+bool TfmCoordinator::start(const int& n_workers, const int& timeout_ms/* = 10000*/) {
+    using boost::asio::ip::tcp;
+
+    if (running_ or not workers_.empty()) {
+        errorToConsole("ERROR - Already started");
+        return false;
+    }
+    if (not listen()) {
+        return false;
+    }
+
+    const std::vector<TfmImager::Tile> tiles = TfmImager::bands(grid_, n_workers);
+    logToConsole("Listening on port " + std::to_string(port_) + " for " + std::to_string(tiles.size()) + " workers");
+
+    // The geometry travels as a frame without A-Scans
+    std::vector<unsigned char> geometry;
+    FrameRelay::serialise(geometry_, FrameRelay::none, geometry);
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    for (const auto& tile : tiles) {
+        const int remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        pollfd listening = {acceptor_.native_handle(), POLLIN, 0};
+        if (remaining <= 0 or ::poll(&listening, 1, remaining) <= 0) {
+            errorToConsole("ERROR - Only " + std::to_string(workers_.size()) + " of " + std::to_string(tiles.size()) + " workers connected");
+            close();
+            return false;
+        }
+
+        std::unique_ptr<Worker> worker(new Worker());
+        worker->socket.reset(new tcp::socket(io_));
+        worker->tile = tile;
+        boost::system::error_code ec;
+        acceptor_.accept(*worker->socket, ec);
+        if (not ec) {
+            worker->socket->set_option(tcp::no_delay(true), ec);
+        }
+
+        const AssignmentRecord record = {
+            gate_start_, (int32_t)compression_,
+            grid_.x_min, grid_.x_max, grid_.z_min, grid_.z_max, grid_.nx, grid_.nz,
+            tile.x0, tile.z0, tile.nx, tile.nz
+        };
+        const MessageHeader header = messageHeader(assignment, 0, sizeof(record) + geometry.size());
+        const std::array<boost::asio::const_buffer, 3> message = {
+            boost::asio::buffer(&header, sizeof(header)),
+            boost::asio::buffer(&record, sizeof(record)),
+            boost::asio::buffer(geometry)
+        };
+        if (not ec) {
+            boost::asio::write(*worker->socket, message, ec);
+        }
+        if (ec) {
+            errorToConsole("ERROR - Worker " + std::to_string(workers_.size()) + " failed to connect, " + ec.message());
+            close();
+            return false;
+        }
+        workers_.push_back(std::move(worker));
+    }
+
+    running_ = true;
+    for (auto& worker : workers_) {
+        worker->reader = std::thread(&TfmCoordinator::readerLoop, this, std::ref(*worker));
+    }
+    sender_ = std::thread(&TfmCoordinator::senderLoop, this);
+    logToConsole(std::to_string(workers_.size()) + " workers connected, imaging " +
+                 std::to_string(grid_.nx) + " x " + std::to_string(grid_.nz) + " pixels");
+    return true;
+}
+
+
+bool TfmCoordinator::push(const PeakHandler::OutputFormat& frame) {
+    if (not good()) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> push_lock(push_mutex_);
+    std::shared_ptr<TfmImager::Image> image = images_.acquire();
+    if (image == nullptr) {
+        rejected_++;
+        return false;
+    }
+    image->frame_number = frame.frame_number;
+    image->tile = {0, 0, grid_.nx, grid_.nz};
+    image->pixels.resize((size_t)grid_.nx * grid_.nz);
+
+    // Registered before the frame is queued, so its tiles always find it
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.push_back({next_sequence_, image, (int)workers_.size()});
+    }
+    if (not queue_.push(frame)) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.pop_back();
+        return false;
+    }
+    next_sequence_++;
+    return true;
+}
+
+
+std::shared_ptr<const TfmImager::Image> TfmCoordinator::pop(const int& timeout_ms/* = -1*/) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    const auto woken = [this]{ return not ready_.empty() or failed_ or not running_; };
+    if (timeout_ms < 0) {
+        ready_cv_.wait(lock, woken);
+    } else {
+        ready_cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms), woken);
+    }
+
+    if (ready_.empty()) {
+        return nullptr;
+    }
+    std::shared_ptr<const TfmImager::Image> image = ready_.front();
+    ready_.pop_front();
+    return image;
+}
+
+
+void TfmCoordinator::senderLoop() {
+    uint64_t sequence = 0;
+
+    while (running_ or queue_.size() > 0) {
+        auto frame = queue_.pop(50);
+        if (frame == nullptr) {
+            continue;
+        }
+
+        // Serialised once whatever the number of workers
+        message_.resize(sizeof(MessageHeader));
+        FrameRelay::serialise(*frame, compression_, message_);
+        frame.reset();
+        const MessageHeader header = messageHeader(frame_message, sequence++, message_.size() - sizeof(MessageHeader));
+        std::memcpy(message_.data(), &header, sizeof(header));
+
+        if (failed_) {
+            continue;
+        }
+        for (auto& worker : workers_) {
+            boost::system::error_code ec;
+            boost::asio::write(*worker->socket, boost::asio::buffer(message_), ec);
+            if (ec) {
+                fail("ERROR - Send to the worker imaging rows " + std::to_string(worker->tile.z0) + " on failed, " + ec.message());
+                break;
+            }
+        }
+        frames_sent_++;
+    }
+}
+
+
+void TfmCoordinator::readerLoop(Worker& worker) {
+    const TfmImager::Tile& tile = worker.tile;
+    const size_t pixels = (size_t)tile.nx * tile.nz;
+
+    while (true) {
+        MessageHeader header;
+        TileRecord record;
+        boost::system::error_code ec;
+        boost::asio::read(*worker.socket, boost::asio::buffer(&header, sizeof(header)), ec);
+        if (not ec) {
+            boost::asio::read(*worker.socket, boost::asio::buffer(&record, sizeof(record)), ec);
+        }
+        if (ec) {
+            if (running_) {
+                fail("ERROR - Lost the worker imaging rows " + std::to_string(tile.z0) + " on, " + ec.message());
+            }
+            return;
+        }
+        if (not validHeader(header, tile_message) or header.payload_bytes != sizeof(record) + pixels * sizeof(float) or
+                record.x0 != tile.x0 or record.z0 != tile.z0 or record.nx != tile.nx or record.nz != tile.nz) {
+            fail("ERROR - Worker imaging rows " + std::to_string(tile.z0) + " on sent a tile that is not its own");
+            return;
+        }
+
+        std::shared_ptr<TfmImager::Image> image;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (not pending_.empty() and header.sequence >= pending_.front().sequence and
+                    header.sequence - pending_.front().sequence < pending_.size()) {
+                image = pending_[header.sequence - pending_.front().sequence].image;
+            }
+        }
+        if (image == nullptr) {
+            fail("ERROR - Worker imaging rows " + std::to_string(tile.z0) + " on sent a tile of an unknown frame");
+            return;
+        }
+
+        // Bands are whole rows, so the tile lands in one run of the image
+        boost::asio::read(*worker.socket, boost::asio::buffer(&image->pixels[(size_t)tile.z0 * grid_.nx], pixels * sizeof(float)), ec);
+        if (ec) {
+            if (running_) {
+                fail("ERROR - Lost the worker imaging rows " + std::to_string(tile.z0) + " on, " + ec.message());
+            }
+            return;
+        }
+
+        bool completed = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pending_[header.sequence - pending_.front().sequence].tiles_remaining--;
+            while (not pending_.empty() and pending_.front().tiles_remaining == 0) {
+                ready_.push_back(pending_.front().image);
+                pending_.pop_front();
+                images_completed_++;
+                completed = true;
+            }
+        }
+        if (completed) {
+            ready_cv_.notify_all();
+        }
+    }
+}
+
+
+void TfmCoordinator::fail(const std::string& message) {
+    if (not failed_.exchange(true)) {
+        errorToConsole(message + ", no more frames will be imaged");
+    }
+    ready_cv_.notify_all();
+}
+
+
+bool TfmCoordinator::close(const int& timeout_ms/* = 10000*/) {
+    bool complete = true;
+    if (sender_.joinable()) {
+        // The images still being worked on are waited for, unless a worker is lost or stalls
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (not ready_cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this]{ return pending_.empty() or failed_; })) {
+                errorToConsole("ERROR - " + std::to_string(pending_.size()) + " images still outstanding after " +
+                               std::to_string(timeout_ms) + " ms, closing without them");
+                complete = false;
+            }
+            complete = complete and not failed_;
+        }
+        running_ = false;
+        sender_.join();
+        logToConsole("Closed after " + std::to_string(images_completed_) + " images, " + std::to_string(rejected()) + " pushes refused");
+    }
+    running_ = false;
+
+    // Shutting down the sockets ends the workers and wakes the blocking reads
+    for (auto& worker : workers_) {
+        ::shutdown(worker->socket->native_handle(), SHUT_RDWR);
+    }
+    for (auto& worker : workers_) {
+        if (worker->reader.joinable()) {
+            worker->reader.join();
+        }
+        boost::system::error_code ec;
+        worker->socket->close(ec);
+    }
+    workers_.clear();
+
+    boost::system::error_code ec;
+    acceptor_.close(ec);
+    ready_cv_.notify_all();
+    return complete;
+}
+
+
+
+TfmWorker::TfmWorker(
+        const std::string& host,
+        const int& port,
+        const int& n_threads/* = 0*/)
+    :  host_(host),
+       port_(port),
+       n_threads_(n_threads),
+       io_(),
+       socket_(io_),
+       frames_imaged_(0)
+{
+}
+
+
+TfmWorker::~TfmWorker() {
+}
+
+
+void TfmWorker::logToConsole(const std::string& message) {
+    std::cout << "TfmWorker :: " << message << std::endl;
+}
+
+
+void TfmWorker::errorToConsole(const std::string& message) {
+    std::cout << "\033[31m";
+    std::cout << "TfmWorker :: " << message << std::endl;
+    std::cout << "\033[0m";
+}
+
+
+bool TfmWorker::run() {
+    using boost::asio::ip::tcp;
+
+    try {
+        tcp::resolver resolver(io_);
+        boost::asio::connect(socket_, resolver.resolve(host_, std::to_string(port_)));
+        socket_.set_option(tcp::no_delay(true));
+    } catch (const boost::system::system_error& e) {
+        errorToConsole("ERROR - Unable to reach the coordinator at " + host_ + ":" + std::to_string(port_) + ", " + e.what());
+        return false;
+    }
+
+    MessageHeader header;
+    std::vector<unsigned char> payload;
+    boost::system::error_code ec;
+
+    boost::asio::read(socket_, boost::asio::buffer(&header, sizeof(header)), ec);
+    AssignmentRecord record;
+    if (ec or not validHeader(header, assignment) or header.payload_bytes < sizeof(record)) {
+        errorToConsole("ERROR - Coordinator did not send an assignment");
+        return false;
+    }
+    payload.resize(header.payload_bytes);
+    boost::asio::read(socket_, boost::asio::buffer(payload), ec);
+
+    PeakHandler::OutputFormat geometry;
+    const unsigned char* position = payload.data() + sizeof(record);
+    std::memcpy(&record, payload.data(), sizeof(record));
+    if (ec or not FrameRelay::deserialise(position, payload.data() + payload.size(), FrameRelay::none, geometry)) {
+        errorToConsole("ERROR - Assignment from the coordinator is truncated");
+        return false;
+    }
+
+    const TfmImager::Grid grid = {record.x_min, record.x_max, record.z_min, record.z_max, record.nx, record.nz};
+    const TfmImager::Tile tile = {record.tile_x0, record.tile_z0, record.tile_nx, record.tile_nz};
+    const FrameRelay::Compression compression = (FrameRelay::Compression)record.compression;
+    TfmImager imager(geometry, record.gate_start, grid, tile, n_threads_);
+    if (not imager.valid()) {
+        return false;
+    }
+    logToConsole("Imaging rows " + std::to_string(tile.z0) + " to " + std::to_string(tile.z0 + tile.nz - 1) +
+                 " for " + host_ + ":" + std::to_string(port_));
+
+    PeakHandler::OutputFormat frame;
+    TfmImager::Image image;
+    while (true) {
+        boost::asio::read(socket_, boost::asio::buffer(&header, sizeof(header)), ec);
+        if (ec == boost::asio::error::eof) {
+            logToConsole("Coordinator closed after " + std::to_string(frames_imaged_) + " frames");
+            return true;
+        }
+        if (ec or not validHeader(header, frame_message)) {
+            errorToConsole("ERROR - Stream from the coordinator broke after " + std::to_string(frames_imaged_) + " frames");
+            return false;
+        }
+
+        payload.resize(header.payload_bytes);
+        boost::asio::read(socket_, boost::asio::buffer(payload), ec);
+        position = payload.data();
+        if (ec or not FrameRelay::deserialise(position, payload.data() + payload.size(), compression, frame) or
+                not imager.process(frame, image)) {
+            errorToConsole("ERROR - Unable to image frame " + std::to_string(frame.frame_number));
+            return false;
+        }
+
+        const TileRecord tile_record = {image.frame_number, image.tile.x0, image.tile.z0, image.tile.nx, image.tile.nz};
+        const MessageHeader reply = messageHeader(tile_message, header.sequence, sizeof(tile_record) + image.pixels.size() * sizeof(float));
+        const std::array<boost::asio::const_buffer, 3> message = {
+            boost::asio::buffer(&reply, sizeof(reply)),
+            boost::asio::buffer(&tile_record, sizeof(tile_record)),
+            boost::asio::buffer(image.pixels)
+        };
+        boost::asio::write(socket_, message, ec);
+        if (ec) {
+            errorToConsole("ERROR - Unable to return frame " + std::to_string(frame.frame_number) + ", " + ec.message());
+            return false;
+        }
+        frames_imaged_++;
+    }
+}
@@ -0,0 +1,116 @@
+#include "PeakMicroPulseHandler/frame_queue.h"
+
+#include <chrono>
+#include <utility>
+
+
+
+FrameQueue::FrameQueue(
+        const PeakHandler::OutputFormat& geometry,
+        const size_t& depth)
+    :  pool_(depth),
+       frame_bytes_(frameBytes(geometry)),
+       mutex_(),
+       ready_(),
+       queue_(depth),
+       head_(0),
+       count_(0),
+       dropped_(0)
+{
+    pool_.preallocate([&geometry](PeakHandler::OutputFormat& frame) {
+        frame.ascans.resize(geometry.num_a_scans);
+        for (auto& message : frame.ascans) {
+            message.amps.reserve(geometry.ascan_length);
+        }
+        frame.coupling_failures.reserve(geometry.num_a_scans);
+    });
+}
+
+
+FrameQueue::~FrameQueue() {
+}
+
+
+void FrameQueue::logToConsole(const std::string& message) {
+    std::cout << "FrameQueue :: " << message << std::endl;
+}
+
+
+void FrameQueue::errorToConsole(const std::string& message) {
+    std::cout << "\033[31m";
+    std::cout << "FrameQueue :: " << message << std::endl;
+    std::cout << "\033[0m";
+}
+
+
+size_t FrameQueue::frameBytes(const PeakHandler::OutputFormat& geometry) {
+    return sizeof(PeakHandler::OutputFormat) +
+           (size_t)geometry.num_a_scans * (sizeof(PeakHandler::DofMessage) + geometry.ascan_length * sizeof(short int) + sizeof(int));
+}
+
+
+std::shared_ptr<PeakHandler::OutputFormat> FrameQueue::acquire() {
+    std::shared_ptr<PeakHandler::OutputFormat> buffer = pool_.acquire();
+    if (buffer == nullptr) {
+        ++dropped_;
+    }
+    return buffer;
+}
+
+
+void FrameQueue::enqueue(const std::shared_ptr<PeakHandler::OutputFormat>& buffer) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // Pooled buffers never outnumber the slots, anything else is dropped rather than grown for
+        if (count_ == queue_.size()) {
+            ++dropped_;
+            return;
+        }
+        queue_[(head_ + count_) % queue_.size()] = buffer;
+        count_++;
+    }
+    ready_.notify_one();
+}
+
+
+bool FrameQueue::push(const PeakHandler::OutputFormat& frame) {
+    std::shared_ptr<PeakHandler::OutputFormat> buffer = acquire();
+    if (buffer == nullptr) {
+        return false;
+    }
+
+    // assign keeps the capacity reserved up front as long as the geometry is unchanged
+    PeakHandler::copyFrameMetadata(frame, *buffer);
+    buffer->ascans.resize(frame.ascans.size());
+    for (size_t i = 0; i < frame.ascans.size(); i++) {
+        buffer->ascans[i].header = frame.ascans[i].header;
+        buffer->ascans[i].amps.assign(frame.ascans[i].amps.begin(), frame.ascans[i].amps.end());
+    }
+
+    enqueue(buffer);
+    return true;
+}
+
+
+std::shared_ptr<const PeakHandler::OutputFormat> FrameQueue::pop(const int& timeout_ms/* = -1*/) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto not_empty = [this]() { return count_ > 0; };
+
+    if (timeout_ms < 0) {
+        ready_.wait(lock, not_empty);
+    } else if (not ready_.wait_for(lock, std::chrono::milliseconds(timeout_ms), not_empty)) {
+        return nullptr;
+    }
+
+    // Moved out so the slot does not keep the buffer from going back to the pool
+    std::shared_ptr<PeakHandler::OutputFormat> frame = std::move(queue_[head_]);
+    head_ = (head_ + 1) % queue_.size();
+    count_--;
+    return frame;
+}
+
+
+size_t FrameQueue::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return count_;
+}
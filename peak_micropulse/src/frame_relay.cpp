@@ -0,0 +1,674 @@
+#include "PeakMicroPulseHandler/frame_relay.h"
+
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#include <sys/socket.h>
+
+
+
+namespace {
+    const uint32_t batch_magic = 0x524D5050;                  // "PPMR"
+    const uint32_t fragment_magic = 0x464D5050;               // "PPMF"
+    const uint16_t relay_version = 1;
+    const size_t max_datagram = 60000;                        // bytes, under the 64 kB UDP limit
+    const int flush_ms = 10;                                  // Longest a partial batch waits for more frames
+    const size_t max_batch_bytes = 512u * 1024 * 1024;        // Largest batch sent or accepted
+
+    struct BatchHeader {
+        uint32_t                       magic;
+        uint16_t                       version;
+        uint16_t                       compression;
+        uint32_t                       n_frames;
+        uint32_t                       payload_bytes;
+    };
+
+    // Prefixes each UDP datagram, all but the last carry max_datagram bytes
+    struct FragmentHeader {
+        uint32_t                       magic;
+        uint32_t                       batch;                 // Sequence number of the batch
+        uint16_t                       fragment;
+        uint16_t                       fragments;
+        uint32_t                       batch_bytes;
+    };
+
+    const size_t fragment_payload = max_datagram - sizeof(FragmentHeader);
+
+    struct FrameRecord {
+        int64_t                        frame_number;
+        int32_t                        digitisation_rate;
+        int32_t                        ascan_length;
+        int32_t                        num_a_scans;
+        int32_t                        n_elements;
+        double                         element_pitch;
+        double                         inter_element_spacing;
+        double                         element_width;
+        double                         vel_wedge;
+        double                         vel_couplant;
+        double                         vel_material;
+        double                         wedge_angle;
+        double                         wedge_depth;
+        double                         couplant_depth;
+        double                         specimen_depth;
+        int32_t                        saturated_ascans;
+        int32_t                        coupling_lost;
+        int32_t                        n_failures;            // Followed by as many int32 test numbers
+        int32_t                        n_ascans;              // Followed by as many A-Scans
+    };
+
+    struct AscanRecord {
+        int32_t                        header;
+        int32_t                        count;
+        int32_t                        test_number;
+        int32_t                        dof;
+        int32_t                        channel;
+        int32_t                        sample_offset;
+        int16_t                        min;
+        int16_t                        max;
+        int32_t                        saturated;
+        double                         rms;
+        int32_t                        n_samples;
+        int32_t                        encoded_bytes;         // Followed by the samples
+    };
+
+    template <typename T>
+    void append(std::vector<unsigned char>& batch, const T& value) {
+        const size_t position = batch.size();
+        batch.resize(position + sizeof(T));
+        std::memcpy(&batch[position], &value, sizeof(T));
+    }
+
+    template <typename T>
+    bool take(const unsigned char*& position, const unsigned char* end, T& value) {
+        if ((size_t)(end - position) < sizeof(T)) {
+            return false;
+        }
+        std::memcpy(&value, position, sizeof(T));
+        position += sizeof(T);
+        return true;
+    }
+
+    // At most three bytes a sample as differences of 16 bit samples fit in 17 bits
+    size_t encodeDelta(const short int* samples, const int& n_samples, unsigned char* output) {
+        unsigned char* position = output;
+        int previous = 0;
+        for (int i = 0; i < n_samples; i++) {
+            const int difference = samples[i] - previous;
+            previous = samples[i];
+            uint32_t zigzag = ((uint32_t)difference << 1) ^ (uint32_t)(difference >> 31);
+            while (zigzag >= 0x80) {
+                *position++ = (unsigned char)(zigzag | 0x80);
+                zigzag >>= 7;
+            }
+            *position++ = (unsigned char)zigzag;
+        }
+        return position - output;
+    }
+
+    bool decodeDelta(const unsigned char* input, const size_t& bytes, short int* samples, const int& n_samples) {
+        const unsigned char* position = input;
+        const unsigned char* end = input + bytes;
+        int previous = 0;
+        for (int i = 0; i < n_samples; i++) {
+            uint32_t zigzag = 0;
+            int shift = 0;
+            unsigned char byte;
+            do {
+                if (position == end or shift > 14) {
+                    return false;
+                }
+                byte = *position++;
+                zigzag |= (uint32_t)(byte & 0x7F) << shift;
+                shift += 7;
+            } while (byte & 0x80);
+
+            previous += (int)(zigzag >> 1) ^ -(int)(zigzag & 1);
+            samples[i] = (short int)previous;
+        }
+        return position == end;
+    }
+}
+
+
+
+FrameRelay::FrameRelay(
+        const std::string& host,
+        const int& port,
+        const Transport& transport/* = tcp*/,
+        const Compression& compression/* = none*/,
+        const int& batch_frames/* = 4*/,
+        const size_t& queue_depth/* = 32*/)
+    :  transport_(transport),
+       compression_(compression),
+       batch_frames_(std::max(batch_frames, 1)),
+       io_(),
+       tcp_socket_(io_),
+       udp_socket_(io_),
+       udp_endpoint_(),
+       batch_(),
+       batched_(0),
+       batch_sequence_(0),
+       queue_(PeakHandler::OutputFormat(), queue_depth),
+       connected_(false),
+       running_(false),
+       failed_(false),
+       frames_sent_(0),
+       bytes_sent_(0),
+       sample_bytes_(0),
+       sender_()
+{
+    try {
+        if (transport_ == tcp) {
+            boost::asio::ip::tcp::resolver resolver(io_);
+            boost::asio::connect(tcp_socket_, resolver.resolve(host, std::to_string(port)));
+            tcp_socket_.set_option(boost::asio::ip::tcp::no_delay(true));
+        } else {
+            boost::asio::ip::udp::resolver resolver(io_);
+            udp_endpoint_ = *resolver.resolve(boost::asio::ip::udp::v4(), host, std::to_string(port)).begin();
+            udp_socket_.open(boost::asio::ip::udp::v4());
+            udp_socket_.set_option(boost::asio::socket_base::send_buffer_size(4 * 1024 * 1024));
+        }
+    } catch (const boost::system::system_error& e) {
+        errorToConsole("ERROR - Unable to reach " + host + ":" + std::to_string(port) + ", " + e.what());
+        return;
+    }
+
+    connected_ = true;
+    running_ = true;
+    sender_ = std::thread(&FrameRelay::senderLoop, this);
+    logToConsole(std::string("Relaying to ") + host + ":" + std::to_string(port) + " over " +
+                 (transport_ == tcp ? "TCP" : "UDP") + " in batches of " + std::to_string(batch_frames_) + " frames" +
+                 (compression_ == delta ? ", delta coded" : ""));
+}
+
+
+FrameRelay::~FrameRelay() {
+    close();
+}
+
+
+void FrameRelay::logToConsole(const std::string& message) {
+    std::cout << "FrameRelay :: " << message << std::endl;
+}
+
+
+void FrameRelay::errorToConsole(const std::string& message) {
+    std::cout << "\033[31m";
+    std::cout << "FrameRelay :: " << message << std::endl;
+    std::cout << "\033[0m";
+}
+
+
+bool FrameRelay::push(const PeakHandler::OutputFormat& frame) {
+    if (not running_ or failed_) {
+        return false;
+    }
+    return queue_.push(frame);
+}
+
+
+void FrameRelay::serialise(
+        const PeakHandler::OutputFormat& frame,
+        const Compression& compression,
+        std::vector<unsigned char>& batch) {
+
+    FrameRecord record = {
+        frame.frame_number, frame.digitisation_rate, frame.ascan_length, frame.num_a_scans, frame.n_elements,
+        frame.element_pitch, frame.inter_element_spacing, frame.element_width,
+        frame.vel_wedge, frame.vel_couplant, frame.vel_material,
+        frame.wedge_angle, frame.wedge_depth, frame.couplant_depth, frame.specimen_depth,
+        frame.saturated_ascans, frame.coupling_lost ? 1 : 0,
+        (int32_t)frame.coupling_failures.size(), (int32_t)frame.ascans.size()
+    };
+    append(batch, record);
+    for (const int& test_number : frame.coupling_failures) {
+        append(batch, (int32_t)test_number);
+    }
+
+    for (const auto& message : frame.ascans) {
+        const int n_samples = message.amps.size();
+        const size_t record_position = batch.size();
+        batch.resize(record_position + sizeof(AscanRecord) + 3 * (size_t)n_samples);
+        unsigned char* samples = &batch[record_position + sizeof(AscanRecord)];
+
+        size_t encoded_bytes = n_samples * sizeof(short int);
+        if (compression == delta) {
+            encoded_bytes = encodeDelta(message.amps.data(), n_samples, samples);
+        } else if (n_samples > 0) {
+            std::memcpy(samples, message.amps.data(), encoded_bytes);
+        }
+
+        const PeakHandler::DofMessageHeader& header = message.header;
+        const AscanRecord ascan_record = {
+            (int32_t)header.header, header.count, header.testNo, header.dof, header.channel, header.sample_offset,
+            header.statistics.min, header.statistics.max, header.statistics.saturated, header.statistics.rms,
+            n_samples, (int32_t)encoded_bytes
+        };
+        std::memcpy(&batch[record_position], &ascan_record, sizeof(ascan_record));
+        batch.resize(record_position + sizeof(AscanRecord) + encoded_bytes);
+    }
+}
+
+
+bool FrameRelay::deserialise(
+        const unsigned char*& position,
+        const unsigned char* end,
+        const Compression& compression,
+        PeakHandler::OutputFormat& frame) {
+
+    // Counts come off the wire, so each is checked against the bytes left before anything is sized by it
+    FrameRecord record;
+    if (not take(position, end, record) or record.n_failures < 0 or record.n_ascans < 0 or
+            (long long)record.n_failures * (long long)sizeof(int32_t) > end - position or
+            (long long)record.n_ascans * (long long)sizeof(AscanRecord) > end - position - record.n_failures * (long long)sizeof(int32_t)) {
+        return false;
+    }
+    frame.frame_number = record.frame_number;
+    frame.digitisation_rate = record.digitisation_rate;
+    frame.ascan_length = record.ascan_length;
+    frame.num_a_scans = record.num_a_scans;
+    frame.n_elements = record.n_elements;
+    frame.element_pitch = record.element_pitch;
+    frame.inter_element_spacing = record.inter_element_spacing;
+    frame.element_width = record.element_width;
+    frame.vel_wedge = record.vel_wedge;
+    frame.vel_couplant = record.vel_couplant;
+    frame.vel_material = record.vel_material;
+    frame.wedge_angle = record.wedge_angle;
+    frame.wedge_depth = record.wedge_depth;
+    frame.couplant_depth = record.couplant_depth;
+    frame.specimen_depth = record.specimen_depth;
+    frame.saturated_ascans = record.saturated_ascans;
+    frame.coupling_lost = record.coupling_lost != 0;
+
+    frame.coupling_failures.resize(record.n_failures);
+    for (auto& test_number : frame.coupling_failures) {
+        int32_t value;
+        if (not take(position, end, value)) {
+            return false;
+        }
+        test_number = value;
+    }
+
+    frame.ascans.resize(record.n_ascans);
+    for (auto& message : frame.ascans) {
+        AscanRecord ascan_record;
+        if (not take(position, end, ascan_record) or ascan_record.n_samples < 0 or
+                ascan_record.encoded_bytes < 0 or end - position < ascan_record.encoded_bytes) {
+            return false;
+        }
+        // Raw samples take two bytes each and delta coded ones at least one
+        const long long least_bytes = (long long)ascan_record.n_samples * (compression == delta ? 1 : (long long)sizeof(short int));
+        if (least_bytes > ascan_record.encoded_bytes) {
+            return false;
+        }
+
+        message.header.header = (PeakHandler::DofHeaderByte)ascan_record.header;
+        message.header.count = ascan_record.count;
+        message.header.testNo = ascan_record.test_number;
+        message.header.dof = ascan_record.dof;
+        message.header.channel = ascan_record.channel;
+        message.header.sample_offset = ascan_record.sample_offset;
+        message.header.statistics.min = ascan_record.min;
+        message.header.statistics.max = ascan_record.max;
+        message.header.statistics.saturated = ascan_record.saturated;
+        message.header.statistics.rms = ascan_record.rms;
+
+        // resize keeps the capacity of the pooled buffer once it has grown to the geometry
+        message.amps.resize(ascan_record.n_samples);
+        bool decoded = true;
+        if (compression == delta) {
+            decoded = decodeDelta(position, ascan_record.encoded_bytes, message.amps.data(), ascan_record.n_samples);
+        } else if (ascan_record.encoded_bytes == (long long)ascan_record.n_samples * (long long)sizeof(short int)) {
+            std::memcpy(message.amps.data(), position, ascan_record.encoded_bytes);
+        } else {
+            decoded = false;
+        }
+        if (not decoded) {
+            return false;
+        }
+        position += ascan_record.encoded_bytes;
+    }
+    return true;
+}
+
+
+void FrameRelay::senderLoop() {
+    while (running_ or queue_.size() > 0) {
+        auto frame = queue_.pop(flush_ms);
+        if (frame != nullptr) {
+            if (batched_ == 0) {
+                batch_.resize(sizeof(BatchHeader));
+            }
+            serialise(*frame, compression_, batch_);
+            for (const auto& message : frame->ascans) {
+                sample_bytes_ += message.amps.size() * sizeof(short int);
+            }
+            batched_++;
+        }
+
+        // A partial batch goes once the queue runs dry, so frames never wait long
+        if (batched_ == batch_frames_ or (frame == nullptr and batched_ > 0)) {
+            sendBatch();
+        }
+    }
+
+    if (batched_ > 0) {
+        sendBatch();
+    }
+}
+
+
+bool FrameRelay::sendBatch() {
+    const BatchHeader header = {batch_magic, relay_version, (uint16_t)compression_, (uint32_t)batched_, (uint32_t)(batch_.size() - sizeof(BatchHeader))};
+    std::memcpy(batch_.data(), &header, sizeof(header));
+    const int frames = batched_;
+    batched_ = 0;
+    if (failed_) {
+        return false;
+    }
+
+    if (batch_.size() > max_batch_bytes) {
+        errorToConsole("ERROR - Batch of " + std::to_string(batch_.size()) + " bytes is larger than a receiver accepts, use fewer frames a batch");
+        failed_ = true;
+        return false;
+    }
+
+    boost::system::error_code ec;
+    if (transport_ == tcp) {
+        boost::asio::write(tcp_socket_, boost::asio::buffer(batch_), ec);
+    } else {
+        const size_t fragments = (batch_.size() + fragment_payload - 1) / fragment_payload;
+        if (fragments > 0xFFFF) {
+            errorToConsole("ERROR - Batch of " + std::to_string(batch_.size()) + " bytes is too large for UDP, use fewer frames a batch");
+            failed_ = true;
+            return false;
+        }
+
+        for (size_t fragment = 0; fragment < fragments and not ec; fragment++) {
+            const FragmentHeader fragment_header = {fragment_magic, batch_sequence_, (uint16_t)fragment, (uint16_t)fragments, (uint32_t)batch_.size()};
+            const size_t offset = fragment * fragment_payload;
+            const std::array<boost::asio::const_buffer, 2> datagram = {
+                boost::asio::buffer(&fragment_header, sizeof(fragment_header)),
+                boost::asio::buffer(&batch_[offset], std::min(fragment_payload, batch_.size() - offset))
+            };
+            udp_socket_.send_to(datagram, udp_endpoint_, 0, ec);
+        }
+        batch_sequence_++;
+    }
+
+    if (ec) {
+        errorToConsole("ERROR - Send failed, " + ec.message() + ", no more frames will be relayed");
+        failed_ = true;
+        return false;
+    }
+    frames_sent_ += frames;
+    bytes_sent_ += batch_.size();
+    return true;
+}
+
+
+void FrameRelay::close() {
+    if (sender_.joinable()) {
+        running_ = false;
+        sender_.join();
+        logToConsole("Closed after " + std::to_string(frames_sent_) + " frames, " + std::to_string(dropped()) + " dropped");
+    }
+
+    boost::system::error_code ec;
+    if (tcp_socket_.is_open()) {
+        tcp_socket_.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+        tcp_socket_.close(ec);
+    }
+    if (udp_socket_.is_open()) {
+        udp_socket_.close(ec);
+    }
+    connected_ = false;
+}
+
+
+
+FrameRelayReceiver::FrameRelayReceiver(
+        const int& port/* = 0*/,
+        const FrameRelay::Transport& transport/* = FrameRelay::tcp*/,
+        const size_t& depth/* = 32*/)
+    :  transport_(transport),
+       io_(),
+       acceptor_(io_),
+       tcp_socket_(),
+       udp_socket_(io_),
+       socket_mutex_(),
+       thread_(),
+       running_(false),
+       port_(port),
+       batch_(),
+       queue_(PeakHandler::OutputFormat(), depth),
+       frames_received_(0),
+       batches_lost_(0),
+       bytes_received_(0)
+{
+}
+
+
+FrameRelayReceiver::~FrameRelayReceiver() {
+    stop();
+}
+
+
+void FrameRelayReceiver::logToConsole(const std::string& message) {
+    std::cout << "FrameRelayReceiver :: " << message << std::endl;
+}
+
+
+void FrameRelayReceiver::errorToConsole(const std::string& message) {
+    std::cout << "\033[31m";
+    std::cout << "FrameRelayReceiver :: " << message << std::endl;
+    std::cout << "\033[0m";
+}
+
+
+void FrameRelayReceiver::start() {
+    if (transport_ == FrameRelay::tcp) {
+        using boost::asio::ip::tcp;
+        acceptor_.open(tcp::v4());
+        acceptor_.set_option(tcp::acceptor::reuse_address(true));
+        acceptor_.bind(tcp::endpoint(tcp::v4(), port_));
+        acceptor_.listen();
+        port_ = acceptor_.local_endpoint().port();
+        running_ = true;
+        thread_ = std::thread(&FrameRelayReceiver::serveTcp, this);
+    } else {
+        using boost::asio::ip::udp;
+        udp_socket_.open(udp::v4());
+
+        // Whole batches arrive in bursts of datagrams, the kernel may cap this at net.core.rmem_max
+        udp_socket_.set_option(boost::asio::socket_base::receive_buffer_size(16 * 1024 * 1024));
+        udp_socket_.bind(udp::endpoint(udp::v4(), port_));
+        port_ = udp_socket_.local_endpoint().port();
+        running_ = true;
+        thread_ = std::thread(&FrameRelayReceiver::serveUdp, this);
+    }
+    logToConsole(std::string("Listening on ") + (transport_ == FrameRelay::tcp ? "TCP" : "UDP") + " port " + std::to_string(port_));
+}
+
+
+void FrameRelayReceiver::stop() {
+    if (not running_) {
+        return;
+    }
+    running_ = false;
+
+    // Shutting down the sockets wakes the blocking accept and receive
+    if (transport_ == FrameRelay::tcp) {
+        ::shutdown(acceptor_.native_handle(), SHUT_RDWR);
+        std::lock_guard<std::mutex> lock(socket_mutex_);
+        if (tcp_socket_) {
+            ::shutdown(tcp_socket_->native_handle(), SHUT_RDWR);
+        }
+    } else {
+        ::shutdown(udp_socket_.native_handle(), SHUT_RDWR);
+    }
+
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+
+    boost::system::error_code ec;
+    acceptor_.close(ec);
+    udp_socket_.close(ec);
+    logToConsole("Stopped after " + std::to_string(frames_received_) + " frames, " +
+                 std::to_string(dropped()) + " dropped, " + std::to_string(batches_lost_) + " batches lost");
+}
+
+
+void FrameRelayReceiver::serveTcp() {
+    using boost::asio::ip::tcp;
+
+    while (running_) {
+        std::unique_ptr<tcp::socket> socket(new tcp::socket(io_));
+        boost::system::error_code ec;
+        acceptor_.accept(*socket, ec);
+        if (ec or not running_) {
+            break;
+        }
+        socket->set_option(boost::asio::socket_base::receive_buffer_size(4 * 1024 * 1024), ec);
+
+        {
+            std::lock_guard<std::mutex> lock(socket_mutex_);
+            tcp_socket_ = std::move(socket);
+        }
+
+        while (running_) {
+            BatchHeader header;
+            boost::asio::read(*tcp_socket_, boost::asio::buffer(&header, sizeof(header)), ec);
+            if (ec) {
+                break;
+            }
+            if (header.magic != batch_magic or header.version != relay_version) {
+                errorToConsole("ERROR - Stream is not a frame relay of this version, dropping the connection");
+                batches_lost_++;
+                break;
+            }
+            if (header.payload_bytes > max_batch_bytes - sizeof(header)) {
+                errorToConsole("ERROR - Batch of " + std::to_string(header.payload_bytes) + " bytes is too large, dropping the connection");
+                batches_lost_++;
+                break;
+            }
+
+            batch_.resize(sizeof(header) + header.payload_bytes);
+            std::memcpy(batch_.data(), &header, sizeof(header));
+            boost::asio::read(*tcp_socket_, boost::asio::buffer(&batch_[sizeof(header)], header.payload_bytes), ec);
+            if (ec) {
+                break;
+            }
+            bytes_received_ += batch_.size();
+            unpackBatch(batch_.data(), batch_.size());
+        }
+
+        std::lock_guard<std::mutex> lock(socket_mutex_);
+        tcp_socket_.reset();
+    }
+}
+
+
+void FrameRelayReceiver::serveUdp() {
+    std::vector<unsigned char> datagram(65536);
+    std::vector<char> received;
+    int fragments_received = 0;
+    bool assembling = false;
+    bool started = false;
+    uint32_t batch = 0;
+
+    while (running_) {
+        boost::system::error_code ec;
+        const size_t length = udp_socket_.receive(boost::asio::buffer(datagram), 0, ec);
+        if (not running_) {
+            break;
+        }
+        if (ec or length < sizeof(FragmentHeader)) {
+            continue;
+        }
+
+        FragmentHeader header;
+        std::memcpy(&header, datagram.data(), sizeof(header));
+        const size_t offset = (size_t)header.fragment * fragment_payload;
+        if (header.magic != fragment_magic or header.fragment >= header.fragments or header.batch_bytes > max_batch_bytes or
+                header.fragments != (header.batch_bytes + fragment_payload - 1) / fragment_payload or
+                offset + length - sizeof(header) > header.batch_bytes) {
+            continue;
+        }
+
+        // Late datagrams of batches already given up on are ignored
+        const int32_t batches_ahead = (int32_t)(header.batch - batch);
+        if (started and batches_ahead < 0) {
+            continue;
+        }
+
+        // A datagram of a newer batch means the one assembling lost datagrams, and any
+        // batches between them lost all of theirs
+        if (not started or batches_ahead > 0 or not assembling) {
+            if (assembling) {
+                batches_lost_++;
+            }
+            if (started) {
+                batches_lost_ += std::max(batches_ahead - 1, 0);
+            }
+            started = true;
+            batch = header.batch;
+            assembling = true;
+            fragments_received = 0;
+            received.assign(header.fragments, 0);
+            batch_.resize(header.batch_bytes);
+        }
+
+        // Stray or corrupt datagrams with the batch's number but not its size are ignored
+        if (header.fragments != received.size() or header.batch_bytes != batch_.size()) {
+            continue;
+        }
+
+        if (not received[header.fragment]) {
+            received[header.fragment] = 1;
+            fragments_received++;
+            std::memcpy(&batch_[offset], &datagram[sizeof(header)], length - sizeof(header));
+            bytes_received_ += length;
+        }
+
+        if (fragments_received == header.fragments) {
+            assembling = false;
+            unpackBatch(batch_.data(), batch_.size());
+        }
+    }
+}
+
+
+bool FrameRelayReceiver::unpackBatch(const unsigned char* batch, const size_t& length) {
+    const unsigned char* position = batch;
+    const unsigned char* end = batch + length;
+
+    BatchHeader header;
+    if (not take(position, end, header) or header.magic != batch_magic or header.version != relay_version or
+            header.payload_bytes != length - sizeof(header)) {
+        batches_lost_++;
+        return false;
+    }
+
+    for (uint32_t f = 0; f < header.n_frames; f++) {
+        // A full queue still needs the frame parsed to find the next one
+        std::shared_ptr<PeakHandler::OutputFormat> buffer = queue_.acquire();
+        PeakHandler::OutputFormat discarded;
+        PeakHandler::OutputFormat& frame = buffer != nullptr ? *buffer : discarded;
+
+        if (not FrameRelay::deserialise(position, end, (FrameRelay::Compression)header.compression, frame)) {
+            batches_lost_++;
+            return false;
+        }
+
+        if (buffer != nullptr) {
+            queue_.enqueue(buffer);
+            frames_received_++;
+        }
+    }
+    return true;
+}
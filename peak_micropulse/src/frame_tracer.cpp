@@ -0,0 +1,202 @@
+#include "PeakMicroPulseHandler/frame_tracer.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <unordered_map>
+
+
+
+namespace {
+    std::atomic<unsigned long> next_tracer_id(1);
+
+    // The last buffer this thread used, which saves the lookup in the common case of one tracer
+    struct ThreadCache {
+        unsigned long                  tracer_id = 0;
+        void*                          buffer = nullptr;
+    };
+    thread_local ThreadCache thread_cache;
+
+    // Buffers for threads that record into more than one tracer
+    thread_local std::unordered_map<unsigned long, void*> thread_buffers;
+
+    // Names as JSON strings, thread names being free text that may hold quotes, backslashes or control characters
+    void writeJsonString(std::ostream& stream, const char* text) {
+        stream << '"';
+        for (const char* c = text; *c != '\0'; c++) {
+            const unsigned char character = *c;
+            if (character == '"' or character == '\\') {
+                stream << '\\' << *c;
+            } else if (character < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", character);
+                stream << escaped;
+            } else {
+                stream << *c;
+            }
+        }
+        stream << '"';
+    }
+}
+
+
+FrameTracer::FrameTracer(const size_t& spans_per_thread/* = 65536*/)
+    :  id_(next_tracer_id++),
+       spans_per_thread_(std::max<size_t>(spans_per_thread, 1)),
+       enabled_(true),
+       epoch_(now()),
+       buffers_mutex_(),
+       buffers_()
+{
+}
+
+
+FrameTracer::~FrameTracer() {
+}
+
+
+void FrameTracer::logToConsole(const std::string& message) {
+    std::cout << "FrameTracer :: " << message << std::endl;
+}
+
+
+void FrameTracer::errorToConsole(const std::string& message) {
+    std::cout << "\033[31m";
+    std::cout << "FrameTracer :: " << message << std::endl;
+    std::cout << "\033[0m";
+}
+
+
+long long FrameTracer::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+void FrameTracer::setEnabled(const bool& enabled) {
+    enabled_.store(enabled, std::memory_order_relaxed);
+}
+
+
+FrameTracer::ThreadBuffer* FrameTracer::threadBuffer() {
+    if (thread_cache.tracer_id == id_) {
+        return static_cast<ThreadBuffer*>(thread_cache.buffer);
+    }
+
+    ThreadBuffer* buffer;
+    auto found = thread_buffers.find(id_);
+    if (found != thread_buffers.end()) {
+        buffer = static_cast<ThreadBuffer*>(found->second);
+    } else {
+        std::lock_guard<std::mutex> lock(buffers_mutex_);
+        buffers_.emplace_back(new ThreadBuffer());
+        buffer = buffers_.back().get();
+        buffer->spans.resize(spans_per_thread_);
+        buffer->head.store(0);
+        buffer->tid = buffers_.size();
+        buffer->name = "Thread " + std::to_string(buffer->tid);
+        thread_buffers[id_] = buffer;
+    }
+
+    thread_cache.tracer_id = id_;
+    thread_cache.buffer = buffer;
+    return buffer;
+}
+
+
+void FrameTracer::setThreadName(const std::string& name) {
+    ThreadBuffer* buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(buffers_mutex_);
+    buffer->name = name;
+}
+
+
+long long FrameTracer::span(const char* name, const long& frame, const long long& start, const long long& end) {
+    if (not enabled()) {
+        return end;
+    }
+
+    // Single writer per buffer, the head is published after the span is written
+    ThreadBuffer* buffer = threadBuffer();
+    const unsigned long head = buffer->head.load(std::memory_order_relaxed);
+    buffer->spans[head % spans_per_thread_] = {name, frame, start, end};
+    buffer->head.store(head + 1, std::memory_order_release);
+
+    return end;
+}
+
+
+long long FrameTracer::span(const char* name, const long& frame, const long long& start) {
+    return span(name, frame, start, now());
+}
+
+
+long FrameTracer::overwritten() const {
+    std::lock_guard<std::mutex> lock(buffers_mutex_);
+    long overwritten = 0;
+    for (const auto& buffer : buffers_) {
+        const unsigned long head = buffer->head.load(std::memory_order_acquire);
+        if (head > spans_per_thread_) {
+            overwritten += head - spans_per_thread_;
+        }
+    }
+    return overwritten;
+}
+
+
+void FrameTracer::clear() {
+    std::lock_guard<std::mutex> lock(buffers_mutex_);
+    for (auto& buffer : buffers_) {
+        buffer->head.store(0, std::memory_order_release);
+    }
+    epoch_ = now();
+}
+
+
+void FrameTracer::writeChromeTrace(std::ostream& stream) const {
+    std::lock_guard<std::mutex> lock(buffers_mutex_);
+
+    // Complete events ("X") with timestamps in us, one track per recording thread
+    stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    stream << std::fixed << std::setprecision(3);
+
+    bool first = true;
+    for (const auto& buffer : buffers_) {
+        stream << (first ? "" : ",\n")
+               << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid
+               << ",\"args\":{\"name\":";
+        writeJsonString(stream, buffer->name.c_str());
+        stream << "}}";
+        first = false;
+
+        const unsigned long head = buffer->head.load(std::memory_order_acquire);
+        const unsigned long begin = head > spans_per_thread_ ? head - spans_per_thread_ : 0;
+
+        for (unsigned long i = begin; i < head; i++) {
+            const Span& span = buffer->spans[i % spans_per_thread_];
+            stream << ",\n{\"name\":";
+            writeJsonString(stream, span.name);
+            stream << ",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid
+                   << ",\"ts\":" << (span.start - epoch_) / 1000.0
+                   << ",\"dur\":" << (span.end - span.start) / 1000.0
+                   << ",\"args\":{\"frame\":" << span.frame << "}}";
+        }
+    }
+
+    stream << "\n]}\n";
+}
+
+
+bool FrameTracer::writeChromeTrace(const std::string& path) const {
+    std::ofstream file(path);
+    if (not file.is_open()) {
+        std::cout << "\033[31m" << "FrameTracer :: ERROR - Could not open " << path << "\033[0m" << std::endl;
+        return false;
+    }
+
+    writeChromeTrace(file);
+    return file.good();
+}
@@ -0,0 +1,281 @@
+#include "PeakMicroPulseHandler/hdf5_writer.h"
+
+#include <algorithm>
+
+
+
+Hdf5Writer::Hdf5Writer(
+        const std::string& path,
+        const PeakHandler::OutputFormat& geometry,
+        const std::vector<std::string>& mps_commands,
+        const int& chunk_frames/* = 16*/,
+        const int& compression_level/* = 0*/,
+        const size_t& queue_depth/* = 32*/)
+    :  num_a_scans_(std::max(geometry.num_a_scans, 1)),
+       ascan_length_(std::max(geometry.ascan_length, 1)),
+       chunk_frames_(std::max(chunk_frames, 1)),
+       compression_level_(std::min(std::max(compression_level, 0), 9)),
+       file_(-1),
+       ascans_(-1),
+       frame_numbers_(-1),
+       test_numbers_(-1),
+       channels_(-1),
+       saturated_ascans_(-1),
+       coupling_lost_(-1),
+       staged_amps_((size_t)chunk_frames_ * num_a_scans_ * ascan_length_),
+       staged_frame_numbers_(chunk_frames_),
+       staged_test_numbers_((size_t)chunk_frames_ * num_a_scans_),
+       staged_channels_((size_t)chunk_frames_ * num_a_scans_),
+       staged_saturated_(chunk_frames_),
+       staged_coupling_lost_(chunk_frames_),
+       staged_(0),
+       rows_written_(0),
+       queue_(geometry, queue_depth),
+       running_(false),
+       failed_(false),
+       written_(0),
+       writer_()
+{
+    if (compression_level_ > 0 and H5Zfilter_avail(H5Z_FILTER_DEFLATE) <= 0) {
+        errorToConsole("ERROR - Deflate is not available in this HDF5 build, writing uncompressed");
+        compression_level_ = 0;
+    }
+
+    file_ = H5Fcreate(path.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+    if (file_ < 0) {
+        errorToConsole("ERROR - Unable to create " + path);
+        return;
+    }
+
+    // Chunks of about 1 MB, spanning a block of frames and as many A-Scans as fit
+    const int chunk_rows = std::min(std::max((1 << 20) / (chunk_frames_ * ascan_length_ * (int)sizeof(short int)), 1), num_a_scans_);
+    const hsize_t ascan_chunk[3] = {(hsize_t)chunk_frames_, (hsize_t)chunk_rows, (hsize_t)ascan_length_};
+    const hsize_t header_chunk[2] = {(hsize_t)chunk_frames_, (hsize_t)num_a_scans_};
+    const hsize_t frame_chunk[1] = {(hsize_t)chunk_frames_};
+
+    ascans_ = createDataset("ascans", H5T_NATIVE_SHORT, 3, ascan_chunk, true);
+    frame_numbers_ = createDataset("frame_number", H5T_NATIVE_INT64, 1, frame_chunk, false);
+    test_numbers_ = createDataset("test_numbers", H5T_NATIVE_INT, 2, header_chunk, true);
+    channels_ = createDataset("channels", H5T_NATIVE_INT, 2, header_chunk, true);
+    saturated_ascans_ = createDataset("saturated_ascans", H5T_NATIVE_INT, 1, frame_chunk, false);
+    coupling_lost_ = createDataset("coupling_lost", H5T_NATIVE_UCHAR, 1, frame_chunk, false);
+    writeAttributes(geometry, mps_commands);
+
+    if (not good()) {
+        errorToConsole("ERROR - Unable to set up datasets in " + path);
+        return;
+    }
+
+    logToConsole("Writing to " + path + " in chunks of " + std::to_string(chunk_frames_) + " frames x " +
+                 std::to_string(chunk_rows) + " A-Scans" +
+                 (compression_level_ > 0 ? ", deflate level " + std::to_string(compression_level_) : ""));
+    running_ = true;
+    writer_ = std::thread(&Hdf5Writer::writerLoop, this);
+}
+
+
+Hdf5Writer::~Hdf5Writer() {
+    close();
+}
+
+
+void Hdf5Writer::logToConsole(const std::string& message) {
+    std::cout << "Hdf5Writer :: " << message << std::endl;
+}
+
+
+void Hdf5Writer::errorToConsole(const std::string& message) {
+    std::cout << "\033[31m";
+    std::cout << "Hdf5Writer :: " << message << std::endl;
+    std::cout << "\033[0m";
+}
+
+
+hid_t Hdf5Writer::createDataset(const char* name, const hid_t& type, const int& rank, const hsize_t* chunk, const bool& compress) {
+    const hsize_t dims[3] = {0, (hsize_t)num_a_scans_, (hsize_t)ascan_length_};
+    const hsize_t max_dims[3] = {H5S_UNLIMITED, (hsize_t)num_a_scans_, (hsize_t)ascan_length_};
+
+    const hid_t space = H5Screate_simple(rank, dims, max_dims);
+    const hid_t properties = H5Pcreate(H5P_DATASET_CREATE);
+    H5Pset_chunk(properties, rank, chunk);
+    if (compress and compression_level_ > 0) {
+        // Shuffling the bytes of each sample first lets deflate find the slowly varying high bytes
+        H5Pset_shuffle(properties);
+        H5Pset_deflate(properties, compression_level_);
+    }
+
+    const hid_t dataset = H5Dcreate2(file_, name, type, space, H5P_DEFAULT, properties, H5P_DEFAULT);
+    H5Pclose(properties);
+    H5Sclose(space);
+
+    if (dataset < 0) {
+        failed_ = true;
+    }
+    return dataset;
+}
+
+
+void Hdf5Writer::writeAttributes(const PeakHandler::OutputFormat& geometry, const std::vector<std::string>& mps_commands) {
+    auto attribute = [this](const char* name, const hid_t& type, const void* value) {
+        const hid_t space = H5Screate(H5S_SCALAR);
+        const hid_t handle = H5Acreate2(file_, name, type, space, H5P_DEFAULT, H5P_DEFAULT);
+        if (handle < 0 or H5Awrite(handle, type, value) < 0) {
+            failed_ = true;
+        }
+        if (handle >= 0) {
+            H5Aclose(handle);
+        }
+        H5Sclose(space);
+    };
+
+    attribute("digitisation_rate", H5T_NATIVE_INT, &geometry.digitisation_rate);       // MHz
+    attribute("ascan_length", H5T_NATIVE_INT, &geometry.ascan_length);
+    attribute("num_a_scans", H5T_NATIVE_INT, &geometry.num_a_scans);
+    attribute("n_elements", H5T_NATIVE_INT, &geometry.n_elements);
+    attribute("element_pitch", H5T_NATIVE_DOUBLE, &geometry.element_pitch);             // mm
+    attribute("inter_element_spacing", H5T_NATIVE_DOUBLE, &geometry.inter_element_spacing);
+    attribute("element_width", H5T_NATIVE_DOUBLE, &geometry.element_width);
+    attribute("vel_wedge", H5T_NATIVE_DOUBLE, &geometry.vel_wedge);                     // m/s
+    attribute("vel_couplant", H5T_NATIVE_DOUBLE, &geometry.vel_couplant);
+    attribute("vel_material", H5T_NATIVE_DOUBLE, &geometry.vel_material);
+    attribute("wedge_angle", H5T_NATIVE_DOUBLE, &geometry.wedge_angle);                 // degrees
+    attribute("wedge_depth", H5T_NATIVE_DOUBLE, &geometry.wedge_depth);                 // mm
+    attribute("couplant_depth", H5T_NATIVE_DOUBLE, &geometry.couplant_depth);
+    attribute("specimen_depth", H5T_NATIVE_DOUBLE, &geometry.specimen_depth);
+
+    // The MPS commands as sent, one per line
+    std::string mps;
+    for (const auto& command : mps_commands) {
+        mps += command + "\n";
+    }
+    const hid_t string_type = H5Tcopy(H5T_C_S1);
+    H5Tset_size(string_type, mps.size() + 1);
+    H5Tset_strpad(string_type, H5T_STR_NULLTERM);
+    attribute("mps", string_type, mps.c_str());
+    H5Tclose(string_type);
+}
+
+
+bool Hdf5Writer::push(const PeakHandler::OutputFormat& frame) {
+    if (not running_) {
+        return false;
+    }
+    return queue_.push(frame);
+}
+
+
+void Hdf5Writer::writerLoop() {
+    while (running_ or queue_.size() > 0) {
+        auto frame = queue_.pop(100);
+        if (frame == nullptr) {
+            continue;
+        }
+
+        stage(*frame);
+        if (staged_ == chunk_frames_) {
+            flush();
+        }
+    }
+    flush();
+}
+
+
+void Hdf5Writer::stage(const PeakHandler::OutputFormat& frame) {
+    const size_t frame_offset = (size_t)staged_ * num_a_scans_;
+    short int* amps = &staged_amps_[frame_offset * ascan_length_];
+    std::fill(amps, amps + (size_t)num_a_scans_ * ascan_length_, 0);
+
+    const int n_ascans = std::min((int)frame.ascans.size(), num_a_scans_);
+    for (int i = 0; i < n_ascans; i++) {
+        const PeakHandler::DofMessage& message = frame.ascans[i];
+
+        // Cropped A-Scans keep their place relative to gate start
+        const int offset = std::min(std::max(message.header.sample_offset, 0), ascan_length_);
+        const int length = std::min((int)message.amps.size(), ascan_length_ - offset);
+        std::copy(message.amps.begin(), message.amps.begin() + length, amps + (size_t)i * ascan_length_ + offset);
+
+        staged_test_numbers_[frame_offset + i] = message.header.testNo;
+        staged_channels_[frame_offset + i] = message.header.channel;
+    }
+    for (int i = n_ascans; i < num_a_scans_; i++) {
+        staged_test_numbers_[frame_offset + i] = -1;
+        staged_channels_[frame_offset + i] = -1;
+    }
+
+    staged_frame_numbers_[staged_] = frame.frame_number;
+    staged_saturated_[staged_] = frame.saturated_ascans;
+    staged_coupling_lost_[staged_] = frame.coupling_lost ? 1 : 0;
+    staged_++;
+}
+
+
+bool Hdf5Writer::appendRows(const hid_t& dataset, const hid_t& type, const int& rank, const void* data) {
+    const hsize_t extent[3] = {rows_written_ + staged_, (hsize_t)num_a_scans_, (hsize_t)ascan_length_};
+    const hsize_t start[3] = {rows_written_, 0, 0};
+    const hsize_t count[3] = {(hsize_t)staged_, (hsize_t)num_a_scans_, (hsize_t)ascan_length_};
+
+    if (H5Dset_extent(dataset, extent) < 0) {
+        return false;
+    }
+    const hid_t file_space = H5Dget_space(dataset);
+    const hid_t memory_space = H5Screate_simple(rank, count, nullptr);
+    H5Sselect_hyperslab(file_space, H5S_SELECT_SET, start, nullptr, count, nullptr);
+    const herr_t status = H5Dwrite(dataset, type, memory_space, file_space, H5P_DEFAULT, data);
+    H5Sclose(memory_space);
+    H5Sclose(file_space);
+    return status >= 0;
+}
+
+
+void Hdf5Writer::flush() {
+    if (staged_ == 0 or failed_) {
+        staged_ = 0;
+        return;
+    }
+
+    const bool appended =
+        appendRows(ascans_, H5T_NATIVE_SHORT, 3, staged_amps_.data()) and
+        appendRows(frame_numbers_, H5T_NATIVE_INT64, 1, staged_frame_numbers_.data()) and
+        appendRows(test_numbers_, H5T_NATIVE_INT, 2, staged_test_numbers_.data()) and
+        appendRows(channels_, H5T_NATIVE_INT, 2, staged_channels_.data()) and
+        appendRows(saturated_ascans_, H5T_NATIVE_INT, 1, staged_saturated_.data()) and
+        appendRows(coupling_lost_, H5T_NATIVE_UCHAR, 1, staged_coupling_lost_.data());
+
+    if (not appended) {
+        errorToConsole("ERROR - Write failed after " + std::to_string(rows_written_) + " frames, the rest are discarded");
+        failed_ = true;
+    } else {
+        rows_written_ += staged_;
+        written_ += staged_;
+    }
+    staged_ = 0;
+}
+
+
+void Hdf5Writer::close() {
+    if (writer_.joinable()) {
+        running_ = false;
+        writer_.join();
+    }
+
+    for (hid_t* dataset : {&ascans_, &frame_numbers_, &test_numbers_, &channels_, &saturated_ascans_, &coupling_lost_}) {
+        if (*dataset >= 0) {
+            H5Dclose(*dataset);
+            *dataset = -1;
+        }
+    }
+    if (file_ >= 0) {
+        H5Fclose(file_);
+        file_ = -1;
+        logToConsole("Closed after " + std::to_string(written_) + " frames, " + std::to_string(dropped()) + " dropped");
+    }
+}
+
+
+size_t Hdf5Writer::footprint() const {
+    return queue_.footprint() +
+           staged_amps_.capacity() * sizeof(short int) +
+           staged_frame_numbers_.capacity() * sizeof(int64_t) +
+           (staged_test_numbers_.capacity() + staged_channels_.capacity() + staged_saturated_.capacity()) * sizeof(int) +
+           staged_coupling_lost_.capacity();
+}
@@ -0,0 +1,118 @@
+#include "PeakMicroPulseHandler/huge_page_buffer.h"
+
+#include <fstream>
+#include <sys/mman.h>
+
+
+
+namespace {
+    size_t roundUp(const size_t& bytes, const size_t& multiple) {
+        return (bytes + multiple - 1) / multiple * multiple;
+    }
+
+    // madvise succeeds even when transparent huge pages are switched off
+    bool transparentHugePagesEnabled() {
+        std::ifstream file("/sys/kernel/mm/transparent_hugepage/enabled");
+        std::string setting;
+        std::getline(file, setting);
+        return not setting.empty() and setting.find("[never]") == std::string::npos;
+    }
+}
+
+
+const size_t HugePageRegion::huge_page_size;
+
+
+HugePageRegion::HugePageRegion(const bool& use_huge_pages/* = true*/)
+    :  use_huge_pages_(use_huge_pages),
+       data_(nullptr),
+       capacity_(0),
+       mapped_(0),
+       backing_(none)
+{
+}
+
+
+HugePageRegion::~HugePageRegion() {
+    release();
+}
+
+
+std::string HugePageRegion::backingName(const Backing& backing) {
+    switch (backing) {
+        case hugetlbfs:     return "hugetlbfs";
+        case transparent:   return "transparent huge pages";
+        case standard:      return "standard pages";
+        default:            return "none";
+    }
+}
+
+
+void HugePageRegion::release() {
+    if (data_ != nullptr) {
+        munmap(data_, mapped_);
+    }
+    data_ = nullptr;
+    capacity_ = 0;
+    mapped_ = 0;
+    backing_ = none;
+}
+
+
+void HugePageRegion::allocate(const size_t& bytes) {
+    release();
+    if (bytes == 0) {
+        return;
+    }
+
+    if (use_huge_pages_) {
+        const size_t length = roundUp(bytes, huge_page_size);
+
+#ifdef MAP_HUGETLB
+        void* pool = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (pool != MAP_FAILED) {
+            data_ = pool;
+            capacity_ = length;
+            mapped_ = length;
+            backing_ = hugetlbfs;
+            return;
+        }
+#endif
+
+        // Over-map so the region can start on a 2 MB boundary, which the kernel needs to back it with huge pages
+        const size_t over_length = length + huge_page_size;
+        void* mapping = mmap(nullptr, over_length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapping != MAP_FAILED) {
+            char* start = static_cast<char*>(mapping);
+            char* aligned = reinterpret_cast<char*>(roundUp(reinterpret_cast<size_t>(start), huge_page_size));
+            if (aligned > start) {
+                munmap(start, aligned - start);
+            }
+            const size_t tail = (start + over_length) - (aligned + length);
+            if (tail > 0) {
+                munmap(aligned + length, tail);
+            }
+
+            data_ = aligned;
+            capacity_ = length;
+            mapped_ = length;
+            backing_ = standard;
+#ifdef MADV_HUGEPAGE
+            if (madvise(data_, length, MADV_HUGEPAGE) == 0 and transparentHugePagesEnabled()) {
+                backing_ = transparent;
+            }
+#endif
+            return;
+        }
+    }
+
+    const size_t length = roundUp(bytes, 4096);
+    void* mapping = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+    data_ = mapping;
+    capacity_ = length;
+    mapped_ = length;
+    backing_ = standard;
+}
@@ -0,0 +1,300 @@
+#include "PeakMicroPulseHandler/indication_detector.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+
+
+
+namespace {
+
+IndicationDetector::Indication emptyIndication() {
+    IndicationDetector::Indication indication;
+    indication.id = -1;
+    indication.first_row = INT_MAX;
+    indication.last_row = INT_MIN;
+    indication.min_column = INT_MAX;
+    indication.max_column = INT_MIN;
+    indication.pixels = 0;
+    indication.peak_amplitude = -1.0f;
+    indication.peak_db = 0.0;
+    indication.peak_row = -1;
+    indication.peak_column = -1;
+    return indication;
+}
+
+
+void mergeIndication(IndicationDetector::Indication& into, const IndicationDetector::Indication& from) {
+    into.first_row = std::min(into.first_row, from.first_row);
+    into.last_row = std::max(into.last_row, from.last_row);
+    into.min_column = std::min(into.min_column, from.min_column);
+    into.max_column = std::max(into.max_column, from.max_column);
+    into.pixels += from.pixels;
+
+    if (from.peak_amplitude > into.peak_amplitude) {
+        into.peak_amplitude = from.peak_amplitude;
+        into.peak_row = from.peak_row;
+        into.peak_column = from.peak_column;
+    }
+}
+
+}
+
+
+IndicationDetector::RowLabeller::RowLabeller()
+    :  previous_runs_(), current_runs_(),
+       active_(), next_active_(),
+       parent_(), remap_(),
+       row_(0)
+{
+}
+
+
+void IndicationDetector::RowLabeller::reset() {
+    previous_runs_.clear();
+    current_runs_.clear();
+    active_.clear();
+    next_active_.clear();
+    row_ = 0;
+}
+
+
+int IndicationDetector::RowLabeller::find(const int& i) {
+    int root = i;
+    while (parent_[root] != root) {
+        root = parent_[root];
+    }
+    // Path compression
+    int j = i;
+    while (parent_[j] != root) {
+        int next = parent_[j];
+        parent_[j] = root;
+        j = next;
+    }
+    return root;
+}
+
+
+void IndicationDetector::RowLabeller::addRow(
+        const float* row,
+        const int& width,
+        const float& threshold,
+        std::vector<Indication>& closed) {
+
+    // Runs of exceeding pixels in this row
+    current_runs_.clear();
+    for (int c = 0; c < width; c++) {
+        if (row[c] >= threshold) {
+            int start = c;
+            while (c + 1 < width and row[c + 1] >= threshold) {
+                c++;
+            }
+            current_runs_.push_back({start, c, -1});
+        }
+    }
+
+    // Union the components of the previous row that each run touches (8-connected)
+    const int n_previous = active_.size();
+    parent_.resize(n_previous);
+    for (int i = 0; i < n_previous; i++) {
+        parent_[i] = i;
+    }
+
+    size_t p = 0;
+    for (auto& run : current_runs_) {
+        while (p < previous_runs_.size() and previous_runs_[p].end < run.start - 1) {
+            p++;
+        }
+
+        for (size_t q = p; q < previous_runs_.size() and previous_runs_[q].start <= run.end + 1; q++) {
+            int a = find(previous_runs_[q].component);
+            if (run.component == -1) {
+                run.component = a;
+            } else {
+                int b = find(run.component);
+                if (a != b) {
+                    parent_[b] = a;
+                }
+            }
+        }
+    }
+
+    // One component per group of touched components, or a new one per isolated run
+    next_active_.clear();
+    remap_.assign(n_previous, -1);
+
+    for (auto& run : current_runs_) {
+        int target;
+        if (run.component == -1) {
+            target = next_active_.size();
+            next_active_.push_back(emptyIndication());
+        } else {
+            int root = find(run.component);
+            if (remap_[root] == -1) {
+                remap_[root] = next_active_.size();
+                next_active_.push_back(emptyIndication());
+            }
+            target = remap_[root];
+        }
+        run.component = target;
+
+        Indication& indication = next_active_[target];
+        indication.first_row = std::min(indication.first_row, row_);
+        indication.last_row = std::max(indication.last_row, row_);
+        indication.min_column = std::min(indication.min_column, run.start);
+        indication.max_column = std::max(indication.max_column, run.end);
+        indication.pixels += run.end - run.start + 1;
+
+        for (int c = run.start; c <= run.end; c++) {
+            if (row[c] > indication.peak_amplitude) {
+                indication.peak_amplitude = row[c];
+                indication.peak_row = row_;
+                indication.peak_column = c;
+            }
+        }
+    }
+
+    // Components not continued by this row are complete
+    for (int i = 0; i < n_previous; i++) {
+        int root = find(i);
+        if (remap_[root] == -1) {
+            closed.push_back(active_[i]);
+        } else {
+            mergeIndication(next_active_[remap_[root]], active_[i]);
+        }
+    }
+
+    active_.swap(next_active_);
+    previous_runs_.swap(current_runs_);
+    row_++;
+}
+
+
+void IndicationDetector::RowLabeller::close(std::vector<Indication>& closed) {
+    closed.insert(closed.end(), active_.begin(), active_.end());
+    active_.clear();
+    previous_runs_.clear();
+}
+
+
+IndicationDetector::IndicationDetector(
+        const double& reference_amplitude,
+        const double& threshold_db/* = -6.0*/,
+        const int& min_pixels/* = 1*/)
+    :  reference_amplitude_(reference_amplitude),
+       threshold_db_(threshold_db),
+       threshold_((float)(reference_amplitude * std::pow(10.0, threshold_db / 20.0))),
+       min_pixels_(min_pixels),
+       gate_start_(0),
+       gate_end_(0),
+       next_id_(0),
+       callback_(),
+       cscan_labeller_(),
+       image_labeller_(),
+       closed_(),
+       indications_(),
+       gated_peaks_()
+{
+}
+
+
+IndicationDetector::~IndicationDetector() {
+}
+
+
+void IndicationDetector::setGate(const int& gate_start, const int& gate_end) {
+    gate_start_ = gate_start;
+    gate_end_ = gate_end;
+}
+
+
+void IndicationDetector::setIndicationCallback(const std::function<void(const Indication&)>& callback) {
+    callback_ = callback;
+}
+
+
+void IndicationDetector::emit(std::vector<Indication>& closed, std::vector<Indication>* output) {
+    for (auto& indication : closed) {
+        if (indication.pixels < min_pixels_) {
+            continue;
+        }
+
+        indication.id = next_id_++;
+        indication.peak_db = 20.0 * std::log10(std::max((double)indication.peak_amplitude, 1e-12) / reference_amplitude_);
+
+        if (output != nullptr) {
+            output->push_back(indication);
+        } else {
+            indications_.push_back(indication);
+        }
+
+        if (callback_) {
+            callback_(indication);
+        }
+    }
+    closed.clear();
+}
+
+
+void IndicationDetector::processFrame(const PeakHandler::OutputFormat& frame) {
+    // Gated peak of each A-Scan gives one C-Scan row per frame
+    gated_peaks_.resize(frame.ascans.size());
+
+    for (size_t i = 0; i < frame.ascans.size(); i++) {
+        const std::vector<short int>& amps = frame.ascans[i].amps;
+        const int offset = frame.ascans[i].header.sample_offset;
+        int start = std::max(gate_start_ - offset, 0);
+        int end = gate_end_ > gate_start_ ? std::min(gate_end_ - offset, (int)amps.size()) : (int)amps.size();
+
+        // Magnitude about the centre of the DOF, DOF 1 samples sitting on a 128 offset
+        const int centre = PeakHandler::sampleOffset(frame.ascans[i].header.dof);
+        int peak = 0;
+        for (int j = start; j < end; j++) {
+            peak = std::max(peak, std::abs(amps[j] - centre));
+        }
+        gated_peaks_[i] = (float)peak;
+    }
+
+    processRow(gated_peaks_.data(), gated_peaks_.size());
+}
+
+
+void IndicationDetector::processRow(const float* row, const int& width) {
+    cscan_labeller_.addRow(row, width, threshold_, closed_);
+    emit(closed_, nullptr);
+}
+
+
+std::vector<IndicationDetector::Indication> IndicationDetector::processImage(
+        const float* image,
+        const int& width,
+        const int& height) {
+
+    std::vector<Indication> result;
+
+    image_labeller_.reset();
+    for (int r = 0; r < height; r++) {
+        image_labeller_.addRow(image + (size_t)r * width, width, threshold_, closed_);
+    }
+    image_labeller_.close(closed_);
+    emit(closed_, &result);
+
+    return result;
+}
+
+
+void IndicationDetector::flush() {
+    cscan_labeller_.close(closed_);
+    emit(closed_, nullptr);
+}
+
+
+std::vector<IndicationDetector::Indication> IndicationDetector::openIndications() const {
+    std::vector<Indication> open;
+    for (auto indication : cscan_labeller_.active()) {
+        indication.peak_db = 20.0 * std::log10(std::max((double)indication.peak_amplitude, 1e-12) / reference_amplitude_);
+        open.push_back(indication);
+    }
+    return open;
+}
@@ -0,0 +1,133 @@
+#include "PeakMicroPulseHandler/layered_medium.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+
+namespace {
+    const size_t max_stack_path = 8;                          // Layers and specimen segments
+}
+
+
+
+LayeredMedium::LayeredMedium(const PeakHandler::OutputFormat& geometry)
+    :  n_elements_(geometry.n_elements),
+       pitch_(geometry.element_pitch),
+       material_velocity_(geometry.vel_material / 1000.0),
+       specimen_depth_(geometry.specimen_depth),
+       layers_()
+{
+    if (geometry.wedge_depth > 0.0 and geometry.vel_wedge > 0.0) {
+        layers_.push_back({geometry.wedge_depth, geometry.vel_wedge / 1000.0});
+    }
+    if (geometry.couplant_depth > 0.0 and geometry.vel_couplant > 0.0) {
+        layers_.push_back({geometry.couplant_depth, geometry.vel_couplant / 1000.0});
+    }
+}
+
+
+double LayeredMedium::elementPosition(const double& element) const {
+    return (element - 0.5 * (n_elements_ - 1)) * pitch_;
+}
+
+
+double LayeredMedium::surfaceTime() const {
+    double time = 0.0;
+    for (const auto& layer : layers_) {
+        time += layer.thickness / layer.velocity;
+    }
+    return time;
+}
+
+
+double LayeredMedium::travelTime(const double& dx, const double& depth) const {
+    const Layer specimen = {depth, material_velocity_};
+    return travelTime(dx, &specimen, depth > 0.0 ? 1 : 0);
+}
+
+
+double LayeredMedium::travelTime(const double& dx, const Layer* segments, const int& n_segments) const {
+    // Layers the ray crosses, then the segments in the specimen down to the point. The ray
+    // parameter holds across every interface, the backwall and any change of wave included.
+    // On the stack for the usual few, so only unusually long paths allocate
+    Layer stack_path[max_stack_path];
+    std::vector<Layer> heap_path;
+    Layer* path = stack_path;
+    const size_t path_length = layers_.size() + std::max(n_segments, 0);
+    if (path_length > max_stack_path) {
+        heap_path.resize(path_length);
+        path = heap_path.data();
+    }
+
+    int n = 0;
+    for (const auto& layer : layers_) {
+        path[n++] = layer;
+    }
+    for (int i = 0; i < n_segments; i++) {
+        if (segments[i].thickness > 0.0) {
+            path[n++] = segments[i];
+        }
+    }
+
+    if (n == 0) {
+        return std::fabs(dx) / (n_segments > 0 ? segments[n_segments - 1].velocity : material_velocity_);
+    }
+
+    double v_max = 0.0;
+    for (int i = 0; i < n; i++) {
+        v_max = std::max(v_max, path[i].velocity);
+    }
+
+    const double offset = std::fabs(dx);
+
+    // Solve for the ray parameter, as q = p * v_max in [0, 1), giving the horizontal offset
+    double lo = 0.0;
+    double hi = 1.0;
+    double q = 0.0;
+
+    if (offset > 1e-9) {
+        double total_thickness = 0.0;
+        for (int i = 0; i < n; i++) {
+            total_thickness += path[i].thickness;
+        }
+        q = std::min(0.99, offset / std::sqrt(offset * offset + total_thickness * total_thickness));
+
+        for (int iteration = 0; iteration < 50; iteration++) {
+            double x = 0.0;
+            double dxdq = 0.0;
+            for (int i = 0; i < n; i++) {
+                const double ratio = path[i].velocity / v_max;
+                const double s = q * ratio;
+                const double c = std::sqrt(1.0 - s * s);
+                x += path[i].thickness * s / c;
+                dxdq += path[i].thickness * ratio / (c * c * c);
+            }
+
+            const double error = x - offset;
+            if (std::fabs(error) < 1e-7) {
+                break;
+            }
+
+            if (error > 0.0) {
+                hi = q;
+            } else {
+                lo = q;
+            }
+
+            // Newton step, falling back to bisection when it leaves the bracket
+            double next = q - error / dxdq;
+            if (not (next > lo and next < hi)) {
+                next = 0.5 * (lo + hi);
+            }
+            q = next;
+        }
+    }
+
+    double time = 0.0;
+    for (int i = 0; i < n; i++) {
+        const double s = q * path[i].velocity / v_max;
+        time += path[i].thickness / (path[i].velocity * std::sqrt(1.0 - s * s));
+    }
+    return time;
+}
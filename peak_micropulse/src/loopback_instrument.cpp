@@ -0,0 +1,313 @@
+#include "PeakMicroPulseHandler/loopback_instrument.h"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+#include <sys/socket.h>
+
+
+
+LoopbackInstrument::LoopbackInstrument(
+        const int& port/* = 0*/,
+        const int& digitisation_rate/* = 100*/)
+    :  io_(),
+       acceptor_(io_),
+       socket_(),
+       thread_(),
+       running_(false),
+       port_(port),
+       digitisation_rate_(digitisation_rate),
+
+       // Defaults until the MPS file is received
+       dof_(4),
+       gate_start_(0),
+       gate_end_(2000),
+       test_start_(256),
+       test_end_(316),
+
+       fault_(none),
+       fault_frames_(0),
+       segment_size_(7),
+       delay_ms_(50),
+       frame_source_(),
+       packet_(),
+       frames_sent_(0)
+{
+}
+
+
+LoopbackInstrument::~LoopbackInstrument() {
+    stop();
+}
+
+
+void LoopbackInstrument::logToConsole(const std::string& message) {
+    std::cout << "LoopbackInstrument :: " << message << std::endl;
+}
+
+
+void LoopbackInstrument::errorToConsole(const std::string& message) {
+    std::cout << "\033[31m";
+    std::cout << "LoopbackInstrument :: " << message << std::endl;
+    std::cout << "\033[0m";
+}
+
+
+std::string LoopbackInstrument::faultName(const FaultType& fault) {
+    switch (fault) {
+        case none:              return "none";
+        case split_segments:    return "split_segments";
+        case mid_frame_delay:   return "mid_frame_delay";
+        case error_packet:      return "error_packet";
+        case corrupt_count:     return "corrupt_count";
+        case corrupt_dof:       return "corrupt_dof";
+        case drop_ascan:        return "drop_ascan";
+    }
+    return "unknown";
+}
+
+
+void LoopbackInstrument::start() {
+    using boost::asio::ip::tcp;
+
+    acceptor_.open(tcp::v4());
+    acceptor_.set_option(tcp::acceptor::reuse_address(true));
+    acceptor_.bind(tcp::endpoint(boost::asio::ip::address_v4::loopback(), port_));
+    acceptor_.listen();
+    port_ = acceptor_.local_endpoint().port();
+
+    running_ = true;
+    thread_ = std::thread(&LoopbackInstrument::serve, this);
+    logToConsole("Listening on 127.0.0.1:" + std::to_string(port_));
+}
+
+
+void LoopbackInstrument::stop() {
+    if (not running_) {
+        return;
+    }
+    running_ = false;
+
+    // Shutting down the sockets wakes the blocking accept and read
+    ::shutdown(acceptor_.native_handle(), SHUT_RDWR);
+    closeConnection();
+
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+
+    boost::system::error_code ec;
+    acceptor_.close(ec);
+}
+
+
+void LoopbackInstrument::closeConnection() {
+    std::lock_guard<std::mutex> lock(socket_mutex_);
+    if (socket_) {
+        ::shutdown(socket_->native_handle(), SHUT_RDWR);
+    }
+}
+
+
+void LoopbackInstrument::injectFault(const FaultType& fault, const int& frames/* = 1*/) {
+    std::lock_guard<std::mutex> lock(fault_mutex_);
+    fault_ = fault;
+    fault_frames_ = frames;
+}
+
+
+void LoopbackInstrument::setSplitSegmentSize(const int& bytes) {
+    segment_size_ = std::max(bytes, 1);
+}
+
+
+void LoopbackInstrument::setMidFrameDelay(const int& milliseconds) {
+    delay_ms_ = milliseconds;
+}
+
+
+void LoopbackInstrument::setFrameSource(const FrameSource& frame_source) {
+    frame_source_ = frame_source;
+}
+
+
+void LoopbackInstrument::serve() {
+    using boost::asio::ip::tcp;
+
+    while (running_) {
+        std::unique_ptr<tcp::socket> socket(new tcp::socket(io_));
+        boost::system::error_code ec;
+        acceptor_.accept(*socket, ec);
+        if (ec or not running_) {
+            break;
+        }
+        socket->set_option(tcp::no_delay(true));
+
+        {
+            std::lock_guard<std::mutex> lock(socket_mutex_);
+            socket_ = std::move(socket);
+        }
+
+        boost::asio::streambuf buffer;
+        while (running_) {
+            boost::asio::read_until(*socket_, buffer, "\r\n", ec);
+            if (ec) {
+                break;
+            }
+
+            std::istream stream(&buffer);
+            std::string command;
+            std::getline(stream, command);
+            if (not command.empty() and command.back() == '\r') {
+                command.pop_back();
+            }
+
+            try {
+                handleCommand(command);
+            } catch (const boost::system::system_error& e) {
+                break;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(socket_mutex_);
+        socket_.reset();
+    }
+}
+
+
+void LoopbackInstrument::handleCommand(const std::string& command) {
+    std::vector<std::string> args;
+    std::stringstream command_stream(command);
+    std::string tmp;
+    while (std::getline(command_stream, tmp, ' ')) {
+        args.push_back(tmp);
+    }
+
+    if (args.empty()) {
+        return;
+    }
+
+    if (args[0] == "RST") {
+        sendReset();
+    } else if (args[0] == "CALS") {
+        sendFrame();
+    } else if (args[0] == "DOF" and args.size() > 1) {
+        dof_ = std::stoi(args[1]);
+    } else if (args[0] == "GATS" and args.size() > 3) {
+        gate_start_ = std::stoi(args[2]);
+        gate_end_ = std::stoi(args[3]);
+    } else if (args[0] == "SWP" and args.size() > 4) {
+        test_start_ = std::stoi(args[2]);
+        test_end_ = std::stoi(args[4]);
+    }
+}
+
+
+void LoopbackInstrument::sendReset() {
+    std::vector<unsigned char> response(32, 0);
+    response[0] = 0x23;
+    response[4] = 3 << 4;                                     // LTPA
+    response[7] = dof_;
+    response[8] = digitisation_rate_;
+    response[9] = digitisation_rate_;
+    response[10] = 1;
+    write(response.data(), response.size());
+}
+
+
+void LoopbackInstrument::fillPattern(std::vector<unsigned char>& packet, const long& frame) {
+    // Gaussian windowed tone burst whose position drifts with the A-Scan index
+    const int bytes_per_sample = dof_ == 4 ? 2 : 1;
+    const int length = ascanLength();
+    const int message_length = 8 + bytes_per_sample * length;
+
+    for (int a = 0; a < numAScans(); a++) {
+        unsigned char* message = &packet[(size_t)a * message_length];
+        const int centre = length / 4 + (a * 7 + frame) % (length / 2 + 1);
+
+        for (int i = 0; i < length; i++) {
+            const double t = (i - centre) / 8.0;
+            const double value = std::exp(-0.5 * t * t) * std::sin(1.5 * t);
+
+            if (bytes_per_sample == 2) {
+                const short int amp = (short int)(12000.0 * value);
+                message[8 + 2 * i] = amp & 0xFF;
+                message[8 + 2 * i + 1] = (amp >> 8) & 0xFF;
+            } else {
+                message[8 + i] = (unsigned char)(128.0 + 100.0 * value);
+            }
+        }
+    }
+}
+
+
+void LoopbackInstrument::sendFrame() {
+    const int bytes_per_sample = dof_ == 4 ? 2 : 1;
+    const int message_length = 8 + bytes_per_sample * ascanLength();
+    const int n_ascans = numAScans();
+
+    packet_.assign((size_t)n_ascans * message_length, 0);
+
+    if (frame_source_) {
+        frame_source_(packet_, frames_sent_);
+    } else {
+        fillPattern(packet_, frames_sent_);
+    }
+
+    // Sub-headers, test numbers are reported one less than programmed
+    for (int a = 0; a < n_ascans; a++) {
+        unsigned char* message = &packet_[(size_t)a * message_length];
+        const int reported_test = test_start_ + a - 1;
+        message[0] = 0x1A;
+        message[1] = message_length & 0xFF;
+        message[2] = (message_length >> 8) & 0xFF;
+        message[3] = (message_length >> 16) & 0xFF;
+        message[4] = reported_test & 0xFF;
+        message[5] = (reported_test >> 8) & 0xFF;
+        message[6] = dof_;
+        message[7] = 0;
+    }
+
+    FaultType fault = none;
+    {
+        std::lock_guard<std::mutex> lock(fault_mutex_);
+        if (fault_frames_ > 0) {
+            fault = fault_;
+            fault_frames_--;
+        }
+    }
+
+    const size_t middle = (size_t)(n_ascans / 2) * message_length;
+
+    if (fault == error_packet) {
+        const unsigned char error_message[2] = {0x06, 0x81};
+        packet_.insert(packet_.begin() + middle, error_message, error_message + 2);
+    } else if (fault == corrupt_count) {
+        packet_[middle + 1] ^= 0x5A;
+    } else if (fault == corrupt_dof) {
+        packet_[middle + 6] = dof_ + 1;
+    } else if (fault == drop_ascan) {
+        packet_.erase(packet_.begin() + middle, packet_.begin() + middle + message_length);
+    }
+
+    if (fault == split_segments) {
+        for (size_t i = 0; i < packet_.size(); i += segment_size_) {
+            write(&packet_[i], std::min((size_t)segment_size_, packet_.size() - i));
+        }
+    } else if (fault == mid_frame_delay) {
+        write(packet_.data(), middle);
+        std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms_));
+        write(packet_.data() + middle, packet_.size() - middle);
+    } else {
+        write(packet_.data(), packet_.size());
+    }
+
+    frames_sent_++;
+}
+
+
+void LoopbackInstrument::write(const unsigned char* data, const size_t& length) {
+    boost::asio::write(*socket_, boost::asio::buffer(data, length));
+}
@@ -0,0 +1,227 @@
+#include "PeakMicroPulseHandler/matched_filter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <ctime>
+
+
+
+namespace {
+
+long long threadCpuNs() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+}
+
+
+MatchedFilter::MatchedFilter(const int& n_threads/* = 0*/)
+    :  workers_(n_threads),
+       fft_(),
+       reference_length_(0),
+       hop_(0),
+       gain_(1.0f),
+       reference_spectrum_(),
+       block_scratch_(workers_.size()),
+       spectrum_scratch_(workers_.size()),
+       result_scratch_(workers_.size()),
+       cpu_ns_(0),
+       timing_(),
+       tracer_(nullptr)
+{
+}
+
+
+MatchedFilter::~MatchedFilter() {
+}
+
+
+void MatchedFilter::logToConsole(const std::string& message) {
+    std::cout << "MatchedFilter :: " << message << std::endl;
+}
+
+
+void MatchedFilter::errorToConsole(const std::string& message) {
+    std::cout << "\033[31m";
+    std::cout << "MatchedFilter :: " << message << std::endl;
+    std::cout << "\033[0m";
+}
+
+
+void MatchedFilter::setReference(const std::vector<float>& pulse) {
+    if (pulse.empty()) {
+        errorToConsole("ERROR - Empty reference pulse");
+        return;
+    }
+
+    reference_length_ = pulse.size();
+
+    // Blocks of four reference lengths keep the overlap to a quarter of the work
+    fft_.reset(new RealFft(RealFft::nextPowerOfTwo(4 * reference_length_)));
+    hop_ = fft_->length() - reference_length_ + 1;
+
+    std::vector<float> padded(fft_->length(), 0.0f);
+    std::copy(pulse.begin(), pulse.end(), padded.begin());
+
+    reference_spectrum_.resize(fft_->bins());
+    fft_->forward(padded.data(), reference_spectrum_.data());
+    for (auto& bin : reference_spectrum_) {
+        bin = std::conj(bin);
+    }
+
+    double energy = 0.0;
+    float peak = 0.0f;
+    for (auto sample : pulse) {
+        energy += (double)sample * sample;
+        peak = std::max(peak, std::fabs(sample));
+    }
+    gain_ = energy > 0.0 ? (float)(peak / energy) : 0.0f;
+
+    for (int w = 0; w < workers_.size(); w++) {
+        block_scratch_[w].resize(fft_->length());
+        spectrum_scratch_[w].resize(fft_->bins());
+        result_scratch_[w].resize(fft_->length());
+    }
+
+    timing_ = Timing();
+
+    logToConsole("Reference pulse of " + std::to_string(reference_length_) +
+                 " samples, block length " + std::to_string(fft_->length()));
+}
+
+
+void MatchedFilter::setReference(
+        const PeakHandler::OutputFormat& calibration_frame,
+        const int& ascan,
+        const int& pulse_start,
+        const int& pulse_end) {
+
+    if (ascan < 0 or ascan >= (int)calibration_frame.ascans.size()) {
+        errorToConsole("ERROR - Calibration A-Scan " + std::to_string(ascan) + " not in frame");
+        return;
+    }
+
+    const std::vector<short int>& amps = calibration_frame.ascans[ascan].amps;
+    const int start = std::max(pulse_start, 0);
+    const int end = std::min(pulse_end, (int)amps.size());
+
+    if (end <= start) {
+        errorToConsole("ERROR - Empty reference pulse window");
+        return;
+    }
+
+    double mean = 0.0;
+    for (int i = start; i < end; i++) {
+        mean += amps[i];
+    }
+    mean /= (end - start);
+
+    std::vector<float> pulse(end - start);
+    for (int i = start; i < end; i++) {
+        pulse[i - start] = (float)(amps[i] - mean);
+    }
+
+    setReference(pulse);
+}
+
+
+void MatchedFilter::filter(
+        const std::vector<short int>& amps,
+        std::vector<short int>& filtered,
+        const int& worker) {
+
+    const int n = amps.size();
+    const int length = fft_->length();
+    std::vector<float>& block = block_scratch_[worker];
+    std::vector<std::complex<float>>& spectrum = spectrum_scratch_[worker];
+    std::vector<float>& result = result_scratch_[worker];
+
+    filtered.resize(n);
+
+    // Overlap-save: the first hop_ outputs of each circular correlation are valid
+    for (int start = 0; start < n; start += hop_) {
+        const int available = std::min(length, n - start);
+        for (int i = 0; i < available; i++) {
+            block[i] = amps[start + i];
+        }
+        std::fill(block.begin() + available, block.end(), 0.0f);
+
+        fft_->forward(block.data(), spectrum.data());
+        for (int k = 0; k < fft_->bins(); k++) {
+            spectrum[k] *= reference_spectrum_[k];
+        }
+        fft_->inverse(spectrum.data(), result.data());
+
+        const int valid = std::min(hop_, n - start);
+        for (int i = 0; i < valid; i++) {
+            float value = result[i] * gain_;
+            value = std::min(std::max(value, (float)SHRT_MIN), (float)SHRT_MAX);
+            filtered[start + i] = (short int)std::lround(value);
+        }
+    }
+}
+
+
+size_t MatchedFilter::footprint() const {
+    size_t bytes = fft_ ? fft_->footprint() : 0;
+    bytes += reference_spectrum_.capacity() * sizeof(std::complex<float>);
+    for (int w = 0; w < workers_.size(); w++) {
+        bytes += (block_scratch_[w].capacity() + result_scratch_[w].capacity()) * sizeof(float);
+        bytes += spectrum_scratch_[w].capacity() * sizeof(std::complex<float>);
+    }
+    return bytes;
+}
+
+
+void MatchedFilter::attachTracer(FrameTracer* tracer) {
+    tracer_ = tracer;
+}
+
+
+bool MatchedFilter::process(
+        const PeakHandler::OutputFormat& input,
+        PeakHandler::OutputFormat& output) {
+
+    if (not fft_) {
+        errorToConsole("ERROR - No reference pulse set");
+        return false;
+    }
+
+    auto wall_start = std::chrono::steady_clock::now();
+    const long long trace_start = tracer_ != nullptr ? FrameTracer::now() : 0;
+    cpu_ns_.store(0);
+
+    // The A-Scan buffers already in output are reused
+    PeakHandler::copyFrameMetadata(input, output);
+    output.ascans.resize(input.ascans.size());
+
+    const int n_ascans = input.ascans.size();
+    workers_.parallelFor(n_ascans, [&](const int& begin, const int& end, const int& worker) {
+        long long cpu_start = threadCpuNs();
+        const long long chunk_start = tracer_ != nullptr ? FrameTracer::now() : 0;
+        for (int i = begin; i < end; i++) {
+            output.ascans[i].header = input.ascans[i].header;
+            filter(input.ascans[i].amps, output.ascans[i].amps, worker);
+        }
+        if (tracer_ != nullptr) {
+            tracer_->span("matched filter chunk", input.frame_number, chunk_start);
+        }
+        cpu_ns_ += threadCpuNs() - cpu_start;
+    });
+
+    if (tracer_ != nullptr) {
+        tracer_->span("matched filter done", input.frame_number, trace_start);
+    }
+
+    timing_.wall_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - wall_start).count();
+    timing_.cpu_us = cpu_ns_.load() / 1000.0;
+    timing_.frames++;
+    timing_.mean_cpu_us += (timing_.cpu_us - timing_.mean_cpu_us) / timing_.frames;
+    timing_.max_cpu_us = std::max(timing_.max_cpu_us, timing_.cpu_us);
+
+    return true;
+}
@@ -0,0 +1,76 @@
+#include "PeakMicroPulseHandler/memory_budget.h"
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+
+
+MemoryBudget::MemoryBudget(const size_t& budget)
+    :  budget_(budget),
+       reserved_(0),
+       reservations_()
+{
+}
+
+
+MemoryBudget::~MemoryBudget() {
+}
+
+
+void MemoryBudget::logToConsole(const std::string& message) {
+    std::cout << "MemoryBudget :: " << message << std::endl;
+}
+
+
+void MemoryBudget::errorToConsole(const std::string& message) {
+    std::cout << "\033[31m";
+    std::cout << "MemoryBudget :: " << message << std::endl;
+    std::cout << "\033[0m";
+}
+
+
+bool MemoryBudget::reserve(const std::string& component, const size_t& bytes) {
+    const auto existing = reservations_.find(component);
+    const size_t previous = existing != reservations_.end() ? existing->second : 0;
+
+    if (reserved_ - previous + bytes > budget_) {
+        errorToConsole(
+            "ERROR - " + component + " needs " + std::to_string(bytes) + " bytes, " +
+            std::to_string(budget_ - (reserved_ - previous)) + " of " + std::to_string(budget_) + " remain"
+            );
+        return false;
+    }
+
+    reserved_ = reserved_ - previous + bytes;
+    reservations_[component] = bytes;
+    return true;
+}
+
+
+void MemoryBudget::release(const std::string& component) {
+    const auto existing = reservations_.find(component);
+    if (existing != reservations_.end()) {
+        reserved_ -= existing->second;
+        reservations_.erase(existing);
+    }
+}
+
+
+void MemoryBudget::report() {
+    auto megabytes = [](const size_t& bytes) {
+        std::ostringstream text;
+        text << std::fixed << std::setprecision(2) << std::setw(10) << bytes / (1024.0 * 1024.0) << " MB";
+        return text.str();
+    };
+
+    logToConsole(" -------- Memory Footprint --------");
+    for (const auto& reservation : reservations_) {
+        std::ostringstream name;
+        name << std::left << std::setw(24) << reservation.first;
+        logToConsole(name.str() + megabytes(reservation.second));
+    }
+    logToConsole("Reserved                " + megabytes(reserved_));
+    logToConsole("Budget                  " + megabytes(budget_));
+    logToConsole(" -------- ---------------- --------");
+}
@@ -1,4 +1,41 @@
 #include "PeakMicroPulseHandler/peak_handler.h"
+#include "PeakMicroPulseHandler/coupling_monitor.h"
+#include "PeakMicroPulseHandler/frame_tracer.h"
+#include "PeakMicroPulseHandler/subset_selector.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+
+
+
+namespace {
+    const long max_focal_law = 65535;                         // Law and test numbers index flat tables
+
+    // Reads the next space separated number of an MPS line and moves past it, false without one.
+    // Focal law lines run to hundreds per file, where strtod and its locale handling dominated.
+    bool readNumber(const char*& cursor, double& value) {
+        while (*cursor == ' ' or *cursor == '\t') {
+            cursor++;
+        }
+        const bool negative = *cursor == '-';
+        cursor += *cursor == '-' or *cursor == '+' ? 1 : 0;
+        const char* digits = cursor;
+        double number = 0.0;
+        while (*cursor >= '0' and *cursor <= '9') {
+            number = 10.0 * number + (*cursor++ - '0');
+        }
+        if (*cursor == '.') {
+            double scale = 0.1;
+            for (cursor++; *cursor >= '0' and *cursor <= '9'; cursor++, scale *= 0.1) {
+                number += (*cursor - '0') * scale;
+            }
+        }
+        value = negative ? -number : number;
+        return cursor != digits and (*cursor == '\0' or *cursor == ' ' or *cursor == '\t' or *cursor == '\r');
+    }
+}
 
 
 
@@ -17,13 +54,44 @@ PeakHandler::PeakHandler(
        ltpa_client_(ip_address_, port_),
 
        // LTPA Configuration
-       mps_file_(mps_file)
+       mps_file_(mps_file),
+       focal_laws_(),
+       dof_(0),
+       gate_start_(0),
+       gate_end_(0),
+       ascan_length_(0),
+       num_a_scans_(0),
+       individual_ascan_obs_length_(0),
+       packet_length_(0),
+       saturation_level_(0),
+       user_saturation_level_(0),
+       coupling_monitor_(nullptr),
+       tracer_(nullptr),
+       subset_selector_(nullptr),
+       use_huge_pages_(false),
+       response_(),
+       decode_buffer_(),
+       spare_buffer_(),
+       coupling_failures_(),
+       lazy_decode_requested_(false),
+       lazy_decode_(false),
+       published_packet_(),
+       ascan_offsets_(),
+       published_offsets_(),
+       decoded_(),
+       crop_mutex_(),
+       crop_windows_(),
+       decode_crop_(),
+       published_crop_(),
+       no_ascan_(),
+       link_statistics_(),
+       reset_wait_(10)
 {
 }
 
 
 PeakHandler::~PeakHandler() {
-    ltpa_client_.~TcpClientBoost();
+    // ltpa_client_ is destroyed as a member, calling its destructor here freed it twice
 }
 
 
@@ -65,27 +133,44 @@ void PeakHandler::setReconstructionConfiguration(
     ltpa_data_.specimen_depth = specimen_depth;
 }
 
-void PeakHandler::readMpsFile() {
+bool PeakHandler::readMpsFile() {
     logToConsole("Attempting to open " + mps_file_);
     std::ifstream file;
     file.open(mps_file_);
 
     if (!file.is_open()) {
         errorToConsole("Error: Unable to open " + mps_file_);
-        return;
+        return false;
     }
 
-    std::string line;
-    commands_.clear();
-
-    while(std::getline(file, line))
-    {
+    // Read whole and split in place, focal laws make the file hundreds of lines long
+    file.seekg(0, std::ios::end);
+    std::string contents(std::max((long)file.tellg(), 0L), '\0');
+    file.seekg(0, std::ios::beg);
+    file.read(&contents[0], contents.size());
+    contents.resize(std::max((long)file.gcount(), 0L));
+    clearFocalLaws();
+
+    // Lines are assigned over the previous read's, reusing their storage
+    size_t n_commands = 0;
+    for (size_t begin = 0; begin < contents.size(); n_commands++) {
+        const size_t newline = contents.find('\n', begin);
+        const size_t end = newline == std::string::npos ? contents.size() : newline;
+        if (n_commands == commands_.size()) {
+            commands_.emplace_back();
+        }
         // TODO: May need to trim leading and trailing whitespace here and ignore comments?
-        commands_.push_back(line);
-
+        commands_[n_commands].assign(contents, begin, end - begin);
+        const std::string& line = commands_[n_commands];
+        begin = end + 1;
+
+        // TXF, RXF, TXN and RXN make up most of the file, so are picked out first and cheaply
+        const bool focal_law = line.size() > 3 and (line[0] == 'T' or line[0] == 'R') and line[1] == 'X' and
+                               (line[2] == 'F' or line[2] == 'N') and line[3] == ' ';
+        if (focal_law) {
+            setFocalLaw(line);
         // TODO: Consider parsing the NUM directive
-        // TODO: Consider parsing TXF and RXF directives
-        if (line.rfind("DOF", 0) == 0) {
+        } else if (line.rfind("DOF", 0) == 0) {
             setDof(line);
         // TODO: Cover mps files that use the GAT command multiple times instead of GATS
         } else if (line.rfind("GATS", 0) == 0) {
@@ -97,10 +182,12 @@ void PeakHandler::readMpsFile() {
             setNumAScans(line);
         }
     }
+    commands_.resize(n_commands);
 
     calcPacketLength();
     file.close();
     logToConsole("MPS file read successfully");
+    return true;
 }
 
 
@@ -153,6 +240,7 @@ void PeakHandler::setNumAScans(const std::string& command) {
         std::vector<std::string> args = processMpsLine(command);
         // Definition - SWP <sweep No.> <start Tn> <-> <end Tn>
         num_a_scans_ = std::stoi(args[4]) - std::stoi(args[2]) + 1;
+        focal_laws_.first_test = std::stoi(args[2]);
         logToConsole("Number of A-Scans: " + std::to_string(num_a_scans_));
     }
 
@@ -160,6 +248,62 @@ void PeakHandler::setNumAScans(const std::string& command) {
 }
 
 
+void PeakHandler::clearFocalLaws() {
+    // Emptied rather than freed, so rereading the file reuses the same storage
+    for (std::vector<FocalLaw>* laws : {&focal_laws_.transmit, &focal_laws_.receive}) {
+        for (FocalLaw& law : *laws) {
+            law.elements.clear();
+            law.delays.clear();
+        }
+    }
+    std::fill(focal_laws_.transmit_laws.begin(), focal_laws_.transmit_laws.end(), -1);
+    std::fill(focal_laws_.receive_laws.begin(), focal_laws_.receive_laws.end(), -1);
+    focal_laws_.first_test = 0;
+}
+
+
+void PeakHandler::setFocalLaw(const std::string& command) {
+    // Hundreds of these lines per file, so read in place rather than through processMpsLine
+    const char* cursor = command.c_str() + 3;
+    double first = 0.0;
+    double second = 0.0;
+    if (not readNumber(cursor, first) or not readNumber(cursor, second) or first < 0.0 or first > max_focal_law) {
+        errorToConsole("ERROR - Incomplete focal law definition in MPS file: " + command);
+        return;
+    }
+
+    if (command[2] == 'N') {
+        // Definition - TXN/RXN <test number> <focal law>
+        std::vector<int>& laws = command[0] == 'T' ? focal_laws_.transmit_laws : focal_laws_.receive_laws;
+        if ((size_t)first >= laws.size()) {
+            laws.resize((size_t)first + 1, -1);
+        }
+        laws[(size_t)first] = second >= 0.0 and second <= max_focal_law ? (int)second : -1;
+        return;
+    }
+
+    // Definition - TXF <focal law> <channel> <delay>, RXF <focal law> <channel> <delay> <gain>,
+    // channel 0 with a delay of -1 clears the law
+    double delay = 0.0;
+    if (not readNumber(cursor, delay) or second < 0.0) {
+        errorToConsole("ERROR - Incomplete focal law definition in MPS file: " + command);
+        return;
+    }
+    std::vector<FocalLaw>& laws = command[0] == 'T' ? focal_laws_.transmit : focal_laws_.receive;
+    if ((size_t)first >= laws.size()) {
+        laws.resize((size_t)first + 1);
+    }
+    FocalLaw& law = laws[(size_t)first];
+    if (second == 0.0) {
+        law.elements.clear();
+        law.delays.clear();
+        return;
+    }
+    law.elements.push_back((int)second - 1);
+    law.delays.push_back(delay);
+}
+
+
 void PeakHandler::calcPacketLength() {
     // 8 Bit Mode
     if (dof_ == 1) {
@@ -177,11 +321,66 @@ void PeakHandler::calcPacketLength() {
 
     packet_length_ = num_a_scans_ * individual_ascan_obs_length_;
 
+    // Allocated once, with room for a few extra messages before it has to grow
+    response_.reset(new HugePageBuffer<unsigned char>(use_huge_pages_));
+    response_->reserve(packet_length_ + 4 * individual_ascan_obs_length_);
+    logToConsole("Packet buffer: " + std::to_string(response_->capacity()) + " bytes on " +
+                 HugePageRegion::backingName(response_->backing()));
+
+    // Frames are decoded into one buffer while the other is published, the spare
+    // takes the place of the empty published frame after the first swap
+    for (auto* buffer : {&decode_buffer_, &spare_buffer_}) {
+        buffer->resize(num_a_scans_);
+        for (auto& message : *buffer) {
+            message.amps.reserve(ascan_length_);
+        }
+    }
+    ltpa_data_.ascans.clear();
+    decoded_.clear();
+    decoded_.reserve(num_a_scans_);
+
+    // Latched here with the buffers it needs, so a later setLazyDecode cannot change a running loop
+    lazy_decode_ = lazy_decode_requested_;
+    if (lazy_decode_) {
+        published_packet_.reset(new HugePageBuffer<unsigned char>(use_huge_pages_));
+        published_packet_->reserve(response_->capacity());
+        ascan_offsets_.assign(num_a_scans_, 0);
+        published_offsets_.assign(num_a_scans_, 0);
+    }
+    coupling_failures_.reserve(num_a_scans_);
+    ltpa_data_.coupling_failures.reserve(num_a_scans_);
+    logToConsole("Memory footprint: " + std::to_string(footprint()) + " bytes");
+
+    // Full scale of this file's output format unless the user has set a level
+    updateSaturationLevel();
+
     logToConsole("Individual A-Scan length: " + std::to_string(individual_ascan_obs_length_));
     logToConsole("Packet length: " + std::to_string(packet_length_));
 }
 
 
+void PeakHandler::setSaturationLevel(const int& saturation_level) {
+    // 0 goes back to the full scale of the DOF
+    user_saturation_level_ = std::max(saturation_level, 0);
+    updateSaturationLevel();
+    logToConsole("Saturation level: " + std::to_string(saturation_level_));
+}
+
+
+void PeakHandler::updateSaturationLevel() {
+    if (user_saturation_level_ > 0) {
+        saturation_level_ = user_saturation_level_;
+    } else {
+        saturation_level_ = fullScale(dof_);
+    }
+}
+
+
+void PeakHandler::setResetWait(const int& seconds) {
+    reset_wait_ = seconds;
+}
+
+
 void PeakHandler::connect(int digitisation_rate/* = 0*/) {
     logToConsole("Connecting to LTPA at " + ip_address_);
     ltpa_client_.connect();
@@ -218,7 +417,7 @@ void PeakHandler::sendReset(int digitisation_rate/* = 0*/) {
             exit(0);
         }
         
-        sleep(10);
+        sleep(reset_wait_);
         // Receive 32 bytes of data for the returned header after reset
         std::vector<unsigned char> response = ltpa_client_.receive(32);
         if ((int)response.front() == 35) {
@@ -268,17 +467,48 @@ void PeakHandler::sendMpsConfiguration() {
 }
 
 
-auto PeakHandler::dataOutpoutFormatReader(const std::vector<unsigned char>& packet) {
+PeakHandler::DofMessage PeakHandler::dataOutpoutFormatReader(const std::vector<unsigned char>& packet) {
+    return dataOutpoutFormatReader(packet.data(), packet.size());
+}
+
+
+PeakHandler::DofMessage PeakHandler::dataOutpoutFormatReader(const unsigned char* packet, const int& length) {
     DofMessage data;
+    dataOutpoutFormatReader(packet, length, data);
+    return data;
+}
+
+
+// <hdr><count lsb><count tsb><count msb><test lsb><test msb><dof><channel>
+void PeakHandler::readSubHeader(const unsigned char* packet, DofMessageHeader& header) {
+    header.count =              (int)((packet[3] << 16) | (packet[2] << 8) | packet[1]);
+    header.testNo =             (int)(packet[5] << 8 | packet[4]);
+    header.dof =                (int)packet[6];
+    header.channel =            (int)packet[7];
+}
+
 
-    if (packet.front() == 26) {
-        // TODO: Subheader processing to separate method
+// Decodes into data, reusing the capacity of its amplitudes
+void PeakHandler::dataOutpoutFormatReader(const unsigned char* packet, const int& length, DofMessage& data) {
+    readDofMessage(packet, length, decode_crop_.get(), data);
+}
+
+
+void PeakHandler::readDofMessage(
+        const unsigned char* packet,
+        const int& length,
+        const std::vector<CropWindow>* crop_windows,
+        DofMessage& data) {
+    data.header = DofMessageHeader();
+    data.amps.clear();
+
+    if (length <= 0) {
+        errorToConsole("ERROR - Empty DOF packet");
+        data.header.header = error;
+
+    } else if (packet[0] == 26) {
+        readSubHeader(packet, data.header);
         data.header.header =        ascan;
-        data.header.count =         (int)((packet[3] << 16) | (packet[2] << 8) | packet[1]);
-        data.header.testNo =        (int)(packet[5] << 8 | packet[4]);
-        data.header.dof =           (int)packet[6];
-        data.header.channel =       (int)packet[7];
-        //data.amps.clear();
 
         // TODO: Remove debug outputs after testing
         //logToConsole("--------=== New A-Scan ===--------");
@@ -287,11 +517,34 @@ auto PeakHandler::dataOutpoutFormatReader(const std::vector<unsigned char>& pack
         //logToConsole("DOF: " + std::to_string(data.header.dof));
         //logToConsole("Channel: " + std::to_string(data.header.channel));
 
+        // Samples outside the test's crop window are skipped, statistics cover what is kept
+        int crop_start = 0;
+        int crop_end = INT_MAX / 4;     // Leaves room for two bytes per sample plus the sub-header
+        if (crop_windows != nullptr and data.header.testNo < (int)crop_windows->size()) {
+            const CropWindow& crop = (*crop_windows)[data.header.testNo];
+            if (crop.end > crop.start) {
+                crop_start = crop.start;
+                crop_end = crop.end;
+            }
+        }
+        data.header.sample_offset = crop_start;
+
+        // Statistics are accumulated in the same pass as the unpacking
+        StatisticsAccumulator statistics(data.header.dof, saturation_level_);
+
+        auto accumulate = [&](const short int& amp) {
+            statistics.add(amp);
+            data.amps.push_back(amp);
+        };
+
         // 8 Bit Mode
         if (data.header.dof == 1) {
         //if (dof_ == 1) {
-            for (int i = sub_header_size_; i < data.header.count; i++) {
-                data.amps.push_back((short int)packet[i]);
+            const int end = std::min(std::min(data.header.count, length), sub_header_size_ + crop_end);
+            const int start = sub_header_size_ + crop_start;
+            data.amps.reserve(std::max(end - start, 0));
+            for (int i = start; i < end; i++) {
+                accumulate((short int)packet[i]);
             }
 
         // TODO: Implememnt DOF 2, 3, 5 & 6
@@ -299,51 +552,51 @@ auto PeakHandler::dataOutpoutFormatReader(const std::vector<unsigned char>& pack
         // 16 Bit Mode
         } else if (data.header.dof == 4) {
         //} else if (dof_ == 4) {
-            int i = sub_header_size_;
-            while (i < data.header.count) {
+            const int end = std::min(std::min(data.header.count, length - 1), sub_header_size_ + 2 * crop_end);
+            int i = sub_header_size_ + 2 * crop_start;
+            data.amps.reserve(std::max((end - i + 1) / 2, 0));
+            while (i < end) {
                 // TODO: Confirm the byte order here
-                data.amps.push_back((short int)(packet[i+1] << 8 | packet[i]));
+                accumulate((short int)(packet[i+1] << 8 | packet[i]));
                 i = i+2;
             }
         }
 
-    } else if (packet.front() == 28) {
+        data.header.statistics = statistics.statistics();
+
+    } else if (packet[0] == 28) {
         logToConsole("Normal indications returned");
         data.header.header = normal_indications;
         // TODO: Implement normal indications
 
-    } else if (packet.front() == 29) {
+    } else if (packet[0] == 29) {
         logToConsole("Gain reduced indications returned");
         data.header.header = gain_reduced_indications;
         // TODO: Implement gain reduced indications
 
-    } else if (packet.front() == 30) {
+    } else if (packet[0] == 30) {
         logToConsole("LWL coupling failure returned");
-        data.header.header = lwl_coupling_failure;
-        // TODO: Implement LWL (coupling failure)
+        // Same sub-header as an A-Scan but without amplitudes
+        readSubHeader(packet, data.header);
+        data.header.header =        lwl_coupling_failure;
 
-    } else if (packet.front() == 6) {
+    } else if (packet[0] == 6) {
         errorToConsole("ERROR - LTPA error message returned");
         data.header.header = error;
         // TODO: Implement better error message return handling
 
     } else {
-        errorToConsole("ERROR - Unkown DOF packet sub-header byte: "+ std::to_string((int)packet.front()));
-        // TODO: Subheader processing to separate method
+        errorToConsole("ERROR - Unkown DOF packet sub-header byte: "+ std::to_string((int)packet[0]));
+        readSubHeader(packet, data.header);
         data.header.header =        error;
-        data.header.count =         (int)((packet[3] << 16) | (packet[2] << 8) | packet[1]);
-        data.header.testNo =        (int)(packet[5] << 8 | packet[4]);
-        data.header.dof =           (int)packet[6];
-        data.header.channel =       (int)packet[7];
-        //data.amps.clear();
     }
-
-    return data;
 }
 
 
 bool PeakHandler::sendDataRequest() {
     bool valid = false;
+    const long frame = link_statistics_.frames_requested;
+    long long trace_start = traceTime();
 
     // TODO: Get a handle on the behavior of these different commands and what is best for streaming and single measurements
     sendCommand("CALS 1");
@@ -352,28 +605,84 @@ bool PeakHandler::sendDataRequest() {
     //sendCommand("CALS 0");
     //sendCommand("STR 0");
     //sendCommand("STP 0");
+    trace_start = traceSpan("request sent", frame, trace_start);
 
-    std::vector<unsigned char> response = ltpa_client_.receive(packet_length_);
+    // Received into a buffer kept between frames, optionally on huge pages
+    if (not response_) {
+        response_.reset(new HugePageBuffer<unsigned char>(use_huge_pages_));
+    }
+    HugePageBuffer<unsigned char>& response = *response_;
+    response.clear();
+
+    // The first message header is read on its own so the wait for the LTPA can be told apart from the transfer
+    receiveAtLeast(response, 2);
+    trace_start = traceSpan("first byte", frame, trace_start);
+    receiveAtLeast(response, packet_length_);
+    trace_start = traceSpan("last byte", frame, trace_start);
     //std::vector<unsigned char> response = ltpa_client_.receive(packet_length_ + 200);
     //std::vector<unsigned char> response = ltpa_client_.receive(179436);
 
+    if (subset_selector_ != nullptr) {
+        subset_selector_->beginFrame(frame, ascan_length_, num_a_scans_);
+    }
+
+    // Crop windows can change while streaming, each frame uses those in place when it started
+    decode_crop_ = std::atomic_load(&crop_windows_);
+
     int ascan_count = 0;
+    int ascans_read = 0;
+    int saturated_ascans = 0;
     int curr_ascan_i = 0;
-    std::vector<DofMessage> data(num_a_scans_);
-    data.clear();
-    data.reserve(num_a_scans_);
-
-    while (curr_ascan_i < packet_length_) {
+    bool aligned = true;
+    // Decoded in place into buffers allocated in calcPacketLength
+    std::vector<int>& coupling_failures = coupling_failures_;
+    coupling_failures.clear();
+    std::vector<DofMessage>& data = decode_buffer_;
+    data.resize(num_a_scans_);
+
+    // Messages are consumed by their own length, so extra messages in the stream top up the
+    // response and corrupt A-Scans are skipped by the MPS length to keep the stream aligned
+    while (ascans_read < num_a_scans_) {
         //logToConsole("Current a-scan start index: " + std::to_string(curr_ascan_i));
 
-        std::vector<unsigned char> ascan_bytes(
-            &response[curr_ascan_i],
-            &response[curr_ascan_i + individual_ascan_obs_length_]
-            );
+        // LTPA error messages are only two bytes long, <06Hex><char>
+        receiveAtLeast(response, curr_ascan_i + 2);
+        if (response[curr_ascan_i] == 6) {
+            errorToConsole("ERROR - LTPA error message returned, code " + std::to_string((int)response[curr_ascan_i + 1]));
+            ++link_statistics_.error_messages;
+            curr_ascan_i += 2;
+            continue;
+        }
 
-        DofMessage message = dataOutpoutFormatReader(ascan_bytes);
+        // Everything else starts with the sub-header, which gives the length of coupling failures
+        receiveAtLeast(response, curr_ascan_i + sub_header_size_);
+        int message_length = sub_header_size_;
+        if (response[curr_ascan_i] == 26) {
+            message_length = individual_ascan_obs_length_;
+        } else if (response[curr_ascan_i] == 30) {
+            message_length = (int)((response[curr_ascan_i + 3] << 16) | (response[curr_ascan_i + 2] << 8) | response[curr_ascan_i + 1]);
+            message_length = std::min(std::max(message_length, sub_header_size_), individual_ascan_obs_length_);
+        }
+        receiveAtLeast(response, curr_ascan_i + message_length);
+
+        // Messages that are not kept are overwritten by the next one
+        DofMessage& message = data[ascan_count];
+        if (lazy_decode_ and response[curr_ascan_i] == 26) {
+            // Amplitudes are left in the packet until ascanAt asks for them
+            message.header = DofMessageHeader();
+            message.amps.clear();
+            readSubHeader(&response[curr_ascan_i], message.header);
+            message.header.header = ascan;
+            ascan_offsets_[ascan_count] = curr_ascan_i;
+        } else {
+            dataOutpoutFormatReader(&response[curr_ascan_i], message_length, message);
+        }
 
         if (message.header.header == ascan) {
+            const int message_start = curr_ascan_i;
+            ++ascans_read;
+            curr_ascan_i += individual_ascan_obs_length_;
+
             // TODO: Consider separate ascan validation method to hold all this logic
             if (message.header.dof != dof_) {
                 errorToConsole(
@@ -384,7 +693,8 @@ bool PeakHandler::sendDataRequest() {
                     "]"
                     );
 
-                break;
+                ++link_statistics_.corrupt_ascans;
+                continue;
 
             } else if (message.header.count != individual_ascan_obs_length_) {
                 errorToConsole(
@@ -395,33 +705,232 @@ bool PeakHandler::sendDataRequest() {
                     "]"
                     );
 
-                break;
+                ++link_statistics_.corrupt_ascans;
+                continue;
+            }
+
+            if (message.header.statistics.saturated > 0) {
+                ++saturated_ascans;
+            }
+
+            if (subset_selector_ != nullptr) {
+                subset_selector_->extract(&response[message_start], message.header);
             }
 
-            data.push_back(message);
             ++ascan_count;
             //ascan_count++;
 
+        } else if (message.header.header == lwl_coupling_failure) {
+            if (message.header.count < sub_header_size_ or message.header.count > individual_ascan_obs_length_) {
+                errorToConsole("ERROR - Malformed LWL coupling failure message");
+                aligned = false;
+                break;
+            }
+            coupling_failures.push_back(message.header.testNo);
+            curr_ascan_i += message.header.count;
+
         } else {
             errorToConsole("ERROR - Returned data message not an A Scan");
+            aligned = false;
             break;
         }
+    }
 
-        curr_ascan_i += message.header.count;
+    ++link_statistics_.frames_requested;
+    if (not aligned) {
+        ++link_statistics_.alignment_losses;
     }
 
+    trace_start = traceSpan("decode done", frame, trace_start);
+
     logToConsole(std::to_string(ascan_count) + " A-Scans Received");
 
     if (ascan_count == num_a_scans_) {
     //if (ascan_count == 113) {
-        ltpa_data_.ascans.clear();
-        //ltpa_data_.ascans.reserve(num_a_scans_);
-        ltpa_data_.ascans = data;
+        // Swapped rather than copied, the previous frame's buffers take the next frame
+        ltpa_data_.ascans.swap(data);
+        if ((int)data.size() != num_a_scans_) {
+            data.swap(spare_buffer_);
+        }
+        if (lazy_decode_) {
+            // The packet stays with the published frame until the next valid one
+            response_.swap(published_packet_);
+            ascan_offsets_.swap(published_offsets_);
+            published_crop_ = decode_crop_;
+            ascan_offsets_.resize(num_a_scans_);
+        }
+        decoded_.assign(num_a_scans_, lazy_decode_ ? 0 : 1);
+        ltpa_data_.frame_number = frame;
+        ltpa_data_.saturated_ascans = saturated_ascans;
+        ltpa_data_.coupling_failures.swap(coupling_failures);
+        if (subset_selector_ != nullptr) {
+            subset_selector_->publish();
+        }
+
+        if (coupling_monitor_ != nullptr) {
+            // The monitor reads every A-Scan's interface echo
+            if (lazy_decode_) {
+                decodeAll();
+            }
+            ltpa_data_.coupling_lost = not coupling_monitor_->check(ltpa_data_);
+            trace_start = traceSpan("coupling monitor done", frame, trace_start);
+        } else {
+            // coupling_failures holds the previous frame's list after the swap
+            ltpa_data_.coupling_lost = not ltpa_data_.coupling_failures.empty();
+        }
 
         valid = true;
+        ++link_statistics_.frames_valid;
+        traceSpan("published", frame, trace_start);
     } else {
         errorToConsole("Incorrect amount of A-Scans returned");
+        ++link_statistics_.frames_dropped;
+
+        // Coupling failures are still reported for frames that are dropped
+        if (coupling_monitor_ != nullptr) {
+            coupling_monitor_->reportLwlFailures(coupling_failures);
+        }
     }
 
     return valid;
 }
+
+
+void PeakHandler::receiveAtLeast(HugePageBuffer<unsigned char>& response, const int& length) {
+    if ((int)response.size() < length) {
+        response.append(ltpa_client_.receive(length - response.size()));
+    }
+}
+
+
+long long PeakHandler::traceTime() const {
+    return tracer_ != nullptr ? FrameTracer::now() : 0;
+}
+
+
+// Records the span since start and returns its end, the start of the next one
+long long PeakHandler::traceSpan(const char* name, const long& frame, const long long& start) {
+    if (tracer_ == nullptr) {
+        return 0;
+    }
+    return tracer_->span(name, frame, start);
+}
+
+
+void PeakHandler::copyFrameMetadata(const OutputFormat& from, OutputFormat& to) {
+    to.frame_number = from.frame_number;
+    to.digitisation_rate = from.digitisation_rate;
+    to.ascan_length = from.ascan_length;
+    to.num_a_scans = from.num_a_scans;
+    to.n_elements = from.n_elements;
+    to.element_pitch = from.element_pitch;
+    to.inter_element_spacing = from.inter_element_spacing;
+    to.element_width = from.element_width;
+    to.vel_wedge = from.vel_wedge;
+    to.vel_couplant = from.vel_couplant;
+    to.vel_material = from.vel_material;
+    to.wedge_angle = from.wedge_angle;
+    to.wedge_depth = from.wedge_depth;
+    to.couplant_depth = from.couplant_depth;
+    to.specimen_depth = from.specimen_depth;
+    to.saturated_ascans = from.saturated_ascans;
+    to.coupling_lost = from.coupling_lost;
+    to.coupling_failures = from.coupling_failures;
+}
+
+
+void PeakHandler::attachCouplingMonitor(CouplingMonitor* coupling_monitor) {
+    coupling_monitor_ = coupling_monitor;
+}
+
+
+size_t PeakHandler::footprint() const {
+    size_t bytes = response_ ? response_->capacity() : 0;
+    bytes += published_packet_ ? published_packet_->capacity() : 0;
+    bytes += (ascan_offsets_.capacity() + published_offsets_.capacity()) * sizeof(int) + decoded_.capacity();
+    for (const auto* buffer : {&decode_buffer_, &spare_buffer_, &ltpa_data_.ascans}) {
+        bytes += buffer->capacity() * sizeof(DofMessage);
+        for (const auto& message : *buffer) {
+            bytes += message.amps.capacity() * sizeof(short int);
+        }
+    }
+    bytes += (coupling_failures_.capacity() + ltpa_data_.coupling_failures.capacity()) * sizeof(int);
+    return bytes;
+}
+
+
+void PeakHandler::setCropWindow(const int& test_number, const int& window_start, const int& window_end) {
+    if (test_number < 0 or test_number > 0xFFFF) {
+        errorToConsole("ERROR - Test number out of range: " + std::to_string(test_number));
+        return;
+    }
+
+    // Copied on write so frames being decoded keep the table they started with
+    std::lock_guard<std::mutex> lock(crop_mutex_);
+    std::shared_ptr<const std::vector<CropWindow>> current = std::atomic_load(&crop_windows_);
+    std::shared_ptr<std::vector<CropWindow>> windows = current ?
+        std::make_shared<std::vector<CropWindow>>(*current) :
+        std::make_shared<std::vector<CropWindow>>();
+
+    if (test_number >= (int)windows->size()) {
+        windows->resize(test_number + 1, CropWindow{0, 0});
+    }
+    (*windows)[test_number] = {std::max(window_start, 0), window_end};
+
+    std::atomic_store(&crop_windows_, std::shared_ptr<const std::vector<CropWindow>>(windows));
+    logToConsole("Crop window for test " + std::to_string(test_number) + ": " +
+                 std::to_string(window_start) + " - " + std::to_string(window_end));
+}
+
+
+void PeakHandler::clearCropWindows() {
+    std::lock_guard<std::mutex> lock(crop_mutex_);
+    std::atomic_store(&crop_windows_, std::shared_ptr<const std::vector<CropWindow>>());
+}
+
+
+void PeakHandler::setLazyDecode(const bool& lazy_decode) {
+    // Applies from the next readMpsFile, which sizes the buffers it needs
+    lazy_decode_requested_ = lazy_decode;
+}
+
+
+const PeakHandler::DofMessage& PeakHandler::ascanAt(const int& i) {
+    if (i < 0 or i >= (int)decoded_.size() or i >= (int)ltpa_data_.ascans.size()) {
+        errorToConsole("ERROR - No A-Scan " + std::to_string(i) + " in the published frame");
+        return no_ascan_;
+    }
+    DofMessage& message = ltpa_data_.ascans[i];
+    if (not decoded_[i]) {
+        // With the crop windows the frame was requested with, later requests may have changed them
+        readDofMessage(&(*published_packet_)[published_offsets_[i]], individual_ascan_obs_length_, published_crop_.get(), message);
+        decoded_[i] = 1;
+        if (message.header.statistics.saturated > 0) {
+            ++ltpa_data_.saturated_ascans;
+        }
+    }
+    return message;
+}
+
+
+void PeakHandler::decodeAll() {
+    for (int i = 0; i < (int)ltpa_data_.ascans.size(); i++) {
+        ascanAt(i);
+    }
+}
+
+
+void PeakHandler::setHugePages(const bool& use_huge_pages) {
+    // Applies from the next readMpsFile
+    use_huge_pages_ = use_huge_pages;
+}
+
+
+void PeakHandler::attachSubsetSelector(SubsetSelector* subset_selector) {
+    subset_selector_ = subset_selector;
+}
+
+
+void PeakHandler::attachTracer(FrameTracer* tracer) {
+    tracer_ = tracer;
+}
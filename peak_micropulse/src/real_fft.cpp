@@ -0,0 +1,150 @@
+#include "PeakMicroPulseHandler/real_fft.h"
+
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+
+
+RealFft::RealFft(const int& length)
+    :  length_(length),
+       half_(length / 2),
+       half_twiddles_(),
+       twiddles_(),
+       bit_reverse_()
+{
+    if (length_ < 4 or (length_ & (length_ - 1)) != 0) {
+        throw std::invalid_argument("RealFft length must be a power of two >= 4, got " + std::to_string(length_));
+    }
+
+    const double pi = std::acos(-1.0);
+
+    half_twiddles_.resize(half_ / 2);
+    for (int k = 0; k < half_ / 2; k++) {
+        half_twiddles_[k] = std::polar(1.0f, (float)(-2.0 * pi * k / half_));
+    }
+
+    twiddles_.resize(half_ / 2 + 1);
+    for (int k = 0; k <= half_ / 2; k++) {
+        twiddles_[k] = std::polar(1.0f, (float)(-2.0 * pi * k / length_));
+    }
+
+    int bits = 0;
+    while ((1 << bits) < half_) {
+        bits++;
+    }
+
+    bit_reverse_.resize(half_);
+    for (int i = 0; i < half_; i++) {
+        int reversed = 0;
+        for (int b = 0; b < bits; b++) {
+            reversed |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        bit_reverse_[i] = reversed;
+    }
+}
+
+
+int RealFft::nextPowerOfTwo(const int& n) {
+    int length = 4;
+    while (length < n) {
+        length <<= 1;
+    }
+    return length;
+}
+
+
+void RealFft::complexFft(std::complex<float>* data) const {
+    for (int i = 0; i < half_; i++) {
+        int j = bit_reverse_[i];
+        if (i < j) {
+            std::swap(data[i], data[j]);
+        }
+    }
+
+    for (int size = 2; size <= half_; size <<= 1) {
+        const int step = half_ / size;
+        const int span = size / 2;
+
+        for (int start = 0; start < half_; start += size) {
+            for (int k = 0; k < span; k++) {
+                std::complex<float> t = half_twiddles_[k * step] * data[start + k + span];
+                data[start + k + span] = data[start + k] - t;
+                data[start + k] += t;
+            }
+        }
+    }
+}
+
+
+size_t RealFft::footprint() const {
+    return (half_twiddles_.capacity() + twiddles_.capacity()) * sizeof(std::complex<float>) +
+           bit_reverse_.capacity() * sizeof(int);
+}
+
+
+void RealFft::forward(const float* input, std::complex<float>* output) const {
+    // Even samples to the real part and odd to the imaginary part
+    for (int k = 0; k < half_; k++) {
+        output[k] = std::complex<float>(input[2 * k], input[2 * k + 1]);
+    }
+
+    complexFft(output);
+
+    // Separate the two interleaved spectra, k and half - k together
+    const std::complex<float> z0 = output[0];
+    output[0] = std::complex<float>(z0.real() + z0.imag(), 0.0f);
+    output[half_] = std::complex<float>(z0.real() - z0.imag(), 0.0f);
+
+    const std::complex<float> minus_half_i(0.0f, -0.5f);
+
+    for (int k = 1; k <= half_ / 2; k++) {
+        const std::complex<float> zk = output[k];
+        const std::complex<float> zm = std::conj(output[half_ - k]);
+
+        const std::complex<float> even = 0.5f * (zk + zm);
+        const std::complex<float> odd = minus_half_i * (zk - zm);
+
+        output[k] = even + twiddles_[k] * odd;
+        if (k != half_ - k) {
+            output[half_ - k] = std::conj(even) - std::conj(twiddles_[k]) * std::conj(odd);
+        }
+    }
+}
+
+
+void RealFft::inverse(std::complex<float>* input, float* output) const {
+    // Recombine into the half length complex spectrum
+    const std::complex<float> x0 = input[0];
+    const std::complex<float> xn = input[half_];
+    input[0] = std::complex<float>(0.5f * (x0.real() + xn.real()), 0.5f * (x0.real() - xn.real()));
+
+    const std::complex<float> i_unit(0.0f, 1.0f);
+
+    for (int k = 1; k <= half_ / 2; k++) {
+        const std::complex<float> xk = input[k];
+        const std::complex<float> xm = std::conj(input[half_ - k]);
+
+        const std::complex<float> even = 0.5f * (xk + xm);
+        const std::complex<float> odd = 0.5f * (xk - xm) * std::conj(twiddles_[k]);
+        input[k] = even + i_unit * odd;
+
+        if (k != half_ - k) {
+            // Same relations for the mirrored bin, where the twiddle is -conj(W^k)
+            const std::complex<float> odd_m = -0.5f * std::conj(xm - xk) * twiddles_[k];
+            input[half_ - k] = std::conj(even) + i_unit * odd_m;
+        }
+    }
+
+    // Inverse by conjugation around the forward transform
+    for (int k = 0; k < half_; k++) {
+        input[k] = std::conj(input[k]);
+    }
+    complexFft(input);
+
+    const float scale = 1.0f / half_;
+    for (int k = 0; k < half_; k++) {
+        output[2 * k] = input[k].real() * scale;
+        output[2 * k + 1] = -input[k].imag() * scale;
+    }
+}
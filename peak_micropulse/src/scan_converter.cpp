@@ -0,0 +1,369 @@
+#include "PeakMicroPulseHandler/scan_converter.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__FMA__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+
+namespace {
+    const double pi = std::acos(-1.0);
+
+    // A beam traced through the layers above the specimen
+    struct Ray {
+        bool                           valid;
+        double                         entry;                 // mm, where it crosses the specimen surface
+        double                         surface_time;          // us, array to the surface and back
+        double                         slope;                 // mm across a mm of depth in the specimen
+        double                         time_per_depth;        // us a mm of depth in the specimen, there and back
+    };
+
+#if defined(__SSE2__)
+    inline __m128 multiplyAdd(const __m128& a, const __m128& b, const __m128& c) {
+#if defined(__FMA__)
+        return _mm_fmadd_ps(a, b, c);
+#else
+        return _mm_add_ps(_mm_mul_ps(a, b), c);
+#endif
+    }
+#endif
+}
+
+
+
+ScanConverter::ScanConverter(
+        const PeakHandler::OutputFormat& geometry,
+        const int& gate_start,
+        const std::vector<Beam>& beams,
+        const View& view,
+        const int& digitisation_rate/* = 0*/)
+    :  view_(view),
+       gate_start_(gate_start),
+       digitisation_rate_(digitisation_rate),
+       n_ascans_(beams.size()),
+       ascan_length_(std::max(geometry.ascan_length, 0)),
+       stride_(std::max(geometry.ascan_length, 0) + 2),
+       first_(),
+       second_(),
+       first_weight_(),
+       first_next_weight_(),
+       second_weight_(),
+       second_next_weight_(),
+       samples_(),
+       warned_(false)
+{
+    if (digitisation_rate_ <= 0.0) {
+        digitisation_rate_ = geometry.digitisation_rate > 0 ? geometry.digitisation_rate : 100;
+    }
+
+    if (geometry.vel_material <= 0.0) {
+        errorToConsole("ERROR - No material velocity, call setReconstructionConfiguration first");
+        return;
+    }
+    if (view_.width <= 0 or view_.height <= 0 or beams.empty() or ascan_length_ == 0) {
+        errorToConsole("ERROR - No beams, samples or pixels, nothing to convert");
+        return;
+    }
+
+    samples_.assign((size_t)n_ascans_ * stride_, 0);
+    build(geometry, beams);
+    logToConsole("Converting " + std::to_string(view_.width) + " x " + std::to_string(view_.height) + " pixels from " +
+                 std::to_string(n_ascans_) + " beams, " + std::to_string(footprint() / 1024) + " kB");
+}
+
+
+ScanConverter::ScanConverter(const PeakHandler& peak_handler, const View& view, const int& digitisation_rate/* = 0*/)
+    :  ScanConverter(*peak_handler.ltpa_data_ptr(), peak_handler.gate_start_,
+                     focalLawBeams(*peak_handler.ltpa_data_ptr(), peak_handler.focalLaws()), view, digitisation_rate)
+{
+}
+
+
+ScanConverter::~ScanConverter() {
+}
+
+
+void ScanConverter::logToConsole(const std::string& message) {
+    std::cout << "ScanConverter :: " << message << std::endl;
+}
+
+
+void ScanConverter::errorToConsole(const std::string& message) {
+    std::cout << "\033[31m";
+    std::cout << "ScanConverter :: " << message << std::endl;
+    std::cout << "\033[0m";
+}
+
+
+std::vector<ScanConverter::Beam> ScanConverter::focalLawBeams(
+        const PeakHandler::OutputFormat& geometry,
+        const PeakHandler::FocalLaws& focal_laws) {
+
+    // The delays steer the beam in the first layer under the array, the wedge adds its angle
+    const bool wedge = geometry.wedge_depth > 0.0 and geometry.vel_wedge > 0.0;
+    const bool couplant = geometry.couplant_depth > 0.0 and geometry.vel_couplant > 0.0;
+    const double first_velocity = (wedge ? geometry.vel_wedge : couplant ? geometry.vel_couplant : geometry.vel_material) / 1000.0;
+    const double incidence = wedge ? geometry.wedge_angle * pi / 180.0 : 0.0;
+
+    const auto meanDelay = [](const PeakHandler::FocalLaw& law) {
+        double sum = 0.0;
+        for (const double& delay : law.delays) {
+            sum += delay;
+        }
+        return law.delays.empty() ? 0.0 : sum / law.delays.size();
+    };
+
+    std::vector<Beam> beams;
+    for (int a = 0; a < geometry.num_a_scans; a++) {
+        const int test = focal_laws.first_test + a;
+        const PeakHandler::FocalLaw* transmit = focal_laws.transmitLaw(test);
+        if (transmit == nullptr or transmit->elements.empty()) {
+            beams.push_back({0.0, std::nan(""), 0.0});
+            continue;
+        }
+        const PeakHandler::FocalLaw& law = *transmit;
+
+        // Least squares line of delay against element position
+        double mean_position = 0.0;
+        for (const int& element : law.elements) {
+            mean_position += (element - 0.5 * (geometry.n_elements - 1)) * geometry.element_pitch;
+        }
+        mean_position /= law.elements.size();
+        const double mean_delay = meanDelay(law);
+        double covariance = 0.0;
+        double variance = 0.0;
+        for (size_t e = 0; e < law.elements.size(); e++) {
+            const double position = (law.elements[e] - 0.5 * (geometry.n_elements - 1)) * geometry.element_pitch - mean_position;
+            covariance += position * (law.delays[e] - mean_delay);
+            variance += position * position;
+        }
+        const double slope = variance > 0.0 ? covariance / variance : 0.0;         // us/mm
+
+        // Later elements fire later, tipping the wavefront towards them
+        const double steering = first_velocity * slope;
+        double angle = 90.0;
+        if (std::fabs(steering) < 1.0) {
+            const double sine = geometry.vel_material / 1000.0 / first_velocity * std::sin(std::asin(steering) + incidence);
+            angle = std::fabs(sine) < 1.0 ? std::asin(sine) * 180.0 / pi : 90.0;
+        }
+
+        // The receive law of the same test shifts the echo by its own mean delay
+        double delay = mean_delay;
+        const PeakHandler::FocalLaw* receive = focal_laws.receiveLaw(test);
+        delay += receive == nullptr ? 0.0 : meanDelay(*receive);
+        beams.push_back({mean_position, angle, delay});
+    }
+    return beams;
+}
+
+
+std::vector<ScanConverter::Beam> ScanConverter::linearBeams(const PeakHandler::OutputFormat& geometry, const int& aperture/* = 4*/) {
+    // Refracted by Snell's law from the wedge angle, or straight down without a wedge
+    double angle = 0.0;
+    if (geometry.wedge_depth > 0.0 and geometry.vel_wedge > 0.0) {
+        const double sine = geometry.vel_material / geometry.vel_wedge * std::sin(geometry.wedge_angle * pi / 180.0);
+        angle = std::fabs(sine) < 1.0 ? std::asin(sine) * 180.0 / pi : 90.0;
+    }
+
+    std::vector<Beam> beams;
+    for (int a = 0; a < geometry.num_a_scans; a++) {
+        const double centre = a + 0.5 * (aperture - 1);
+        beams.push_back({(centre - 0.5 * (geometry.n_elements - 1)) * geometry.element_pitch, angle, 0.0});
+    }
+    return beams;
+}
+
+
+std::vector<ScanConverter::Beam> ScanConverter::sectorBeams(
+        const PeakHandler::OutputFormat& geometry,
+        const double& centre_element,
+        const std::vector<double>& angles) {
+
+    std::vector<Beam> beams;
+    const double origin = (centre_element - 0.5 * (geometry.n_elements - 1)) * geometry.element_pitch;
+    for (const double& angle : angles) {
+        beams.push_back({origin, angle, 0.0});
+    }
+    return beams;
+}
+
+
+void ScanConverter::build(const PeakHandler::OutputFormat& geometry, const std::vector<Beam>& beams) {
+    const double material_velocity = geometry.vel_material / 1000.0;              // mm/us
+    const std::vector<std::pair<double, double>> layers = {
+        {geometry.wedge_depth, geometry.vel_wedge / 1000.0},
+        {geometry.couplant_depth, geometry.vel_couplant / 1000.0}
+    };
+
+    std::vector<Ray> rays;
+    int valid = 0;
+    for (const auto& beam : beams) {
+        const double angle = beam.angle * pi / 180.0;
+        Ray ray = {std::isfinite(angle) and std::fabs(angle) < 0.5 * pi, beam.origin, beam.delay, 0.0, 0.0};
+        const double ray_parameter = std::sin(angle) / material_velocity;
+        for (const auto& layer : layers) {
+            if (not ray.valid or layer.first <= 0.0 or layer.second <= 0.0) {
+                continue;
+            }
+            const double sine = ray_parameter * layer.second;
+            if (std::fabs(sine) >= 1.0) {
+                ray.valid = false;                            // Past the critical angle, never reaches the specimen
+                break;
+            }
+            const double cosine = std::sqrt(1.0 - sine * sine);
+            ray.entry += layer.first * sine / cosine;
+            ray.surface_time += 2.0 * layer.first / (layer.second * cosine);
+        }
+        ray.slope = std::tan(angle);
+        ray.time_per_depth = 2.0 / (material_velocity * std::cos(angle));
+        valid += ray.valid ? 1 : 0;
+        rays.push_back(ray);
+    }
+    if (valid < (int)rays.size()) {
+        errorToConsole("ERROR - " + std::to_string(rays.size() - valid) +
+                       " beams are past the critical angle or have no focal law and are left blank");
+    }
+
+    const size_t pixels = (size_t)view_.width * view_.height;
+    first_.assign(pixels, ascan_length_);                     // Blank pixels read the zeros after the first A-Scan
+    second_.assign(pixels, ascan_length_);
+    first_weight_.assign(pixels, 0.0f);
+    first_next_weight_.assign(pixels, 0.0f);
+    second_weight_.assign(pixels, 0.0f);
+    second_next_weight_.assign(pixels, 0.0f);
+
+    std::vector<std::pair<double, int>> crossings;            // Where each beam is at the row's depth
+    for (int iz = 0; iz < view_.height; iz++) {
+        const double z = view_.height > 1 ? view_.z_min + iz * (view_.z_max - view_.z_min) / (view_.height - 1) : view_.z_min;
+        if (z < 0.0) {
+            continue;
+        }
+
+        crossings.clear();
+        for (size_t k = 0; k < rays.size(); k++) {
+            if (rays[k].valid) {
+                crossings.emplace_back(rays[k].entry + z * rays[k].slope, k);
+            }
+        }
+        if (crossings.empty()) {
+            continue;
+        }
+        std::sort(crossings.begin(), crossings.end());
+
+        // Linear between the two samples either side of the round trip, a weight of zero off the gate
+        const auto sample = [&](const int& k, const double& weight, int32_t& index, float& this_weight, float& next_weight) {
+            const double position = (rays[k].surface_time + z * rays[k].time_per_depth) * digitisation_rate_ - gate_start_;
+            if (position >= 0.0 and position < ascan_length_ - 1) {
+                const double fraction = position - (int)position;
+                index = k * stride_ + (int)position;
+                this_weight = (float)(weight * (1.0 - fraction));
+                next_weight = (float)(weight * fraction);
+            }
+        };
+
+        for (int ix = 0; ix < view_.width; ix++) {
+            const double x = view_.width > 1 ? view_.x_min + ix * (view_.x_max - view_.x_min) / (view_.width - 1) : view_.x_min;
+            if (x < crossings.front().first or x > crossings.back().first) {
+                continue;
+            }
+
+            auto upper = std::upper_bound(crossings.begin(), crossings.end(), std::make_pair(x, (int)rays.size()));
+            if (upper == crossings.end()) {
+                upper--;
+            }
+            const auto lower = upper == crossings.begin() ? upper : upper - 1;
+            const double spacing = upper->first - lower->first;
+            const double across = spacing > 0.0 ? (x - lower->first) / spacing : 0.0;
+
+            const size_t p = (size_t)iz * view_.width + ix;
+            sample(lower->second, 1.0 - across, first_[p], first_weight_[p], first_next_weight_[p]);
+            sample(upper->second, across, second_[p], second_weight_[p], second_next_weight_[p]);
+        }
+    }
+}
+
+
+bool ScanConverter::load(const PeakHandler::OutputFormat& frame) {
+    if (first_.empty()) {
+        return false;
+    }
+    if ((int)frame.ascans.size() != n_ascans_) {
+        if (not warned_) {
+            errorToConsole("ERROR - Frames of " + std::to_string(frame.ascans.size()) + " A-Scans for " +
+                           std::to_string(n_ascans_) + " beams");
+            warned_ = true;
+        }
+        return false;
+    }
+
+    for (int a = 0; a < n_ascans_; a++) {
+        const PeakHandler::DofMessage& message = frame.ascans[a];
+        short int* row = &samples_[(size_t)a * stride_];
+
+        // Cropped A-Scans go back to their place in the gate, zeros either side. Samples are
+        // centred, DOF 1 sitting on a 128 offset, so amplitudes come out signed.
+        const int offset = std::min(std::max(message.header.sample_offset, 0), ascan_length_);
+        const int length = std::min((int)message.amps.size(), ascan_length_ - offset);
+        const int centre = PeakHandler::sampleOffset(message.header.dof);
+        std::fill(row, row + offset, 0);
+        for (int i = 0; i < length; i++) {
+            row[offset + i] = (short int)(message.amps[i] - centre);
+        }
+        std::fill(row + offset + length, row + stride_, 0);
+    }
+    return true;
+}
+
+
+void ScanConverter::gather(const size_t& begin, const size_t& end, float* amplitudes) const {
+    const short int* samples = samples_.data();
+    size_t p = begin;
+
+#if defined(__SSE2__)
+    // Four pixels at a time, the gathers stay scalar as SSE2 has none
+    for (; p + 4 <= end; p += 4) {
+        alignas(16) float first[4];
+        alignas(16) float first_next[4];
+        alignas(16) float second[4];
+        alignas(16) float second_next[4];
+        for (int j = 0; j < 4; j++) {
+            first[j] = samples[first_[p + j]];
+            first_next[j] = samples[first_[p + j] + 1];
+            second[j] = samples[second_[p + j]];
+            second_next[j] = samples[second_[p + j] + 1];
+        }
+
+        __m128 value = _mm_mul_ps(_mm_load_ps(first), _mm_loadu_ps(&first_weight_[p]));
+        value = multiplyAdd(_mm_load_ps(first_next), _mm_loadu_ps(&first_next_weight_[p]), value);
+        value = multiplyAdd(_mm_load_ps(second), _mm_loadu_ps(&second_weight_[p]), value);
+        value = multiplyAdd(_mm_load_ps(second_next), _mm_loadu_ps(&second_next_weight_[p]), value);
+        _mm_storeu_ps(amplitudes + (p - begin), value);
+    }
+#endif
+
+    for (; p < end; p++) {
+        amplitudes[p - begin] = samples[first_[p]] * first_weight_[p] + samples[first_[p] + 1] * first_next_weight_[p] +
+                                samples[second_[p]] * second_weight_[p] + samples[second_[p] + 1] * second_next_weight_[p];
+    }
+}
+
+
+bool ScanConverter::convert(const PeakHandler::OutputFormat& frame, std::vector<float>& amplitudes) {
+    if (not load(frame)) {
+        return false;
+    }
+    amplitudes.resize(first_.size());
+    gather(0, first_.size(), amplitudes.data());
+    return true;
+}
+
+
+size_t ScanConverter::footprint() const {
+    return first_.capacity() * sizeof(int32_t) * 2 + first_weight_.capacity() * sizeof(float) * 4 +
+           samples_.capacity() * sizeof(short int);
+}
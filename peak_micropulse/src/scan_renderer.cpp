@@ -0,0 +1,132 @@
+#include "PeakMicroPulseHandler/scan_renderer.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+
+namespace {
+    uint32_t rgba(const double& red, const double& green, const double& blue) {
+        return (uint32_t)std::lround(red) | (uint32_t)std::lround(green) << 8 | (uint32_t)std::lround(blue) << 16 | 0xFF000000u;
+    }
+}
+
+
+
+ScanRenderer::ScanRenderer(
+        const PeakHandler::OutputFormat& geometry,
+        const int& gate_start,
+        const std::vector<Beam>& beams,
+        const View& view,
+        const Palette& palette/* = amplitude*/,
+        const int& digitisation_rate/* = 0*/)
+    :  converter_(geometry, gate_start, beams, view, digitisation_rate),
+       block_amplitudes_(),
+       palette_(),
+       gain_(1.0)
+{
+    setPalette(palette);
+    setGain(0.0);
+}
+
+
+ScanRenderer::ScanRenderer(const PeakHandler& peak_handler, const View& view, const Palette& palette/* = amplitude*/)
+    :  converter_(peak_handler, view),
+       block_amplitudes_(),
+       palette_(),
+       gain_(1.0)
+{
+    setPalette(palette);
+    setGain(0.0);
+}
+
+
+ScanRenderer::~ScanRenderer() {
+}
+
+
+void ScanRenderer::logToConsole(const std::string& message) {
+    std::cout << "ScanRenderer :: " << message << std::endl;
+}
+
+
+void ScanRenderer::errorToConsole(const std::string& message) {
+    std::cout << "\033[31m";
+    std::cout << "ScanRenderer :: " << message << std::endl;
+    std::cout << "\033[0m";
+}
+
+
+void ScanRenderer::setGain(const double& gain_db) {
+    gain_ = std::pow(10.0, gain_db / 20.0);
+}
+
+
+void ScanRenderer::setPalette(const Palette& palette) {
+    // Colours at even steps of amplitude, blended linearly between
+    const std::vector<std::vector<double>> stops = palette == grey ?
+        std::vector<std::vector<double>>{{0, 0, 0}, {255, 255, 255}} :
+        std::vector<std::vector<double>>{{255, 255, 255}, {0, 128, 255}, {0, 200, 0}, {255, 255, 0}, {255, 0, 0}};
+
+    for (int i = 0; i < 256; i++) {
+        const double position = i / 255.0 * (stops.size() - 1);
+        const size_t stop = std::min((size_t)position, stops.size() - 2);
+        const double fraction = position - stop;
+        const std::vector<double>& from = stops[stop];
+        const std::vector<double>& to = stops[stop + 1];
+        palette_[i] = rgba(from[0] + fraction * (to[0] - from[0]),
+                           from[1] + fraction * (to[1] - from[1]),
+                           from[2] + fraction * (to[2] - from[2]));
+    }
+}
+
+
+bool ScanRenderer::render(const PeakHandler::OutputFormat& frame, Image& image) {
+    if (not converter_.load(frame)) {
+        return false;
+    }
+    image.width = converter_.view().width;
+    image.height = converter_.view().height;
+    image.pixels.resize(converter_.pixels());
+
+    // Full scale follows the frame's DOF, amplitudes are centred so 8 bit samples reach 127 and 16 bit 32767
+    const int full_scale = frame.ascans.empty() ? 0 : PeakHandler::fullScale(frame.ascans[0].header.dof);
+    const float scale_to_index = (float)(255.0 / (full_scale > 0 ? full_scale : 32767) * gain_);
+
+    uint32_t* pixels = image.pixels.data();
+    for (size_t begin = 0; begin < converter_.pixels(); begin += block_) {
+        const size_t end = std::min(begin + block_, converter_.pixels());
+        converter_.gather(begin, end, block_amplitudes_);
+        size_t p = begin;
+
+#if defined(__SSE2__)
+        const __m128 scale = _mm_set1_ps(scale_to_index);
+        const __m128 top = _mm_set1_ps(255.0f);
+        const __m128 magnitude = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+        for (; p + 4 <= end; p += 4) {
+            const __m128 value = _mm_load_ps(&block_amplitudes_[p - begin]);
+            const __m128i index = _mm_cvttps_epi32(_mm_min_ps(_mm_mul_ps(_mm_and_ps(value, magnitude), scale), top));
+
+            alignas(16) int32_t indices[4];
+            _mm_store_si128((__m128i*)indices, index);
+            for (int j = 0; j < 4; j++) {
+                pixels[p + j] = palette_[indices[j]];
+            }
+        }
+#endif
+
+        for (; p < end; p++) {
+            pixels[p] = palette_[(int)std::min(std::fabs(block_amplitudes_[p - begin]) * scale_to_index, 255.0f)];
+        }
+    }
+    return true;
+}
+
+
+size_t ScanRenderer::footprint() const {
+    return converter_.footprint() + sizeof(block_amplitudes_) + sizeof(palette_);
+}
@@ -0,0 +1,243 @@
+#include "PeakMicroPulseHandler/spectral_analyser.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+
+SpectralAnalyser::SpectralAnalyser(
+        const int& n_threads/* = 0*/,
+        const size_t& pool_size/* = 4*/,
+        const double& trend_weight/* = 0.05*/)
+    :  window_start_(0),
+       window_end_(0),
+       trend_weight_(trend_weight),
+       workers_(n_threads),
+       buffers_(pool_size),
+       plans_(),
+       windows_(),
+       input_scratch_(workers_.size()),
+       output_scratch_(workers_.size()),
+       trend_(),
+       tracer_(nullptr),
+       spectra_bytes_(0)
+{
+}
+
+
+SpectralAnalyser::~SpectralAnalyser() {
+}
+
+
+void SpectralAnalyser::logToConsole(const std::string& message) {
+    std::cout << "SpectralAnalyser :: " << message << std::endl;
+}
+
+
+void SpectralAnalyser::errorToConsole(const std::string& message) {
+    std::cout << "\033[31m";
+    std::cout << "SpectralAnalyser :: " << message << std::endl;
+    std::cout << "\033[0m";
+}
+
+
+void SpectralAnalyser::setWindow(const int& window_start, const int& window_end) {
+    window_start_ = window_start;
+    window_end_ = window_end;
+}
+
+
+const RealFft& SpectralAnalyser::plan(const int& length) {
+    auto it = plans_.find(length);
+    if (it == plans_.end()) {
+        logToConsole("Creating FFT plan of length " + std::to_string(length));
+        it = plans_.emplace(length, std::unique_ptr<RealFft>(new RealFft(length))).first;
+    }
+    return *it->second;
+}
+
+
+const std::vector<float>& SpectralAnalyser::hannWindow(const int& length) {
+    auto it = windows_.find(length);
+    if (it == windows_.end()) {
+        const double pi = std::acos(-1.0);
+        std::vector<float> window(length);
+        for (int i = 0; i < length; i++) {
+            window[i] = (float)(0.5 - 0.5 * std::cos(2.0 * pi * i / std::max(length - 1, 1)));
+        }
+        it = windows_.emplace(length, window).first;
+    }
+    return it->second;
+}
+
+
+void SpectralAnalyser::analyse(
+        const std::vector<short int>& amps,
+        const int& sample_offset,
+        const RealFft& fft,
+        const int& worker,
+        const double& bin_width,
+        float* magnitude,
+        float& centre_frequency,
+        float& bandwidth) {
+
+    const int start = std::min(std::max(window_start_ - sample_offset, 0), (int)amps.size());
+    const int end = window_end_ > window_start_ ? std::min(window_end_ - sample_offset, (int)amps.size()) : (int)amps.size();
+    const int length = std::max(end - start, 0);
+
+    std::vector<float>& input = input_scratch_[worker];
+    std::vector<std::complex<float>>& output = output_scratch_[worker];
+
+    // Remove the mean so the 8 bit offset does not land in the low bins
+    double mean = 0.0;
+    for (int i = start; i < end; i++) {
+        mean += amps[i];
+    }
+    mean = length > 0 ? mean / length : 0.0;
+
+    const std::vector<float>& window = windows_.at(length);
+    for (int i = 0; i < length; i++) {
+        input[i] = (float)(amps[start + i] - mean) * window[i];
+    }
+    std::fill(input.begin() + length, input.end(), 0.0f);
+
+    fft.forward(input.data(), output.data());
+
+    const int n_bins = fft.bins();
+    int peak = 1;
+    for (int k = 0; k < n_bins; k++) {
+        magnitude[k] = std::abs(output[k]);
+        if (k > 0 and magnitude[k] > magnitude[peak]) {
+            peak = k;
+        }
+    }
+
+    // -6 dB points either side of the peak, linearly interpolated between bins
+    const float half = 0.5f * magnitude[peak];
+    int lo = peak;
+    while (lo > 1 and magnitude[lo - 1] >= half) {
+        lo--;
+    }
+    int hi = peak;
+    while (hi < n_bins - 1 and magnitude[hi + 1] >= half) {
+        hi++;
+    }
+
+    double lo_bin = lo;
+    if (lo > 1 and magnitude[lo] > magnitude[lo - 1]) {
+        lo_bin = lo - (magnitude[lo] - half) / (magnitude[lo] - magnitude[lo - 1]);
+    }
+    double hi_bin = hi;
+    if (hi < n_bins - 1 and magnitude[hi] > magnitude[hi + 1]) {
+        hi_bin = hi + (magnitude[hi] - half) / (magnitude[hi] - magnitude[hi + 1]);
+    }
+
+    centre_frequency = (float)(0.5 * (lo_bin + hi_bin) * bin_width);
+    bandwidth = (float)((hi_bin - lo_bin) * bin_width);
+}
+
+
+size_t SpectralAnalyser::footprint() const {
+    // Every pooled buffer is counted at the size of the last frame's spectra
+    size_t bytes = buffers_.capacity() * spectra_bytes_;
+    for (const auto& plan : plans_) {
+        bytes += sizeof(RealFft) + plan.second->footprint();
+    }
+    for (const auto& window : windows_) {
+        bytes += window.second.capacity() * sizeof(float);
+    }
+    for (size_t w = 0; w < input_scratch_.size(); w++) {
+        bytes += input_scratch_[w].capacity() * sizeof(float) + output_scratch_[w].capacity() * sizeof(std::complex<float>);
+    }
+    bytes += trend_.size() * (sizeof(TrendKey) + sizeof(ChannelTrend));
+    return bytes;
+}
+
+
+void SpectralAnalyser::attachTracer(FrameTracer* tracer) {
+    tracer_ = tracer;
+}
+
+
+std::shared_ptr<const SpectralAnalyser::Spectra> SpectralAnalyser::process(const PeakHandler::OutputFormat& frame) {
+    const int n_ascans = frame.ascans.size();
+    if (n_ascans == 0) {
+        return nullptr;
+    }
+    const long long trace_start = tracer_ != nullptr ? FrameTracer::now() : 0;
+
+    // Plan, windows and scratch are prepared here so the workers only read them
+    int max_length = 0;
+    for (const auto& message : frame.ascans) {
+        const int size = message.amps.size();
+        const int offset = message.header.sample_offset;
+        const int start = std::min(std::max(window_start_ - offset, 0), size);
+        const int end = window_end_ > window_start_ ? std::min(window_end_ - offset, size) : size;
+        const int length = std::max(end - start, 0);
+        hannWindow(length);
+        max_length = std::max(max_length, length);
+    }
+
+    const RealFft& fft = plan(RealFft::nextPowerOfTwo(max_length));
+
+    for (int w = 0; w < workers_.size(); w++) {
+        input_scratch_[w].resize(fft.length());
+        output_scratch_[w].resize(fft.bins());
+    }
+
+    std::shared_ptr<Spectra> spectra = buffers_.acquire();
+    if (spectra == nullptr) {
+        errorToConsole("ERROR - All spectra buffers are in use, frame skipped");
+        return nullptr;
+    }
+
+    double sample_rate = frame.digitisation_rate;
+    if (sample_rate <= 0.0) {
+        // Frequencies in cycles per sample until the digitisation rate is known
+        sample_rate = 1.0;
+    }
+
+    spectra->n_ascans = n_ascans;
+    spectra->n_bins = fft.bins();
+    spectra->bin_width = sample_rate / fft.length();
+    spectra->magnitude.resize((size_t)n_ascans * spectra->n_bins);
+    spectra->centre_frequency.resize(n_ascans);
+    spectra->bandwidth.resize(n_ascans);
+    spectra_bytes_ = sizeof(Spectra) + spectra->magnitude.capacity() * sizeof(float) +
+                     (spectra->centre_frequency.capacity() + spectra->bandwidth.capacity()) * sizeof(float);
+
+    Spectra* output = spectra.get();
+    workers_.parallelFor(n_ascans, [&](const int& begin, const int& end, const int& worker) {
+        for (int i = begin; i < end; i++) {
+            analyse(
+                frame.ascans[i].amps,
+                frame.ascans[i].header.sample_offset,
+                fft,
+                worker,
+                output->bin_width,
+                &output->magnitude[(size_t)i * output->n_bins],
+                output->centre_frequency[i],
+                output->bandwidth[i]);
+        }
+    });
+
+    // Per test and receiving channel trend for probe health, so the receivers of a full matrix
+    // capture transmission are kept apart as well as the tests of a sweep
+    for (int i = 0; i < n_ascans; i++) {
+        const TrendKey key(frame.ascans[i].header.testNo, frame.ascans[i].header.channel);
+        auto it = trend_.find(key);
+        if (it == trend_.end()) {
+            trend_[key] = {spectra->centre_frequency[i], spectra->bandwidth[i], 1};
+        } else {
+            it->second.centre_frequency += trend_weight_ * (spectra->centre_frequency[i] - it->second.centre_frequency);
+            it->second.bandwidth += trend_weight_ * (spectra->bandwidth[i] - it->second.bandwidth);
+            it->second.frames++;
+        }
+    }
+
+    if (tracer_ != nullptr) {
+        tracer_->span("spectral analysis done", frame.frame_number, trace_start);
+    }
+
+    return spectra;
+}
@@ -0,0 +1,154 @@
+#include "PeakMicroPulseHandler/startup_orchestrator.h"
+
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+
+
+StartupOrchestrator::StartupOrchestrator(PeakHandler& peak_handler)
+    :  peak_handler_(peak_handler),
+       tasks_(),
+       phases_(),
+       start_(),
+       elapsed_(0.0)
+{
+}
+
+
+StartupOrchestrator::~StartupOrchestrator() {
+}
+
+
+void StartupOrchestrator::logToConsole(const std::string& message) {
+    std::cout << "StartupOrchestrator :: " << message << std::endl;
+}
+
+
+void StartupOrchestrator::errorToConsole(const std::string& message) {
+    std::cout << "\033[31m";
+    std::cout << "StartupOrchestrator :: " << message << std::endl;
+    std::cout << "\033[0m";
+}
+
+
+void StartupOrchestrator::addTask(const std::string& name, const std::function<void()>& task, const bool& after_mps/* = true*/) {
+    tasks_.push_back({name, task, after_mps});
+}
+
+
+double StartupOrchestrator::sinceStart() const {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_).count();
+}
+
+
+bool StartupOrchestrator::runPhase(Phase& phase, const std::function<bool()>& work) {
+    phase.start = sinceStart();
+    try {
+        phase.succeeded = work();
+    } catch (const std::exception& exception) {
+        errorToConsole("ERROR - " + phase.name + " threw: " + exception.what());
+        phase.succeeded = false;
+    } catch (...) {
+        errorToConsole("ERROR - " + phase.name + " threw");
+        phase.succeeded = false;
+    }
+    phase.end = sinceStart();
+    return phase.succeeded;
+}
+
+
+bool StartupOrchestrator::run(int digitisation_rate/* = 0*/) {
+    // Sized up front so each thread writes only its own entry
+    const size_t n_tasks = tasks_.size();
+    phases_.assign(n_tasks + 3, Phase{"", 0.0, 0.0, false});
+    Phase& read_mps = phases_[0];
+    Phase& reset = phases_[1];
+    Phase& send_mps = phases_[n_tasks + 2];
+    read_mps.name = "read MPS file";
+    reset.name = "connect and reset";
+    send_mps.name = "send MPS commands";
+    for (size_t i = 0; i < n_tasks; i++) {
+        phases_[i + 2].name = tasks_[i].name;
+    }
+
+    start_ = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < n_tasks; i++) {
+        if (not tasks_[i].after_mps) {
+            workers.emplace_back([this, i]() {
+                runPhase(phases_[i + 2], [this, i]() { tasks_[i].task(); return true; });
+            });
+        }
+    }
+
+    // Tasks needing the geometry follow the MPS file on their own threads
+    workers.emplace_back([this, n_tasks]() {
+        const bool mps_read = runPhase(phases_[0], [this]() { return peak_handler_.readMpsFile(); });
+
+        std::vector<std::thread> dependants;
+        for (size_t i = 0; i < n_tasks; i++) {
+            if (tasks_[i].after_mps and mps_read) {
+                dependants.emplace_back([this, i]() {
+                    runPhase(phases_[i + 2], [this, i]() { tasks_[i].task(); return true; });
+                });
+            }
+        }
+        for (auto& dependant : dependants) {
+            dependant.join();
+        }
+    });
+
+    // The reset is mostly waiting, so it stays on the calling thread
+    runPhase(reset, [this, digitisation_rate]() { peak_handler_.connect(digitisation_rate); return true; });
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    bool ready = true;
+    for (size_t i = 0; i < n_tasks + 2; i++) {
+        if (not phases_[i].succeeded) {
+            errorToConsole("ERROR - Startup phase failed or did not run: " + phases_[i].name);
+            ready = false;
+        }
+    }
+
+    if (ready) {
+        runPhase(send_mps, [this]() { peak_handler_.sendMpsConfiguration(); return true; });
+    }
+    elapsed_ = sinceStart();
+    return ready;
+}
+
+
+double StartupOrchestrator::serialTime() const {
+    double total = 0.0;
+    for (const auto& phase : phases_) {
+        total += phase.end - phase.start;
+    }
+    return total;
+}
+
+
+void StartupOrchestrator::report() {
+    auto milliseconds = [](const double& ms) {
+        std::ostringstream text;
+        text << std::fixed << std::setprecision(1) << std::setw(10) << ms << " ms";
+        return text.str();
+    };
+
+    logToConsole(" -------- Startup Phases --------");
+    for (const auto& phase : phases_) {
+        std::ostringstream name;
+        name << std::left << std::setw(24) << phase.name;
+        logToConsole(name.str() + milliseconds(phase.start) + milliseconds(phase.end) +
+                     (phase.succeeded ? "" : "  failed"));
+    }
+    logToConsole("Time to first frame     " + milliseconds(elapsed_));
+    logToConsole("Run serially            " + milliseconds(serialTime()));
+    logToConsole(" -------- ---------------- --------");
+}
@@ -0,0 +1,136 @@
+#include "PeakMicroPulseHandler/subset_selector.h"
+
+#include <algorithm>
+
+
+
+SubsetSelector::SubsetSelector()
+    :  test_numbers_(),
+       channels_(),
+       window_start_(0),
+       window_end_(0),
+       working_(),
+       published_()
+{
+}
+
+
+SubsetSelector::~SubsetSelector() {
+}
+
+
+void SubsetSelector::logToConsole(const std::string& message) {
+    std::cout << "SubsetSelector :: " << message << std::endl;
+}
+
+
+void SubsetSelector::errorToConsole(const std::string& message) {
+    std::cout << "\033[31m";
+    std::cout << "SubsetSelector :: " << message << std::endl;
+    std::cout << "\033[0m";
+}
+
+
+void SubsetSelector::selectTestNumbers(const std::vector<int>& test_numbers) {
+    test_numbers_.clear();
+    for (const int& test_number : test_numbers) {
+        if (test_number < 0 or test_number > 0xFFFF) {
+            errorToConsole("ERROR - Test number out of range: " + std::to_string(test_number));
+            continue;
+        }
+        if (test_number >= (int)test_numbers_.size()) {
+            test_numbers_.resize(test_number + 1, 0);
+        }
+        test_numbers_[test_number] = 1;
+    }
+}
+
+
+void SubsetSelector::selectChannels(const std::vector<int>& channels) {
+    channels_.clear();
+    for (const int& channel : channels) {
+        if (channel < 0 or channel > 0xFF) {
+            errorToConsole("ERROR - Channel out of range: " + std::to_string(channel));
+            continue;
+        }
+        if (channel >= (int)channels_.size()) {
+            channels_.resize(channel + 1, 0);
+        }
+        channels_[channel] = 1;
+    }
+}
+
+
+void SubsetSelector::setWindow(const int& window_start, const int& window_end) {
+    window_start_ = std::max(window_start, 0);
+    window_end_ = window_end;
+}
+
+
+bool SubsetSelector::selected(const int& test_number, const int& channel) const {
+    const bool test_selected = test_numbers_.empty() or
+        (test_number >= 0 and test_number < (int)test_numbers_.size() and test_numbers_[test_number]);
+    const bool channel_selected = channels_.empty() or
+        (channel >= 0 and channel < (int)channels_.size() and channels_[channel]);
+    return test_selected and channel_selected;
+}
+
+
+void SubsetSelector::beginFrame(const long& frame_number, const int& ascan_length, const int& max_rows) {
+    const int window_end = window_end_ > window_start_ ? std::min(window_end_, ascan_length) : ascan_length;
+
+    working_.frame_number = frame_number;
+    working_.rows = 0;
+    working_.window_start = window_start_;
+    working_.columns = std::max(window_end - window_start_, 0);
+
+    // Sized for every A-Scan once, so later frames do not allocate
+    working_.test_numbers.resize(max_rows);
+    working_.channels.resize(max_rows);
+    working_.samples.resize((size_t)max_rows * working_.columns);
+}
+
+
+void SubsetSelector::extract(const unsigned char* message, const PeakHandler::DofMessageHeader& header) {
+    if (not selected(header.testNo, header.channel) or working_.rows * working_.columns >= (int)working_.samples.size()) {
+        return;
+    }
+
+    const int row = working_.rows++;
+    working_.test_numbers[row] = header.testNo;
+    working_.channels[row] = header.channel;
+    short int* output = &working_.samples[(size_t)row * working_.columns];
+
+    // Only the window is unpacked, straight from the sub-header onwards
+    const int bytes_per_sample = header.dof == 4 ? 2 : 1;
+    const int n_samples = std::max((header.count - 8) / bytes_per_sample, 0);
+    const int end = std::min(working_.window_start + working_.columns, n_samples);
+    const unsigned char* samples = message + 8;
+
+    int column = 0;
+    if (header.dof == 4) {
+        for (int i = working_.window_start; i < end; i++) {
+            output[column++] = (short int)(samples[2 * i + 1] << 8 | samples[2 * i]);
+        }
+    } else {
+        for (int i = working_.window_start; i < end; i++) {
+            output[column++] = (short int)samples[i];
+        }
+    }
+    std::fill(output + column, output + working_.columns, 0);
+}
+
+
+void SubsetSelector::publish() {
+    std::swap(working_, published_);
+}
+
+
+size_t SubsetSelector::footprint() const {
+    size_t bytes = test_numbers_.capacity() + channels_.capacity();
+    for (const Matrix* matrix : {&working_, &published_}) {
+        bytes += (matrix->test_numbers.capacity() + matrix->channels.capacity()) * sizeof(int);
+        bytes += matrix->samples.capacity() * sizeof(short int);
+    }
+    return bytes;
+}
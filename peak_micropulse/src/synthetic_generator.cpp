@@ -0,0 +1,259 @@
+#include "PeakMicroPulseHandler/synthetic_generator.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+
+
+
+SyntheticGenerator::SyntheticGenerator(
+        const PeakHandler::OutputFormat& geometry,
+        const int& gate_start,
+        const int& dof,
+        const int& first_test,
+        const int& aperture/* = 4*/,
+        const double& centre_frequency/* = 5.0*/,
+        const int& digitisation_rate/* = 0*/)
+    :  geometry_(),
+       medium_(geometry),
+       gate_start_(gate_start),
+       dof_(dof),
+       first_test_(first_test),
+       aperture_(aperture),
+       centre_frequency_(centre_frequency),
+       digitisation_rate_(digitisation_rate),
+       ascan_length_(geometry.ascan_length),
+       num_a_scans_(geometry.num_a_scans),
+       message_length_(0),
+       fmc_(geometry.n_elements > 0 and geometry.num_a_scans == geometry.n_elements * geometry.n_elements),
+       scatterers_(),
+       interface_amplitude_(0.6),
+       backwall_amplitude_(0.3),
+       noise_level_(0.01f),
+       rng_state_(0x9E3779B97F4A7C15ULL),
+       built_(false),
+       frames_generated_(0),
+       templates_()
+{
+    PeakHandler::copyFrameMetadata(geometry, geometry_);
+
+    if (digitisation_rate_ <= 0.0) {
+        digitisation_rate_ = geometry.digitisation_rate > 0 ? geometry.digitisation_rate : 100;
+    }
+    geometry_.digitisation_rate = (int)digitisation_rate_;
+
+    message_length_ = 8 + (dof_ == 4 ? 2 : 1) * ascan_length_;
+
+    if (not medium_.valid()) {
+        errorToConsole("ERROR - No material velocity, call setReconstructionConfiguration first");
+    }
+}
+
+
+SyntheticGenerator::~SyntheticGenerator() {
+}
+
+
+void SyntheticGenerator::logToConsole(const std::string& message) {
+    std::cout << "SyntheticGenerator :: " << message << std::endl;
+}
+
+
+void SyntheticGenerator::errorToConsole(const std::string& message) {
+    std::cout << "\033[31m";
+    std::cout << "SyntheticGenerator :: " << message << std::endl;
+    std::cout << "\033[0m";
+}
+
+
+void SyntheticGenerator::addScatterer(const double& x, const double& z, const double& amplitude) {
+    scatterers_.push_back({x, z, amplitude});
+    built_ = false;
+}
+
+
+void SyntheticGenerator::setEchoAmplitudes(const double& interface_amplitude, const double& backwall_amplitude) {
+    interface_amplitude_ = interface_amplitude;
+    backwall_amplitude_ = backwall_amplitude;
+    built_ = false;
+}
+
+
+void SyntheticGenerator::setNoiseLevel(const double& noise_level) {
+    noise_level_ = (float)noise_level;
+}
+
+
+void SyntheticGenerator::setSeed(const unsigned long long& seed) {
+    rng_state_ = seed != 0 ? seed : 1;
+}
+
+
+void SyntheticGenerator::ascanElements(const int& ascan, double& tx, double& rx) const {
+    if (fmc_) {
+        tx = ascan / geometry_.n_elements;
+        rx = ascan % geometry_.n_elements;
+    } else {
+        // Centre of the sub-aperture, fired and received as one
+        tx = ascan + 0.5 * (aperture_ - 1);
+        rx = tx;
+    }
+}
+
+
+void SyntheticGenerator::addPulse(float* ascan, const double& time, const double& amplitude) const {
+    // Gaussian windowed cosine with 60 % fractional bandwidth at -6 dB
+    const double pi = std::acos(-1.0);
+    const double sigma = std::sqrt(2.0 * std::log(2.0)) / (pi * 0.6 * centre_frequency_);   // us
+    const double centre = time * digitisation_rate_ - gate_start_;                           // samples
+    const double half_width = 4.0 * sigma * digitisation_rate_;
+
+    const int start = std::max(0, (int)std::floor(centre - half_width));
+    const int end = std::min(ascan_length_, (int)std::ceil(centre + half_width) + 1);
+
+    for (int i = start; i < end; i++) {
+        const double t = (i - centre) / digitisation_rate_;
+        ascan[i] += (float)(amplitude * std::exp(-0.5 * t * t / (sigma * sigma)) * std::cos(2.0 * pi * centre_frequency_ * t));
+    }
+}
+
+
+void SyntheticGenerator::build() {
+    templates_.assign((size_t)num_a_scans_ * ascan_length_, 0.0f);
+
+    if (medium_.valid()) {
+        for (int a = 0; a < num_a_scans_; a++) {
+            float* ascan = &templates_[(size_t)a * ascan_length_];
+
+            double tx, rx;
+            ascanElements(a, tx, rx);
+            const double x_tx = medium_.elementPosition(tx);
+            const double x_rx = medium_.elementPosition(rx);
+            const double half_offset = 0.5 * (x_rx - x_tx);
+
+            // Specular reflections off the surface and backwall at the midpoint
+            addPulse(ascan, 2.0 * medium_.travelTime(half_offset, 0.0), interface_amplitude_);
+            addPulse(ascan, 2.0 * medium_.travelTime(half_offset, medium_.specimenDepth()), backwall_amplitude_);
+
+            for (const auto& scatterer : scatterers_) {
+                const double time = medium_.travelTime(scatterer.x - x_tx, scatterer.z) +
+                                    medium_.travelTime(scatterer.x - x_rx, scatterer.z);
+                // Cylindrical spreading in the specimen, normalised to 10 mm
+                const double spreading = std::sqrt(10.0 / std::max(scatterer.z, 1.0));
+                addPulse(ascan, time, scatterer.amplitude * spreading);
+            }
+        }
+    }
+
+    built_ = true;
+    logToConsole("Built " + std::to_string(num_a_scans_) + (fmc_ ? " FMC" : " sweep") +
+                 " A-Scans of " + std::to_string(ascan_length_) + " samples at " +
+                 std::to_string((int)digitisation_rate_) + " MHz");
+}
+
+
+float SyntheticGenerator::noise() {
+    // xorshift64*, its four 16 bit words summed for a near Gaussian value of unit variance
+    rng_state_ ^= rng_state_ >> 12;
+    rng_state_ ^= rng_state_ << 25;
+    rng_state_ ^= rng_state_ >> 27;
+    const unsigned long long value = rng_state_ * 0x2545F4914F6CDD1DULL;
+    const float sum = (float)((value & 0xFFFF) + ((value >> 16) & 0xFFFF) + ((value >> 32) & 0xFFFF) + (value >> 48));
+    return (sum * (1.0f / 65536.0f) - 2.0f) * 1.7320508f;
+}
+
+
+void SyntheticGenerator::generate(PeakHandler::OutputFormat& frame) {
+    if (not built_) {
+        build();
+    }
+
+    PeakHandler::copyFrameMetadata(geometry_, frame);
+    frame.frame_number = frames_generated_++;
+    frame.saturated_ascans = 0;
+    frame.coupling_lost = false;
+    frame.coupling_failures.clear();
+    frame.ascans.resize(num_a_scans_);
+
+    const float offset = (float)PeakHandler::sampleOffset(dof_);
+    const float scale = (float)PeakHandler::fullScale(dof_);
+    const float low = dof_ == 4 ? (float)SHRT_MIN : 0.0f;
+    const float high = dof_ == 4 ? (float)SHRT_MAX : 255.0f;
+
+    for (int a = 0; a < num_a_scans_; a++) {
+        PeakHandler::DofMessage& message = frame.ascans[a];
+        double tx, rx;
+        ascanElements(a, tx, rx);
+
+        message.header.header = PeakHandler::ascan;
+        message.header.count = message_length_;
+        message.header.testNo = first_test_ - 1 + (fmc_ ? (int)tx : a);
+        message.header.dof = dof_;
+        message.header.channel = fmc_ ? (int)rx : 0;
+        message.header.sample_offset = 0;
+        message.amps.resize(ascan_length_);
+
+        // Statistics as PeakHandler computes them at its default saturation level
+        const float* ascan = &templates_[(size_t)a * ascan_length_];
+        PeakHandler::StatisticsAccumulator statistics(dof_, PeakHandler::fullScale(dof_));
+
+        for (int i = 0; i < ascan_length_; i++) {
+            float value = offset + scale * (ascan[i] + noise_level_ * noise());
+            value = std::min(std::max(value, low), high);
+            const short int amp = (short int)value;
+
+            message.amps[i] = amp;
+            statistics.add(amp);
+        }
+        message.header.statistics = statistics.statistics();
+
+        if (message.header.statistics.saturated > 0) {
+            frame.saturated_ascans++;
+        }
+    }
+}
+
+
+void SyntheticGenerator::generatePacket(std::vector<unsigned char>& packet) {
+    if (not built_) {
+        build();
+    }
+
+    packet.resize(packetLength());
+
+    for (int a = 0; a < num_a_scans_; a++) {
+        unsigned char* bytes = &packet[(size_t)a * message_length_];
+        double tx, rx;
+        ascanElements(a, tx, rx);
+
+        const int reported_test = first_test_ - 1 + (fmc_ ? (int)tx : a);
+        const int channel = fmc_ ? (int)rx : 0;
+
+        bytes[0] = 0x1A;
+        bytes[1] = message_length_ & 0xFF;
+        bytes[2] = (message_length_ >> 8) & 0xFF;
+        bytes[3] = (message_length_ >> 16) & 0xFF;
+        bytes[4] = reported_test & 0xFF;
+        bytes[5] = (reported_test >> 8) & 0xFF;
+        bytes[6] = dof_;
+        bytes[7] = channel & 0xFF;
+
+        const float* ascan = &templates_[(size_t)a * ascan_length_];
+
+        if (dof_ == 4) {
+            for (int i = 0; i < ascan_length_; i++) {
+                float value = 32767.0f * (ascan[i] + noise_level_ * noise());
+                value = std::min(std::max(value, (float)SHRT_MIN), (float)SHRT_MAX);
+                const short int amp = (short int)value;
+                bytes[8 + 2 * i] = amp & 0xFF;
+                bytes[8 + 2 * i + 1] = (amp >> 8) & 0xFF;
+            }
+        } else {
+            for (int i = 0; i < ascan_length_; i++) {
+                float value = (float)PeakHandler::sampleOffset(1) + (float)PeakHandler::fullScale(1) * (ascan[i] + noise_level_ * noise());
+                bytes[8 + i] = (unsigned char)std::min(std::max(value, 0.0f), 255.0f);
+            }
+        }
+    }
+}
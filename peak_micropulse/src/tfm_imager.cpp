@@ -0,0 +1,373 @@
+#include "PeakMicroPulseHandler/tfm_imager.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+
+const TfmImager::Mode TfmImager::direct = {{longitudinal}, {longitudinal}};
+const TfmImager::Mode TfmImager::half_skip = {{longitudinal, longitudinal}, {longitudinal}};
+const TfmImager::Mode TfmImager::full_skip = {{longitudinal, longitudinal}, {longitudinal, longitudinal}};
+
+
+TfmImager::TfmImager(
+        const PeakHandler::OutputFormat& geometry,
+        const int& gate_start,
+        const Grid& grid,
+        const Tile& tile/* = {0, 0, 0, 0}*/,
+        const int& n_threads/* = 0*/,
+        const int& digitisation_rate/* = 0*/)
+    :  workers_(n_threads),
+       medium_(geometry),
+       grid_(grid),
+       tile_(tile),
+       n_elements_(geometry.n_elements),
+       ascan_length_(std::max(geometry.ascan_length, 0)),
+       gate_start_(gate_start),
+       digitisation_rate_(digitisation_rate),
+       stride_(std::max(geometry.ascan_length, 0) + 2),
+       shear_velocity_(0.0),
+       modes_(1, direct),
+       mode_tables_(),
+       n_tables_(0),
+       delays_(),
+       samples_(),
+       sums_(workers_.size()),
+       warned_(false)
+{
+    if (digitisation_rate_ <= 0.0) {
+        digitisation_rate_ = geometry.digitisation_rate > 0 ? geometry.digitisation_rate : 100;
+    }
+
+    if (tile_.nx <= 0 or tile_.nz <= 0) {
+        tile_ = {0, 0, grid_.nx, grid_.nz};
+    }
+    tile_.x0 = std::min(std::max(tile_.x0, 0), std::max(grid_.nx, 0));
+    tile_.z0 = std::min(std::max(tile_.z0, 0), std::max(grid_.nz, 0));
+    tile_.nx = std::min(tile_.nx, grid_.nx - tile_.x0);
+    tile_.nz = std::min(tile_.nz, grid_.nz - tile_.z0);
+
+    if (not medium_.valid()) {
+        errorToConsole("ERROR - No material velocity, call setReconstructionConfiguration first");
+        return;
+    }
+    if (n_elements_ <= 0 or tile_.nx <= 0 or tile_.nz <= 0) {
+        errorToConsole("ERROR - No elements or an empty grid, nothing to image");
+        return;
+    }
+
+    buildDelays();
+    samples_.assign((size_t)n_elements_ * n_elements_ * stride_, 0.0f);
+    logToConsole("Imaging " + std::to_string(tile_.nx) + " x " + std::to_string(tile_.nz) + " pixels from " +
+                 std::to_string(n_elements_) + " elements, " + std::to_string(footprint() / (1024 * 1024)) + " MB");
+}
+
+
+TfmImager::~TfmImager() {
+}
+
+
+void TfmImager::logToConsole(const std::string& message) {
+    std::cout << "TfmImager :: " << message << std::endl;
+}
+
+
+void TfmImager::errorToConsole(const std::string& message) {
+    std::cout << "\033[31m";
+    std::cout << "TfmImager :: " << message << std::endl;
+    std::cout << "\033[0m";
+}
+
+
+double TfmImager::pixelX(const int& ix) const {
+    return grid_.nx > 1 ? grid_.x_min + ix * (grid_.x_max - grid_.x_min) / (grid_.nx - 1) : grid_.x_min;
+}
+
+
+double TfmImager::pixelZ(const int& iz) const {
+    return grid_.nz > 1 ? grid_.z_min + iz * (grid_.z_max - grid_.z_min) / (grid_.nz - 1) : grid_.z_min;
+}
+
+
+bool TfmImager::parseMode(const std::string& name, Mode& mode) {
+    std::vector<Wave> waves;
+    int split = -1;
+    for (const char& letter : name) {
+        if (letter == 'L' or letter == 'T') {
+            waves.push_back(letter == 'L' ? longitudinal : transverse);
+        } else if (letter == '-' and split < 0) {
+            split = waves.size();
+        } else {
+            return false;
+        }
+    }
+
+    // Without a hyphen the transmit leg takes the skip, if there is only one
+    if (split < 0) {
+        split = waves.size() == 2 ? 1 : 2;
+    }
+    if (split < 1 or split > 2 or (int)waves.size() - split < 1 or (int)waves.size() - split > 2) {
+        return false;
+    }
+    mode.transmit.assign(waves.begin(), waves.begin() + split);
+    mode.receive.assign(waves.begin() + split, waves.end());
+    return true;
+}
+
+
+std::string TfmImager::modeName(const Mode& mode) {
+    std::string name;
+    for (const Wave& wave : mode.transmit) {
+        name += wave == longitudinal ? 'L' : 'T';
+    }
+    if (mode.transmit.size() < mode.receive.size()) {
+        name += '-';
+    }
+    for (const Wave& wave : mode.receive) {
+        name += wave == longitudinal ? 'L' : 'T';
+    }
+    return name;
+}
+
+
+bool TfmImager::setShearVelocity(const double& vel_shear) {
+    if (not (vel_shear > 0.0)) {
+        for (const Mode& mode : modes_) {
+            const std::string name = modeName(mode);
+            if (name.find('T') != std::string::npos) {
+                errorToConsole("ERROR - " + name + " has shear segments, the shear velocity has to be positive");
+                return false;
+            }
+        }
+    }
+    shear_velocity_ = std::max(vel_shear, 0.0) / 1000.0;
+    if (valid()) {
+        buildDelays();
+    }
+    return true;
+}
+
+
+bool TfmImager::setModes(const std::vector<std::string>& names) {
+    std::vector<Mode> modes(names.size());
+    for (size_t m = 0; m < names.size(); m++) {
+        if (not parseMode(names[m], modes[m])) {
+            errorToConsole("ERROR - " + names[m] + " is not a mode, name the wave of each segment as in TT, TTT or TLT");
+            return false;
+        }
+    }
+    return setModes(modes);
+}
+
+
+bool TfmImager::setModes(const std::vector<Mode>& modes) {
+    if (modes.empty()) {
+        errorToConsole("ERROR - No modes to image");
+        return false;
+    }
+    for (const Mode& mode : modes) {
+        const std::string name = modeName(mode);
+        if (mode.transmit.empty() or mode.receive.empty() or mode.transmit.size() > 2 or mode.receive.size() > 2) {
+            errorToConsole("ERROR - " + name + " does not have one or two segments each way");
+            return false;
+        }
+        if ((mode.transmit.size() > 1 or mode.receive.size() > 1) and not (medium_.specimenDepth() > 0.0)) {
+            errorToConsole("ERROR - " + name + " skips off the backwall, call setReconstructionConfiguration with the specimen depth first");
+            return false;
+        }
+        if (name.find('T') != std::string::npos and not (shear_velocity_ > 0.0)) {
+            errorToConsole("ERROR - " + name + " has shear segments, call setShearVelocity first");
+            return false;
+        }
+    }
+    modes_ = modes;
+    if (valid()) {
+        buildDelays();
+        std::string names;
+        for (const Mode& mode : modes_) {
+            names += (names.empty() ? "" : ", ") + modeName(mode);
+        }
+        logToConsole("Imaging " + names + " from " + std::to_string(n_tables_) + " delay tables, " +
+                     std::to_string(footprint() / (1024 * 1024)) + " MB");
+    }
+    return true;
+}
+
+
+std::vector<TfmImager::Tile> TfmImager::bands(const Grid& grid, const int& n_bands) {
+    std::vector<Tile> tiles;
+    const int n = std::max(1, std::min(n_bands, grid.nz));
+    for (int i = 0; i < n; i++) {
+        const int z0 = (int)((long)grid.nz * i / n);
+        const int z1 = (int)((long)grid.nz * (i + 1) / n);
+        tiles.push_back({0, z0, grid.nx, z1 - z0});
+    }
+    return tiles;
+}
+
+
+void TfmImager::buildDelays() {
+    const size_t pixels = (size_t)tile_.nx * tile_.nz;
+
+    // A table for each different leg the modes take, shared by every mode taking it
+    std::vector<std::vector<Wave>> legs;
+    const auto table = [&](const std::vector<Wave>& leg) {
+        const auto found = std::find(legs.begin(), legs.end(), leg);
+        if (found != legs.end()) {
+            return (int)(found - legs.begin());
+        }
+        legs.push_back(leg);
+        return (int)legs.size() - 1;
+    };
+    mode_tables_.clear();
+    for (const Mode& mode : modes_) {
+        const int transmit_table = table(mode.transmit);
+        mode_tables_.emplace_back(transmit_table, table(mode.receive));
+    }
+    n_tables_ = legs.size();
+    delays_.resize((size_t)n_tables_ * n_elements_ * pixels);
+
+    // One travel time solve per table, element and pixel, so the frames only read them back.
+    // Pixels under the backwall are never reached by a skip, their delays put them off the gate.
+    const double backwall = medium_.specimenDepth();
+    workers_.parallelFor(n_tables_ * n_elements_, [&](const int& begin, const int& end, const int& /*worker*/) {
+        for (int i = begin; i < end; i++) {
+            const std::vector<Wave>& leg = legs[i / n_elements_];
+            LayeredMedium::Layer segments[2];
+            for (size_t s = 0; s < leg.size(); s++) {
+                segments[s].velocity = leg[s] == longitudinal ? medium_.materialVelocity() : shear_velocity_;
+            }
+
+            const double x_element = medium_.elementPosition(i % n_elements_);
+            float* delay = &delays_[i * pixels];
+            for (int iz = 0; iz < tile_.nz; iz++) {
+                const double z = pixelZ(tile_.z0 + iz);
+                const bool reached = leg.size() == 1 or z <= backwall;
+                segments[0].thickness = leg.size() == 1 ? z : backwall;
+                segments[1].thickness = backwall - z;
+                for (int ix = 0; ix < tile_.nx; ix++) {
+                    *delay++ = reached ?
+                        (float)(medium_.travelTime(pixelX(tile_.x0 + ix) - x_element, segments, leg.size()) * digitisation_rate_) :
+                        -1.0e9f;
+                }
+            }
+        }
+    });
+}
+
+
+void TfmImager::loadSamples(const PeakHandler::OutputFormat& frame, const int& slot) {
+    float* samples = &samples_[(size_t)slot * n_elements_ * n_elements_ * stride_];
+    workers_.parallelFor(frame.ascans.size(), [&](const int& begin, const int& end, const int& /*worker*/) {
+        for (int a = begin; a < end; a++) {
+            const PeakHandler::DofMessage& message = frame.ascans[a];
+            float* row = &samples[(size_t)a * stride_];
+
+            // Cropped A-Scans go back to their place in the gate, zeros either side
+            const int offset = std::min(std::max(message.header.sample_offset, 0), ascan_length_);
+            const int length = std::min((int)message.amps.size(), ascan_length_ - offset);
+            std::fill(row, row + offset, 0.0f);
+            for (int i = 0; i < length; i++) {
+                row[offset + i] = message.amps[i];
+            }
+            std::fill(row + offset + length, row + stride_, 0.0f);
+        }
+    });
+}
+
+
+bool TfmImager::process(const PeakHandler::OutputFormat& frame, Image& image) {
+    const PeakHandler::OutputFormat* frames[1] = {&frame};
+    return compound(frames, 1, image);
+}
+
+
+bool TfmImager::process(const std::vector<const PeakHandler::OutputFormat*>& frames, Image& image) {
+    return compound(frames.data(), frames.size(), image);
+}
+
+
+bool TfmImager::compound(const PeakHandler::OutputFormat* const* frames, const int& n_frames, Image& image) {
+    if (not valid() or n_frames <= 0) {
+        return false;
+    }
+    const int pairs = n_elements_ * n_elements_;
+    for (int f = 0; f < n_frames; f++) {
+        if ((int)frames[f]->ascans.size() != pairs) {
+            if (not warned_) {
+                errorToConsole("ERROR - Frames of " + std::to_string(frames[f]->ascans.size()) + " A-Scans are not full matrix capture of " +
+                               std::to_string(n_elements_) + " elements");
+                warned_ = true;
+            }
+            return false;
+        }
+    }
+
+    // Grows once to the most frames compounded, then reused
+    if (samples_.size() < (size_t)n_frames * pairs * stride_) {
+        samples_.resize((size_t)n_frames * pairs * stride_, 0.0f);
+    }
+    for (int f = 0; f < n_frames; f++) {
+        loadSamples(*frames[f], f);
+    }
+
+    image.frame_number = frames[n_frames - 1]->frame_number;
+    image.tile = tile_;
+    image.pixels.resize((size_t)tile_.nx * tile_.nz);
+
+    const size_t pixels = (size_t)tile_.nx * tile_.nz;
+    const int nx = tile_.nx;
+    const int n_modes = modes_.size();
+    const float gate = (float)gate_start_;
+    const float last = (float)(ascan_length_ - 1);
+    const int zero = ascan_length_;                           // Index of the zeros past the A-Scan
+    const float scale = 1.0f / (n_frames * n_modes);
+
+    workers_.parallelFor(tile_.nz, [&](const int& begin, const int& end, const int& worker) {
+        const int n = (end - begin) * nx;
+        std::vector<float>& sums = sums_[worker];
+        sums.assign((size_t)n * n_modes, 0.0f);
+
+        // Pairs outermost so each A-Scan stays in cache while the worker's rows read it for
+        // every mode, the modes' sums kept apart until the end
+        for (int f = 0; f < n_frames; f++) {
+            for (int tx = 0; tx < n_elements_; tx++) {
+                for (int rx = 0; rx < n_elements_; rx++) {
+                    const float* ascan = &samples_[((size_t)f * pairs + tx * n_elements_ + rx) * stride_];
+                    for (int m = 0; m < n_modes; m++) {
+                        const float* tx_delay = &delays_[((size_t)mode_tables_[m].first * n_elements_ + tx) * pixels + (size_t)begin * nx];
+                        const float* rx_delay = &delays_[((size_t)mode_tables_[m].second * n_elements_ + rx) * pixels + (size_t)begin * nx];
+                        float* sum = &sums[(size_t)m * n];
+
+                        for (int p = 0; p < n; p++) {
+                            const float position = tx_delay[p] + rx_delay[p] - gate;
+                            const bool inside = position >= 0.0f and position < last;
+                            const int i = inside ? (int)position : zero;
+                            const float fraction = inside ? position - (float)i : 0.0f;
+                            sum[p] += ascan[i] + fraction * (ascan[i + 1] - ascan[i]);
+                        }
+                    }
+                }
+            }
+        }
+
+        float* output = &image.pixels[(size_t)begin * nx];
+        for (int p = 0; p < n; p++) {
+            float magnitude = 0.0f;
+            for (int m = 0; m < n_modes; m++) {
+                magnitude += std::fabs(sums[(size_t)m * n + p]);
+            }
+            output[p] = magnitude * scale;
+        }
+    });
+    return true;
+}
+
+
+size_t TfmImager::footprint() const {
+    size_t bytes = (delays_.capacity() + samples_.capacity()) * sizeof(float);
+    for (const auto& sums : sums_) {
+        bytes += sums.capacity() * sizeof(float);
+    }
+    return bytes;
+}
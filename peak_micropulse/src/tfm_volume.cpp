@@ -0,0 +1,221 @@
+#include "PeakMicroPulseHandler/tfm_volume.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+
+TfmVolume::TfmVolume(
+        const TfmImager::Grid& grid,
+        const double& scan_start,
+        const double& scan_step,
+        const int& brick_size/* = 16*/,
+        const float& threshold/* = 0.0f*/,
+        const int& max_slices/* = 16384*/)
+    :  grid_(grid),
+       scan_start_(scan_start),
+       scan_step_(scan_step),
+       brick_size_(std::max(brick_size, 1)),
+       bricks_x_((std::max(grid.nx, 0) + std::max(brick_size, 1) - 1) / std::max(brick_size, 1)),
+       bricks_z_((std::max(grid.nz, 0) + std::max(brick_size, 1) - 1) / std::max(brick_size, 1)),
+       threshold_(threshold),
+       max_slices_(std::max(max_slices, 1)),
+       n_slices_(0),
+       frames_(0),
+       directory_(),
+       bricks_(),
+       depth_max_(),
+       depth_sum_(),
+       scan_max_(),
+       scan_sum_(),
+       lateral_max_(),
+       lateral_sum_(),
+       warned_(false)
+{
+    if (grid_.nx <= 0 or grid_.nz <= 0 or not (scan_step_ > 0.0)) {
+        errorToConsole("ERROR - The grid needs pixels and the scan a positive step");
+        return;
+    }
+    clear();
+}
+
+
+TfmVolume::~TfmVolume() {
+}
+
+
+void TfmVolume::logToConsole(const std::string& message) {
+    std::cout << "TfmVolume :: " << message << std::endl;
+}
+
+
+void TfmVolume::errorToConsole(const std::string& message) {
+    std::cout << "\033[31m";
+    std::cout << "TfmVolume :: " << message << std::endl;
+    std::cout << "\033[0m";
+}
+
+
+void TfmVolume::clear() {
+    n_slices_ = 0;
+    frames_ = 0;
+    directory_.clear();
+    bricks_.clear();
+    depth_max_.clear();
+    depth_sum_.clear();
+    lateral_max_.clear();
+    lateral_sum_.clear();
+    scan_max_.assign((size_t)std::max(grid_.nx, 0) * std::max(grid_.nz, 0), 0.0f);
+    scan_sum_.assign(scan_max_.size(), 0.0);
+}
+
+
+void TfmVolume::addSlices(const int& n_slices) {
+    n_slices_ += n_slices;
+    const size_t scan_bricks = (n_slices_ + brick_size_ - 1) / brick_size_;
+    directory_.resize(scan_bricks * bricks_z_ * bricks_x_, -1);
+    depth_max_.resize((size_t)n_slices_ * grid_.nx, 0.0f);
+    depth_sum_.resize(depth_max_.size(), 0.0);
+    lateral_max_.resize((size_t)n_slices_ * grid_.nz, 0.0f);
+    lateral_sum_.resize(lateral_max_.size(), 0.0);
+}
+
+
+float* TfmVolume::brick(const int& ix, const int& iz, const int& iy) {
+    int32_t& index = directory_[((size_t)(iy / brick_size_) * bricks_z_ + iz / brick_size_) * bricks_x_ + ix / brick_size_];
+    if (index < 0) {
+        const size_t voxels = (size_t)brick_size_ * brick_size_ * brick_size_;
+        bricks_.emplace_back(new float[voxels]);
+        std::fill(bricks_.back().get(), bricks_.back().get() + voxels, 0.0f);
+        index = bricks_.size() - 1;
+    }
+    return bricks_[index].get();
+}
+
+
+bool TfmVolume::add(const TfmImager::Image& image, const double& position) {
+    const TfmImager::Tile& tile = image.tile;
+    // A glitching encoder can report any position, each slice up to it would be allocated
+    const double slice_position = std::isfinite(position) ? std::round((position - scan_start_) / scan_step_) : -1.0;
+    if (scan_max_.empty() or not (slice_position >= 0.0 and slice_position < max_slices_) or
+        tile.x0 < 0 or tile.z0 < 0 or tile.x0 + tile.nx > grid_.nx or tile.z0 + tile.nz > grid_.nz or
+        (long)image.pixels.size() != (long)tile.nx * tile.nz) {
+        if (not warned_) {
+            errorToConsole("ERROR - Image at " + std::to_string(position) + " mm is off the volume or not a tile of its grid");
+            warned_ = true;
+        }
+        return false;
+    }
+    const int iy = (int)slice_position;
+    if (iy >= n_slices_) {
+        addSlices(iy + 1 - n_slices_);
+    }
+
+    const int nx = grid_.nx;
+    const int nz = grid_.nz;
+    const int y_offset = (iy % brick_size_) * brick_size_ * brick_size_;
+    float* depth_max = &depth_max_[(size_t)iy * nx];
+    double* depth_sum = &depth_sum_[(size_t)iy * nx];
+    float* lateral_max = &lateral_max_[(size_t)iy * nz];
+    double* lateral_sum = &lateral_sum_[(size_t)iy * nz];
+
+    for (int row = 0; row < tile.nz; row++) {
+        const int iz = tile.z0 + row;
+        const float* pixels = &image.pixels[(size_t)row * tile.nx];
+        const int z_offset = y_offset + (iz % brick_size_) * brick_size_;
+
+        float* voxels = nullptr;
+        for (int column = 0; column < tile.nx; column++) {
+            const int ix = tile.x0 + column;
+            const float value = pixels[column];
+            if (ix % brick_size_ == 0) {
+                voxels = nullptr;                             // Into the next brick along the row
+            }
+            if (not (value > 0.0f) or value < threshold_) {
+                continue;
+            }
+            if (voxels == nullptr) {
+                voxels = brick(ix, iz, iy) + z_offset;
+            }
+
+            // Peak hold, so the projections only ever grow
+            float& voxel = voxels[ix % brick_size_];
+            if (value <= voxel) {
+                continue;
+            }
+            const double increase = value - voxel;
+            voxel = value;
+
+            const size_t side = (size_t)iz * nx + ix;
+            depth_max[ix] = std::max(depth_max[ix], value);
+            depth_sum[ix] += increase;
+            scan_max_[side] = std::max(scan_max_[side], value);
+            scan_sum_[side] += increase;
+            lateral_max[iz] = std::max(lateral_max[iz], value);
+            lateral_sum[iz] += increase;
+        }
+    }
+    frames_++;
+    return true;
+}
+
+
+void TfmVolume::project(const Axis& axis, const Statistic& statistic, Projection& projection) const {
+    const std::vector<float>& maxima = axis == depth ? depth_max_ : axis == scan ? scan_max_ : lateral_max_;
+    const std::vector<double>& sums = axis == depth ? depth_sum_ : axis == scan ? scan_sum_ : lateral_sum_;
+    const int across = axis == depth ? grid_.nz : axis == scan ? n_slices_ : grid_.nx;     // Voxels projected onto a pixel
+
+    projection.width = axis == lateral ? grid_.nz : grid_.nx;
+    projection.height = axis == scan ? grid_.nz : n_slices_;
+    projection.pixels.resize(maxima.size());
+    if (statistic == maximum) {
+        std::copy(maxima.begin(), maxima.end(), projection.pixels.begin());
+        return;
+    }
+    const double scale = across > 0 ? 1.0 / across : 0.0;
+    for (size_t p = 0; p < sums.size(); p++) {
+        projection.pixels[p] = (float)(sums[p] * scale);
+    }
+}
+
+
+void TfmVolume::slice(const int& iy, Projection& projection) const {
+    projection.width = grid_.nx;
+    projection.height = grid_.nz;
+    projection.pixels.assign((size_t)std::max(grid_.nx, 0) * std::max(grid_.nz, 0), 0.0f);
+    if (iy < 0 or iy >= n_slices_) {
+        return;
+    }
+
+    const int y_offset = (iy % brick_size_) * brick_size_ * brick_size_;
+    for (int iz = 0; iz < grid_.nz; iz++) {
+        for (int bx = 0; bx < bricks_x_; bx++) {
+            const int32_t index = directory_[((size_t)(iy / brick_size_) * bricks_z_ + iz / brick_size_) * bricks_x_ + bx];
+            if (index < 0) {
+                continue;
+            }
+            const float* voxels = bricks_[index].get() + y_offset + (iz % brick_size_) * brick_size_;
+            const int x0 = bx * brick_size_;
+            std::copy(voxels, voxels + std::min(brick_size_, grid_.nx - x0), &projection.pixels[(size_t)iz * grid_.nx + x0]);
+        }
+    }
+}
+
+
+float TfmVolume::voxel(const int& ix, const int& iz, const int& iy) const {
+    if (ix < 0 or ix >= grid_.nx or iz < 0 or iz >= grid_.nz or iy < 0 or iy >= n_slices_) {
+        return 0.0f;
+    }
+    const int32_t index = directory_[((size_t)(iy / brick_size_) * bricks_z_ + iz / brick_size_) * bricks_x_ + ix / brick_size_];
+    if (index < 0) {
+        return 0.0f;
+    }
+    return bricks_[index][((iy % brick_size_) * brick_size_ + iz % brick_size_) * brick_size_ + ix % brick_size_];
+}
+
+
+size_t TfmVolume::footprint() const {
+    return bricks_.size() * brick_size_ * brick_size_ * brick_size_ * sizeof(float) + directory_.capacity() * sizeof(int32_t) +
+           (depth_max_.capacity() + scan_max_.capacity() + lateral_max_.capacity()) * sizeof(float) +
+           (depth_sum_.capacity() + scan_sum_.capacity() + lateral_sum_.capacity()) * sizeof(double);
+}
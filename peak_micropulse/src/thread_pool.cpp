@@ -0,0 +1,115 @@
+#include "PeakMicroPulseHandler/thread_pool.h"
+
+#include <algorithm>
+
+
+
+ThreadPool::ThreadPool(const int& n_threads/* = 0*/)
+    :  workers_(),
+       job_(nullptr),
+       job_n_(0),
+       job_chunk_(1),
+       job_threads_(1),
+       next_(0),
+       active_(0),
+       generation_(0),
+       stop_(false),
+       active_threads_(1)
+{
+    int n = n_threads > 0 ? n_threads : std::max(1, (int)std::thread::hardware_concurrency());
+    active_threads_ = n;
+
+    for (int i = 1; i < n; i++) {
+        workers_.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    start_cv_.notify_all();
+
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+
+void ThreadPool::parallelFor(
+        const int& n,
+        const std::function<void(const int&, const int&, const int&)>& fn) {
+
+    if (n <= 0) {
+        return;
+    }
+
+    const int threads = active_threads_;
+    if (threads == 1 or n == 1) {
+        fn(0, n, 0);
+        return;
+    }
+
+    std::lock_guard<std::mutex> submit_lock(submit_mutex_);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        job_ = &fn;
+        job_n_ = n;
+        // Several chunks per worker so uneven A-Scans balance out
+        job_chunk_ = std::max(1, n / (4 * threads));
+        job_threads_ = threads;
+        next_.store(0);
+        active_ = threads - 1;
+        generation_++;
+    }
+    start_cv_.notify_all();
+
+    runJob(0);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [this]{ return active_ == 0; });
+    job_ = nullptr;
+}
+
+
+void ThreadPool::workerLoop(const int& worker) {
+    long seen = 0;
+
+    while (true) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        start_cv_.wait(lock, [&]{ return stop_ or generation_ != seen; });
+        if (stop_) {
+            return;
+        }
+        seen = generation_;
+        if (worker >= job_threads_) {
+            continue;                                         // Parked for this job
+        }
+        lock.unlock();
+
+        runJob(worker);
+
+        lock.lock();
+        if (--active_ == 0) {
+            done_cv_.notify_one();
+        }
+    }
+}
+
+
+void ThreadPool::runJob(const int& worker) {
+    while (true) {
+        int begin = next_.fetch_add(job_chunk_);
+        if (begin >= job_n_) {
+            break;
+        }
+        (*job_)(begin, std::min(begin + job_chunk_, job_n_), worker);
+    }
+}
+
+
+void ThreadPool::setActive(const int& n_threads) {
+    active_threads_ = std::min(std::max(n_threads, 1), size());
+}